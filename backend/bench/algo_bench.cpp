@@ -0,0 +1,497 @@
+// Algorithm and serializer benchmarks, for tracking regressions between
+// versions. Every sort in sorting.h, both searches, the five graph
+// algorithms, the heap and BST operations and each *ToJson serializer are
+// timed over a range of input sizes and distributions.
+//
+// Algorithms run twice: with CountingTracer, which costs a counter increment
+// per event and so measures the algorithm itself, and with JsonTracer into a
+// sink that discards frames, which measures a full traced run as the server
+// streams it. Traced runs render the whole input on every frame, so they
+// are capped at smaller sizes than counted ones, and quadratic cases more so;
+// capped cases are left out of the results.
+//
+// Results are written as one JSON document (to stdout, or to --out), one
+// entry per case with its nanoseconds per operation over repeated samples.
+//
+// Usage: algo_bench [--sizes 100,1000,10000,100000] [--seconds 0.2] [--filter text] [--seed 42] [--out file]
+//   --seconds  minimum time spent timing each case
+//   --filter   only run cases whose "group/name/tracer" contains the text
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "algorithms/tracer.h"
+#include "data_structures/heap.h"
+#include "data_structures/tree.h"
+
+typedef std::chrono::steady_clock Clock;
+
+struct Options {
+    std::vector<size_t> sizes{100, 1000, 10000, 100000};
+    double seconds = 0.2;
+    std::string filter;
+    uint64_t seed = 42;
+    std::string out;
+};
+
+// Largest inputs each kind of case is run at
+static const size_t TRACED_MAX = 1000;          // Every frame renders all n elements
+static const size_t QUADRATIC_MAX = 10000;      // O(n^2) algorithms, counted
+static const size_t QUADRATIC_TRACED_MAX = 100; // O(n^2) frames of n elements each
+static const size_t STRUCTURE_MAX = 1000;       // Heap and BST operations render the structure on every step
+
+static const char* const DISTRIBUTIONS[] = {"random", "sorted", "reversed", "few-unique"};
+
+static std::vector<int> makeArray(const std::string& distribution, size_t size, uint64_t seed) {
+    std::mt19937_64 rng(seed);
+    std::vector<int> values(size);
+    if (distribution == "few-unique") {
+        for (auto& v : values) v = static_cast<int>(rng() % 8) * 1000;
+        return values;
+    }
+    for (auto& v : values) v = static_cast<int>(rng() % 1000000);
+    if (distribution == "sorted") std::sort(values.begin(), values.end());
+    if (distribution == "reversed") std::sort(values.begin(), values.end(), std::greater<int>());
+    return values;
+}
+
+// Connected undirected graph: a random spanning tree plus about three more
+// edges per node, weights 1 to 100
+static AdjacencyList makeGraph(size_t nodes, uint64_t seed) {
+    std::mt19937_64 rng(seed);
+    AdjacencyList graph(nodes);
+    auto connect = [&](size_t u, size_t v) {
+        int weight = static_cast<int>(rng() % 100) + 1;
+        graph[u].push_back({static_cast<int>(v), weight});
+        graph[v].push_back({static_cast<int>(u), weight});
+    };
+    for (size_t v = 1; v < nodes; ++v) connect(rng() % v, v);
+    for (size_t i = 0; nodes > 1 && i < nodes * 3; ++i) {
+        size_t u = rng() % nodes, v = rng() % nodes;
+        if (u != v) connect(u, v);
+    }
+    return graph;
+}
+
+// Plain BST insertion, for building trees without rendering frames
+static void treeInsert(std::shared_ptr<TreeNode>& root, int value) {
+    std::shared_ptr<TreeNode>* slot = &root;
+    while (*slot) {
+        if (value == (*slot)->value) return;
+        slot = value < (*slot)->value ? &(*slot)->left : &(*slot)->right;
+    }
+    *slot = std::make_shared<TreeNode>(value);
+}
+
+// Discards frames, as a client socket would consume them
+struct CountingSink {
+    size_t frames = 0;
+    size_t bytes = 0;
+
+    void push_back(const std::string& step) {
+        ++frames;
+        bytes += step.size();
+    }
+};
+
+// What one run of a case produced, summed over the runs of a sample; also
+// keeps the work observable so the compiler cannot drop it
+struct Work {
+    size_t frames = 0;
+    size_t bytes = 0;
+};
+
+struct Case {
+    std::string group;        // sort, search, graph, heap, bst or serialize
+    std::string name;         // e.g. merge, linear, heapToJson
+    std::string tracer;       // count, json, or none for serializers
+    std::string distribution;
+    size_t size;
+    size_t opsPerRun;         // Operations one run performs, e.g. n inserts
+};
+
+struct Result {
+    Case info;
+    size_t runs = 0;
+    double minNs = 0;     // Per operation, over samples
+    double medianNs = 0;
+    double meanNs = 0;
+    double framesPerOp = 0;
+    double bytesPerOp = 0;
+};
+
+class Bench {
+public:
+    explicit Bench(const Options& options) : options(options) {}
+
+    bool selected(const Case& c) const {
+        if (options.filter.empty()) return true;
+        return (c.group + "/" + c.name + "/" + c.tracer).find(options.filter) != std::string::npos;
+    }
+
+    // Times 'run' (a callable taking Work&) in samples of enough runs to take
+    // at least a millisecond each, until 'seconds' have passed and at least
+    // three samples are in, or five times that long. A case whose first run
+    // already outlasts 'seconds' is timed by that run alone.
+    template <typename Run>
+    void measure(const Case& c, Run run) {
+        if (!selected(c)) return;
+        std::fprintf(stderr, "%s/%s/%s %s %zu\n", c.group.c_str(), c.name.c_str(), c.tracer.c_str(),
+                     c.distribution.c_str(), c.size);
+
+        double budget = options.seconds;
+        std::vector<double> samples; // Nanoseconds per operation
+        Work measured;
+        size_t runs = 0;
+
+        size_t batch = 1;
+        for (;;) {
+            Work warmup;
+            auto start = Clock::now();
+            for (size_t i = 0; i < batch; ++i) run(warmup);
+            auto elapsed = Clock::now() - start;
+            if (std::chrono::duration<double>(elapsed).count() >= budget) {
+                samples.push_back(std::chrono::duration<double, std::nano>(elapsed).count() / (batch * c.opsPerRun));
+                measured = warmup;
+                runs = batch;
+                break;
+            }
+            if (elapsed >= std::chrono::milliseconds(1) || batch >= (size_t(1) << 20)) break;
+            batch *= 2;
+        }
+
+        auto begin = Clock::now();
+        bool done = !samples.empty();
+        while (!done) {
+            auto start = Clock::now();
+            for (size_t i = 0; i < batch; ++i) run(measured);
+            auto end = Clock::now();
+            runs += batch;
+            samples.push_back(std::chrono::duration<double, std::nano>(end - start).count() / (batch * c.opsPerRun));
+
+            double elapsed = std::chrono::duration<double>(end - begin).count();
+            done = (elapsed >= budget && samples.size() >= 3) || elapsed >= budget * 5;
+        }
+
+        Result result;
+        result.info = c;
+        result.runs = runs;
+        std::vector<double> sorted = samples;
+        std::sort(sorted.begin(), sorted.end());
+        result.minNs = sorted.front();
+        result.medianNs = sorted[sorted.size() / 2];
+        double sum = 0;
+        for (double s : samples) sum += s;
+        result.meanNs = sum / samples.size();
+        result.framesPerOp = static_cast<double>(measured.frames) / (runs * c.opsPerRun);
+        result.bytesPerOp = static_cast<double>(measured.bytes) / (runs * c.opsPerRun);
+        results.push_back(result);
+    }
+
+    std::string renderJson() const;
+
+private:
+    const Options& options;
+    std::vector<Result> results;
+};
+
+static std::string quoted(const std::string& text) {
+    JsonWriter json;
+    json.string(text);
+    return json.release();
+}
+
+std::string Bench::renderJson() const {
+    std::string out = "{\"benchmark\":\"algo_bench\",\"seed\":" + std::to_string(options.seed);
+    char number[64];
+    std::snprintf(number, sizeof(number), "%g", options.seconds);
+    out += ",\"secondsPerCase\":";
+    out += number;
+    out += ",\"results\":[";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const Result& r = results[i];
+        if (i > 0) out += ',';
+        out += "\n{\"group\":" + quoted(r.info.group) + ",\"name\":" + quoted(r.info.name) +
+               ",\"tracer\":" + quoted(r.info.tracer) + ",\"distribution\":" + quoted(r.info.distribution) +
+               ",\"size\":" + std::to_string(r.info.size) + ",\"opsPerRun\":" + std::to_string(r.info.opsPerRun) +
+               ",\"runs\":" + std::to_string(r.runs);
+        char line[256];
+        std::snprintf(line, sizeof(line),
+                      ",\"nsPerOp\":{\"min\":%.1f,\"median\":%.1f,\"mean\":%.1f},\"framesPerOp\":%.1f,\"bytesPerOp\":%.1f}",
+                      r.minNs, r.medianNs, r.meanNs, r.framesPerOp, r.bytesPerOp);
+        out += line;
+    }
+    out += "\n]}\n";
+    return out;
+}
+
+typedef void (*SortFunction)(std::vector<int>, CountingTracer&);
+typedef void (*TracedSortFunction)(std::vector<int>, JsonTracer<CountingSink>&);
+
+static const struct {
+    const char* name;
+    bool quadratic;
+    SortFunction counted;
+    TracedSortFunction traced;
+} SORTS[] = {
+    {"bubble", true, &bubbleSort<CountingTracer>, &bubbleSort<JsonTracer<CountingSink>>},
+    {"insertion", true, &insertionSort<CountingTracer>, &insertionSort<JsonTracer<CountingSink>>},
+    {"selection", true, &selectionSort<CountingTracer>, &selectionSort<JsonTracer<CountingSink>>},
+    {"merge", false, &mergeSort<CountingTracer>, &mergeSort<JsonTracer<CountingSink>>},
+    {"quick", false, &quickSort<CountingTracer>, &quickSort<JsonTracer<CountingSink>>},
+    {"heap", false, &heapSort<CountingTracer>, &heapSort<JsonTracer<CountingSink>>},
+};
+
+// Runs an algorithm with CountingTracer, and with JsonTracer into a
+// CountingSink, each up to its size cap; 'algorithm' is a generic lambda
+// taking the tracer
+template <typename Algorithm>
+static void countedAndTraced(Bench& bench, Case c, size_t countedMax, size_t tracedMax, Algorithm algorithm) {
+    if (c.size <= countedMax) {
+        c.tracer = "count";
+        bench.measure(c, [&](Work& work) {
+            CountingTracer tracer;
+            algorithm(tracer);
+            work.frames += tracer.steps;
+        });
+    }
+    if (c.size <= tracedMax) {
+        c.tracer = "json";
+        bench.measure(c, [&](Work& work) {
+            CountingSink sink;
+            JsonTracer<CountingSink> tracer(sink);
+            algorithm(tracer);
+            work.frames += sink.frames;
+            work.bytes += sink.bytes;
+        });
+    }
+}
+
+static void benchSorts(Bench& bench, const Options& options) {
+    for (const auto& sort : SORTS) {
+        for (const char* distribution : DISTRIBUTIONS) {
+            for (size_t size : options.sizes) {
+                std::vector<int> input = makeArray(distribution, size, options.seed);
+                Case c{"sort", sort.name, "", distribution, size, 1};
+                // Quicksort picks the last element as its pivot, so sorted
+                // and reversed inputs are quadratic for it too
+                bool quadratic = sort.quadratic || (std::strcmp(sort.name, "quick") == 0 &&
+                                                    std::strcmp(distribution, "random") != 0);
+                size_t countedMax = quadratic ? QUADRATIC_MAX : SIZE_MAX;
+                size_t tracedMax = quadratic ? QUADRATIC_TRACED_MAX : TRACED_MAX;
+
+                if (size <= countedMax) {
+                    c.tracer = "count";
+                    bench.measure(c, [&](Work& work) {
+                        CountingTracer tracer;
+                        sort.counted(input, tracer);
+                        work.frames += tracer.steps;
+                    });
+                }
+                if (size <= tracedMax) {
+                    c.tracer = "json";
+                    bench.measure(c, [&](Work& work) {
+                        CountingSink sink;
+                        JsonTracer<CountingSink> tracer(sink);
+                        sort.traced(input, tracer);
+                        work.frames += sink.frames;
+                        work.bytes += sink.bytes;
+                    });
+                }
+            }
+        }
+    }
+}
+
+static void benchSearches(Bench& bench, const Options& options) {
+    for (const char* distribution : DISTRIBUTIONS) {
+        for (size_t size : options.sizes) {
+            std::vector<int> input = makeArray(distribution, size, options.seed);
+            std::vector<int> sorted = input;
+            std::sort(sorted.begin(), sorted.end());
+            // A present target three quarters of the way in
+            int target = size ? input[size * 3 / 4] : 0;
+            int sortedTarget = size ? sorted[size * 3 / 4] : 0;
+
+            countedAndTraced(bench, Case{"search", "linear", "", distribution, size, 1}, SIZE_MAX, TRACED_MAX,
+                             [&](auto& tracer) { linearSearch(input, target, tracer); });
+            countedAndTraced(bench, Case{"search", "binary", "", distribution, size, 1}, SIZE_MAX, SIZE_MAX,
+                             [&](auto& tracer) { binarySearch(sorted, sortedTarget, tracer); });
+        }
+    }
+}
+
+static void benchGraphs(Bench& bench, const Options& options) {
+    for (size_t size : options.sizes) {
+        if (size == 0) continue;
+        AdjacencyList graph = makeGraph(size, options.seed);
+        // The visited lists are searched linearly, so every algorithm is
+        // quadratic in the node count even untraced, and traced runs render
+        // every edge on every frame
+        Case c{"graph", "", "", "random", size, 1};
+        c.name = "bfs";
+        countedAndTraced(bench, c, QUADRATIC_MAX, QUADRATIC_TRACED_MAX, [&](auto& tracer) { breadthFirstSearch(graph, 0, tracer); });
+        c.name = "dfs";
+        countedAndTraced(bench, c, QUADRATIC_MAX, QUADRATIC_TRACED_MAX, [&](auto& tracer) { depthFirstSearch(graph, 0, tracer); });
+        c.name = "dijkstra";
+        countedAndTraced(bench, c, QUADRATIC_MAX, QUADRATIC_TRACED_MAX, [&](auto& tracer) { dijkstraAlgorithm(graph, 0, tracer); });
+        c.name = "kruskal";
+        countedAndTraced(bench, c, QUADRATIC_MAX, QUADRATIC_TRACED_MAX, [&](auto& tracer) { kruskalMST(graph, tracer); });
+        c.name = "prim";
+        countedAndTraced(bench, c, QUADRATIC_MAX, QUADRATIC_TRACED_MAX, [&](auto& tracer) { primMST(graph, tracer); });
+    }
+}
+
+static void addSteps(Work& work, const std::vector<std::string>& steps) {
+    work.frames += steps.size();
+    for (const auto& step : steps) work.bytes += step.size();
+}
+
+// Operations are timed per operation: one run inserts, searches or deletes
+// every input value. Rebuilding the structure a run consumes is included,
+// but it renders nothing and is small next to the operations.
+static void benchStructures(Bench& bench, const Options& options) {
+    for (const char* distribution : DISTRIBUTIONS) {
+        for (size_t size : options.sizes) {
+            if (size == 0 || size > STRUCTURE_MAX) continue;
+            std::vector<int> input = makeArray(distribution, size, options.seed);
+
+            bench.measure(Case{"heap", "insert", "json", distribution, size, size}, [&](Work& work) {
+                std::vector<int> heap;
+                for (int value : input) addSteps(work, heapInsert(heap, value));
+            });
+            bench.measure(Case{"heap", "extractMax", "json", distribution, size, size}, [&](Work& work) {
+                std::vector<int> heap = input;
+                std::make_heap(heap.begin(), heap.end());
+                for (size_t i = 0; i < size; ++i) addSteps(work, heapExtractMax(heap));
+            });
+            bench.measure(Case{"heap", "create", "json", distribution, size, 1}, [&](Work& work) {
+                std::vector<int> heap;
+                addSteps(work, createHeap(heap, input));
+            });
+
+            // Sorted input builds a tree as deep as it is large, which makes
+            // every operation O(n) steps of O(n) each
+            bool degenerate = std::strcmp(distribution, "sorted") == 0 || std::strcmp(distribution, "reversed") == 0;
+            if (degenerate && size > QUADRATIC_TRACED_MAX) continue;
+
+            std::shared_ptr<TreeNode> tree;
+            for (int value : input) treeInsert(tree, value);
+            bench.measure(Case{"bst", "insert", "json", distribution, size, size}, [&](Work& work) {
+                std::shared_ptr<TreeNode> root;
+                for (int value : input) addSteps(work, bstInsert(root, value));
+            });
+            bench.measure(Case{"bst", "search", "json", distribution, size, size}, [&](Work& work) {
+                for (int value : input) addSteps(work, bstSearch(tree, value));
+            });
+            bench.measure(Case{"bst", "delete", "json", distribution, size, size}, [&](Work& work) {
+                std::shared_ptr<TreeNode> root;
+                for (int value : input) treeInsert(root, value);
+                for (int value : input) addSteps(work, bstDelete(root, value));
+            });
+        }
+    }
+}
+
+static void benchSerializers(Bench& bench, const Options& options) {
+    auto serialize = [&](const char* name, const std::string& distribution, size_t size, auto toJson) {
+        bench.measure(Case{"serialize", name, "none", distribution, size, 1}, [&](Work& work) {
+            std::string json = toJson();
+            work.frames += 1;
+            work.bytes += json.size();
+        });
+    };
+
+    for (const char* distribution : DISTRIBUTIONS) {
+        for (size_t size : options.sizes) {
+            std::vector<int> input = makeArray(distribution, size, options.seed);
+            int middle = static_cast<int>(size / 2);
+            serialize("arrayToJson", distribution, size, [&] { return arrayToJson(input, middle, middle + 1); });
+            serialize("valuesToJson", distribution, size, [&] { return valuesToJson(input); });
+            serialize("searchStateToJson", distribution, size,
+                      [&] { return searchStateToJson(input, middle, "Checking element at index 0"); });
+            serialize("heapToJson", distribution, size, [&] { return heapToJson(input, 0, 1); });
+
+            // Trees built from sorted input are as deep as they are large, and
+            // treeToJson recurses once per level
+            if (size <= STRUCTURE_MAX || std::strcmp(distribution, "random") == 0) {
+                std::shared_ptr<TreeNode> tree;
+                for (int value : input) treeInsert(tree, value);
+                int highlight = size ? input[size / 2] : -1;
+                serialize("treeToJson", distribution, size, [&] { return treeToJson(tree, highlight, true); });
+            }
+        }
+    }
+
+    for (size_t size : options.sizes) {
+        if (size == 0) continue;
+        AdjacencyList graph = makeGraph(size, options.seed);
+        std::vector<int> visited;
+        for (size_t i = 0; i < size / 2 && i < TRACED_MAX; ++i) visited.push_back(static_cast<int>(i));
+        serialize("graphEdgesToJson", "random", size, [&] { return graphEdgesToJson(graph); });
+        if (size <= QUADRATIC_MAX) {
+            serialize("graphStateToJson", "random", size,
+                      [&] { return graphStateToJson(graph, visited, 0, "Processing node 0"); });
+        }
+    }
+}
+
+static std::vector<size_t> parseSizes(const char* text) {
+    std::vector<size_t> sizes;
+    while (*text) {
+        char* end;
+        sizes.push_back(std::strtoul(text, &end, 10));
+        if (end == text) break;
+        text = *end == ',' ? end + 1 : end;
+    }
+    return sizes;
+}
+
+int main(int argc, char* argv[]) {
+    Options options;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string flag = argv[i];
+        if (flag == "--sizes") {
+            options.sizes = parseSizes(argv[i + 1]);
+        } else if (flag == "--seconds") {
+            options.seconds = std::atof(argv[i + 1]);
+        } else if (flag == "--filter") {
+            options.filter = argv[i + 1];
+        } else if (flag == "--seed") {
+            options.seed = std::strtoull(argv[i + 1], nullptr, 10);
+        } else if (flag == "--out") {
+            options.out = argv[i + 1];
+        } else {
+            std::fprintf(stderr, "Unknown option: %s\n", argv[i]);
+            return 1;
+        }
+    }
+
+    Bench bench(options);
+    benchSorts(bench, options);
+    benchSearches(bench, options);
+    benchGraphs(bench, options);
+    benchStructures(bench, options);
+    benchSerializers(bench, options);
+
+    std::string json = bench.renderJson();
+    if (options.out.empty()) {
+        std::fputs(json.c_str(), stdout);
+        return 0;
+    }
+    FILE* file = std::fopen(options.out.c_str(), "w");
+    if (!file) {
+        std::fprintf(stderr, "Cannot write %s\n", options.out.c_str());
+        return 1;
+    }
+    std::fputs(json.c_str(), file);
+    std::fclose(file);
+    return 0;
+}
@@ -0,0 +1,675 @@
+// Load generator: replays a JSONL file of requests against a running
+// AlgoServer over many keep-alive connections and reports throughput,
+// latency percentiles and errors.
+//
+// Each line of the file is one request:
+//   {"method":"POST","path":"/api/sort","body":{"algorithm":"merge","array":"[5,3,8]"}}
+// "method" defaults to POST when there is a body and GET otherwise, and an
+// optional "accept" sets the Accept header (e.g. application/x-ndjson for
+// streamed frames). Lines are sent in order, round robin, from every
+// connection; see loadgen_requests.jsonl for a sample mix.
+//
+// Closed loop (the default), each connection sends its next request as soon
+// as the previous response is complete. With --rate, requests are issued on
+// a fixed schedule whether or not the server keeps up, and latency is
+// measured from when each request was due rather than when a connection was
+// free to send it, so a stalled server shows up in the percentiles instead
+// of quietly lowering the offered load.
+//
+// Usage: algo_loadgen --file requests.jsonl [--host 127.0.0.1] [--port 8080] [--connections 64]
+//                     [--threads 1] [--duration 10] [--rate N] [--json]
+//   --rate  requests per second over all connections; 0 or absent for closed loop
+//   --json  print the report as JSON instead of text
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifndef _WIN32
+#include <netdb.h>
+#endif
+
+#include "poller.h"
+#include "json.h"
+#include "metrics.h"
+
+typedef std::chrono::steady_clock Clock;
+
+struct Options {
+    std::string file;
+    std::string host = "127.0.0.1";
+    int port = 8080;
+    int connections = 64;
+    int threads = 1;
+    double duration = 10;
+    double rate = 0;
+    bool json = false;
+};
+
+// Requests serialized once, ready to send as they are
+static std::vector<std::string> loadRequests(const Options& options) {
+    std::ifstream in(options.file);
+    if (!in) throw std::runtime_error("Cannot open " + options.file);
+
+    std::vector<std::string> requests;
+    std::string line;
+    for (int number = 1; std::getline(in, line); ++number) {
+        if (line.find_first_not_of(" \t\r") == std::string::npos) continue;
+        JsonObject spec;
+        try {
+            spec = parseJson(line);
+        } catch (const std::invalid_argument& e) {
+            throw std::runtime_error(options.file + ":" + std::to_string(number) + ": " + e.what());
+        }
+        std::string_view path = spec["path"];
+        if (path.empty()) throw std::runtime_error(options.file + ":" + std::to_string(number) + ": no \"path\"");
+        std::string_view body = spec["body"];
+        std::string method = spec["method"].empty() ? (body.empty() ? "GET" : "POST") : std::string(spec["method"]);
+
+        std::string wire = method + " " + std::string(path) + " HTTP/1.1\r\nHost: " + options.host + ":" +
+                           std::to_string(options.port) + "\r\n";
+        if (!spec["accept"].empty()) wire += "Accept: " + std::string(spec["accept"]) + "\r\n";
+        if (!body.empty()) {
+            wire += "Content-Type: application/json\r\nContent-Length: " + std::to_string(body.size()) + "\r\n";
+        }
+        wire += "\r\n";
+        wire += body;
+        requests.push_back(std::move(wire));
+    }
+    if (requests.empty()) throw std::runtime_error(options.file + " holds no requests");
+    return requests;
+}
+
+// Incremental HTTP/1.1 response reader. Bodies are counted, not kept.
+class ResponseReader {
+public:
+    enum Result { Incomplete, Complete, Malformed };
+
+    void reset() {
+        head.clear();
+        state = Head;
+        status = 0;
+        remaining = 0;
+        bodyBytes = 0;
+        closeAfter = false;
+    }
+
+    // Consume bytes from 'data'; 'used' is how many belonged to this response
+    Result feed(const char* data, size_t length, size_t& used);
+
+    int status = 0;
+    size_t bodyBytes = 0;
+    bool closeAfter = false; // The server will close the connection after this response
+
+private:
+    enum State { Head, Body, ChunkSize, ChunkData, ChunkEnd, Trailer, Done };
+
+    bool parseHead();
+    bool takeLine(const char* data, size_t length, size_t& used, std::string& line);
+
+    State state = Head;
+    std::string head; // Head so far, or the current chunk-size or trailer line
+    bool chunked = false;
+    size_t remaining = 0;
+};
+
+// Appends to 'line' up to and including LF; true once the line is complete
+// (its CRLF is stripped)
+bool ResponseReader::takeLine(const char* data, size_t length, size_t& used, std::string& line) {
+    const char* lf = static_cast<const char*>(std::memchr(data + used, '\n', length - used));
+    size_t end = lf ? static_cast<size_t>(lf - data) + 1 : length;
+    line.append(data + used, end - used);
+    used = end;
+    if (!lf) return false;
+    line.pop_back();
+    if (!line.empty() && line.back() == '\r') line.pop_back();
+    return true;
+}
+
+static bool headerIs(const std::string& line, const char* name) {
+    size_t length = std::strlen(name);
+    if (line.size() <= length || line[length] != ':') return false;
+    for (size_t i = 0; i < length; ++i) {
+        if (std::tolower(static_cast<unsigned char>(line[i])) != name[i]) return false;
+    }
+    return true;
+}
+
+static std::string headerValue(const std::string& line) {
+    size_t start = line.find_first_not_of(" \t", line.find(':') + 1);
+    std::string value = start == std::string::npos ? "" : line.substr(start);
+    for (auto& c : value) c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    return value;
+}
+
+bool ResponseReader::parseHead() {
+    // "HTTP/1.1 200 OK"
+    size_t space = head.find(' ');
+    if (head.compare(0, 5, "HTTP/") != 0 || space == std::string::npos) return false;
+    status = std::atoi(head.c_str() + space + 1);
+    if (status < 100) return false;
+
+    chunked = false;
+    bool hasLength = false;
+    size_t lineStart = head.find("\r\n");
+    lineStart = lineStart == std::string::npos ? head.size() : lineStart + 2;
+    while (lineStart < head.size()) {
+        size_t lineEnd = head.find("\r\n", lineStart);
+        if (lineEnd == std::string::npos) lineEnd = head.size();
+        std::string line = head.substr(lineStart, lineEnd - lineStart);
+        if (headerIs(line, "content-length")) {
+            remaining = std::strtoull(headerValue(line).c_str(), nullptr, 10);
+            hasLength = true;
+        } else if (headerIs(line, "transfer-encoding")) {
+            chunked = headerValue(line).find("chunked") != std::string::npos;
+        } else if (headerIs(line, "connection")) {
+            closeAfter = headerValue(line) == "close";
+        }
+        lineStart = lineEnd + 2;
+    }
+
+    if (status < 200 || status == 204 || status == 304) {
+        state = Done;
+    } else if (chunked) {
+        state = ChunkSize;
+    } else if (hasLength) {
+        state = remaining > 0 ? Body : Done;
+    } else {
+        return false; // Bodies delimited by closing the connection are not expected from AlgoServer
+    }
+    return true;
+}
+
+ResponseReader::Result ResponseReader::feed(const char* data, size_t length, size_t& used) {
+    used = 0;
+    while (state != Done) {
+        if (used == length) return Incomplete;
+        switch (state) {
+        case Head: {
+            const char* lf = static_cast<const char*>(std::memchr(data + used, '\n', length - used));
+            size_t end = lf ? static_cast<size_t>(lf - data) + 1 : length;
+            head.append(data + used, end - used);
+            used = end;
+            if (head.size() > 64 * 1024) return Malformed;
+            size_t blank = head.find("\r\n\r\n");
+            if (blank == std::string::npos) break;
+            head.resize(blank);
+            if (!parseHead()) return Malformed;
+            head.clear();
+            break;
+        }
+        case Body:
+        case ChunkData: {
+            size_t take = std::min(remaining, length - used);
+            used += take;
+            bodyBytes += take;
+            remaining -= take;
+            if (remaining == 0) state = state == Body ? Done : ChunkEnd;
+            break;
+        }
+        case ChunkEnd:
+            if (!takeLine(data, length, used, head)) break;
+            if (!head.empty()) return Malformed;
+            state = ChunkSize;
+            break;
+        case ChunkSize:
+            if (!takeLine(data, length, used, head)) break;
+            remaining = std::strtoull(head.c_str(), nullptr, 16);
+            head.clear();
+            state = remaining > 0 ? ChunkData : Trailer;
+            break;
+        case Trailer:
+            if (!takeLine(data, length, used, head)) break;
+            if (head.empty()) state = Done;
+            head.clear();
+            break;
+        case Done:
+            break;
+        }
+    }
+    return Complete;
+}
+
+// What one thread saw; summed into the report
+struct LoadStats {
+    uint64_t sent = 0;
+    uint64_t completed = 0;
+    uint64_t statusClasses[6] = {}; // Completed responses by status / 100
+    uint64_t connectErrors = 0;
+    uint64_t socketErrors = 0;      // Connections reset or closed mid-response
+    uint64_t malformed = 0;
+    uint64_t unfinished = 0;        // Sent or due but not answered by the end
+    uint64_t bytesReceived = 0;
+    uint64_t latencySumMicros = 0;
+    uint64_t latencyMaxMicros = 0;
+    std::vector<uint64_t> latency;  // LatencyHistogram buckets
+};
+
+class LoadThread {
+public:
+    LoadThread(const Options& options, const std::vector<std::string>& requests, const struct sockaddr_in& address,
+               int connections, size_t firstRequest, double rate)
+        : options(options), requests(requests), address(address), nextRequest(firstRequest),
+          connections(connections), interval(0) {
+        if (rate > 0) interval = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1 / rate));
+    }
+
+    void run(Clock::time_point start, Clock::time_point deadline);
+    void addTo(LoadStats& totals) const;
+
+private:
+    enum State { Closed, Connecting, Idle, Sending, Receiving };
+
+    struct Connection {
+        int fd = -1;
+        State state = Closed;
+        const std::string* request = nullptr;
+        size_t offset = 0;                   // Bytes of 'request' sent
+        Clock::time_point due;               // When the request was issued, for its latency
+        Clock::time_point retryAt;           // When to reconnect after a failure
+        ResponseReader reader;
+    };
+
+    void connect(Connection& conn, Clock::time_point now);
+    void close(Connection& conn);
+    void send(Connection& conn, Clock::time_point due);
+    void flush(Connection& conn);
+    void receive(Connection& conn);
+    bool closedLoop() const { return interval == Clock::duration::zero(); }
+
+    const Options& options;
+    const std::vector<std::string>& requests;
+    struct sockaddr_in address;
+    size_t nextRequest;
+    int connections;
+    Clock::duration interval; // Between issued requests, or zero for closed loop
+
+    Poller poller;
+    std::vector<Connection> conns;
+    std::vector<size_t> byFd;                // Index into conns, by socket
+    std::deque<Clock::time_point> backlog;   // Open loop: issued requests waiting for a free connection
+    LoadStats stats;
+    LatencyHistogram latency;
+    char buffer[64 * 1024];
+};
+
+void LoadThread::connect(Connection& conn, Clock::time_point now) {
+    conn.reader.reset();
+    conn.fd = static_cast<int>(socket(AF_INET, SOCK_STREAM, 0));
+    if (conn.fd < 0 || !setNonBlocking(conn.fd)) {
+        if (conn.fd >= 0) closeSocket(conn.fd);
+        conn.fd = -1;
+        ++stats.connectErrors;
+        conn.retryAt = now + std::chrono::milliseconds(100);
+        return;
+    }
+    setNoDelay(conn.fd);
+    int result = ::connect(conn.fd, reinterpret_cast<const struct sockaddr*>(&address), sizeof(address));
+#ifdef _WIN32
+    bool pending = result != 0 && WSAGetLastError() == WSAEWOULDBLOCK;
+#else
+    bool pending = result != 0 && errno == EINPROGRESS;
+#endif
+    if (result != 0 && !pending) {
+        closeSocket(conn.fd);
+        conn.fd = -1;
+        ++stats.connectErrors;
+        conn.retryAt = now + std::chrono::milliseconds(100);
+        return;
+    }
+    if (static_cast<size_t>(conn.fd) >= byFd.size()) byFd.resize(conn.fd + 1);
+    byFd[conn.fd] = static_cast<size_t>(&conn - conns.data());
+    conn.state = pending ? Connecting : Idle;
+    poller.add(conn.fd, pending ? Poller::Writable : Poller::Readable);
+}
+
+void LoadThread::close(Connection& conn) {
+    if (conn.fd >= 0) {
+        poller.remove(conn.fd);
+        closeSocket(conn.fd);
+    }
+    conn.fd = -1;
+    conn.state = Closed;
+    conn.retryAt = Clock::time_point();
+}
+
+void LoadThread::send(Connection& conn, Clock::time_point due) {
+    conn.request = &requests[nextRequest++ % requests.size()];
+    conn.offset = 0;
+    conn.due = due;
+    conn.reader.reset();
+    conn.state = Sending;
+    ++stats.sent;
+    flush(conn);
+}
+
+void LoadThread::flush(Connection& conn) {
+    while (conn.offset < conn.request->size()) {
+        long sent = socketSend(conn.fd, conn.request->data() + conn.offset, conn.request->size() - conn.offset);
+        if (sent > 0) {
+            conn.offset += static_cast<size_t>(sent);
+        } else if (sent < 0 && socketWouldBlock()) {
+            poller.modify(conn.fd, Poller::Writable);
+            return;
+        } else if (sent < 0 && socketInterrupted()) {
+            continue;
+        } else {
+            ++stats.socketErrors;
+            close(conn);
+            return;
+        }
+    }
+    conn.state = Receiving;
+    poller.modify(conn.fd, Poller::Readable);
+}
+
+void LoadThread::receive(Connection& conn) {
+    for (;;) {
+        long received = socketRecv(conn.fd, buffer, sizeof(buffer));
+        if (received < 0 && socketInterrupted()) continue;
+        if (received < 0 && socketWouldBlock()) return;
+        if (received <= 0) {
+            // Closed by the server; only an error if a response was owed
+            if (conn.state == Sending || conn.state == Receiving) ++stats.socketErrors;
+            close(conn);
+            return;
+        }
+        stats.bytesReceived += static_cast<uint64_t>(received);
+        if (conn.state != Receiving) {
+            ++stats.malformed; // Bytes nobody asked for
+            close(conn);
+            return;
+        }
+
+        size_t used = 0;
+        ResponseReader::Result result = conn.reader.feed(buffer, static_cast<size_t>(received), used);
+        if (result == ResponseReader::Incomplete) continue;
+        if (result == ResponseReader::Malformed || used != static_cast<size_t>(received)) {
+            ++stats.malformed; // Or pipelined bytes, which are never requested
+            close(conn);
+            return;
+        }
+
+        uint64_t micros = static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - conn.due).count());
+        ++stats.completed;
+        ++stats.statusClasses[std::min(conn.reader.status / 100, 5)];
+        stats.latencySumMicros += micros;
+        stats.latencyMaxMicros = std::max(stats.latencyMaxMicros, micros);
+        latency.record(micros);
+
+        if (conn.reader.closeAfter) {
+            close(conn);
+        } else {
+            conn.state = Idle;
+        }
+        return;
+    }
+}
+
+void LoadThread::run(Clock::time_point start, Clock::time_point deadline) {
+    conns.resize(connections);
+    for (auto& conn : conns) connect(conn, start);
+
+    Clock::time_point nextDue = start;
+    std::vector<Poller::Event> events;
+    // Past the deadline, responses already owed are awaited this much longer
+    Clock::time_point drainUntil = deadline + std::chrono::seconds(2);
+
+    for (;;) {
+        Clock::time_point now = Clock::now();
+        bool running = now < deadline;
+
+        if (running && !closedLoop()) {
+            while (nextDue <= now && nextDue < deadline) {
+                backlog.push_back(nextDue);
+                nextDue += interval;
+            }
+        }
+
+        bool busy = false;
+        for (auto& conn : conns) {
+            if (conn.state == Closed && running && now >= conn.retryAt) connect(conn, now);
+            if (conn.state == Idle && running) {
+                if (closedLoop()) {
+                    send(conn, now);
+                } else if (!backlog.empty()) {
+                    send(conn, backlog.front());
+                    backlog.pop_front();
+                }
+            }
+            if (conn.state == Sending || conn.state == Receiving) busy = true;
+        }
+        if (!running && (!busy || now >= drainUntil)) break;
+
+        // Sleep until the next request is due, a retry or the deadline
+        Clock::time_point wake = running ? deadline : drainUntil;
+        if (running && !closedLoop()) wake = std::min(wake, nextDue);
+        if (running) {
+            for (const auto& conn : conns) {
+                if (conn.state == Closed) wake = std::min(wake, conn.retryAt);
+            }
+        }
+        auto waitMs = std::chrono::duration_cast<std::chrono::milliseconds>(wake - now).count();
+        if (wake > now && waitMs == 0) waitMs = 1;
+        if (waitMs < 0) waitMs = 0;
+
+        int count = poller.wait(events, static_cast<int>(waitMs));
+        for (int i = 0; i < count; ++i) {
+            const Poller::Event& event = events[i];
+            if (event.fd < 0 || static_cast<size_t>(event.fd) >= byFd.size()) continue;
+            Connection& conn = conns[byFd[event.fd]];
+            if (conn.fd != event.fd) continue;
+
+            if (conn.state == Connecting && (event.writable || event.hangup)) {
+                int error = 0;
+                socklen_t length = sizeof(error);
+                getsockopt(conn.fd, SOL_SOCKET, SO_ERROR, reinterpret_cast<char*>(&error), &length);
+                if (error != 0) {
+                    ++stats.connectErrors;
+                    close(conn);
+                    conn.retryAt = Clock::now() + std::chrono::milliseconds(100);
+                    continue;
+                }
+                conn.state = Idle;
+                poller.modify(conn.fd, Poller::Readable);
+            } else if (conn.state == Sending && event.writable) {
+                flush(conn);
+            } else if (event.readable || event.hangup) {
+                receive(conn);
+            }
+        }
+    }
+
+    for (auto& conn : conns) {
+        if (conn.state == Sending || conn.state == Receiving) ++stats.unfinished;
+        close(conn);
+    }
+    stats.unfinished += backlog.size();
+}
+
+void LoadThread::addTo(LoadStats& totals) const {
+    totals.sent += stats.sent;
+    totals.completed += stats.completed;
+    for (int i = 0; i < 6; ++i) totals.statusClasses[i] += stats.statusClasses[i];
+    totals.connectErrors += stats.connectErrors;
+    totals.socketErrors += stats.socketErrors;
+    totals.malformed += stats.malformed;
+    totals.unfinished += stats.unfinished;
+    totals.bytesReceived += stats.bytesReceived;
+    totals.latencySumMicros += stats.latencySumMicros;
+    totals.latencyMaxMicros = std::max(totals.latencyMaxMicros, stats.latencyMaxMicros);
+    latency.addTo(totals.latency);
+}
+
+// Upper bound of the bucket holding the q-quantile, in microseconds
+static uint64_t quantileMicros(const LoadStats& stats, double q) {
+    if (stats.completed == 0) return 0;
+    uint64_t rank = static_cast<uint64_t>(q * stats.completed + 0.999999);
+    if (rank == 0) rank = 1;
+    uint64_t seen = 0;
+    for (size_t i = 0; i < stats.latency.size(); ++i) {
+        seen += stats.latency[i];
+        if (seen >= rank) return std::min(LatencyHistogram::bucketUpperBound(i), stats.latencyMaxMicros);
+    }
+    return stats.latencyMaxMicros;
+}
+
+static void report(const Options& options, const LoadStats& stats, double seconds) {
+    static const struct {
+        const char* label;
+        double q;
+    } quantiles[] = {{"p50", 0.5}, {"p90", 0.9}, {"p99", 0.99}, {"p999", 0.999}};
+    uint64_t errors = stats.statusClasses[4] + stats.statusClasses[5] + stats.connectErrors + stats.socketErrors +
+                      stats.malformed;
+    double mean = stats.completed ? static_cast<double>(stats.latencySumMicros) / stats.completed : 0;
+
+    if (options.json) {
+        std::printf("{\"mode\":\"%s\",\"rate\":%g,\"connections\":%d,\"threads\":%d,\"seconds\":%.3f,",
+                    options.rate > 0 ? "open" : "closed", options.rate, options.connections, options.threads, seconds);
+        std::printf("\"sent\":%llu,\"completed\":%llu,\"throughput\":%.1f,\"bytesReceived\":%llu,",
+                    (unsigned long long)stats.sent, (unsigned long long)stats.completed, stats.completed / seconds,
+                    (unsigned long long)stats.bytesReceived);
+        std::printf("\"latencyMicros\":{\"mean\":%.1f", mean);
+        for (const auto& q : quantiles) {
+            std::printf(",\"%s\":%llu", q.label, (unsigned long long)quantileMicros(stats, q.q));
+        }
+        std::printf(",\"max\":%llu},", (unsigned long long)stats.latencyMaxMicros);
+        std::printf("\"status\":{\"2xx\":%llu,\"3xx\":%llu,\"4xx\":%llu,\"5xx\":%llu},",
+                    (unsigned long long)stats.statusClasses[2], (unsigned long long)stats.statusClasses[3],
+                    (unsigned long long)stats.statusClasses[4], (unsigned long long)stats.statusClasses[5]);
+        std::printf("\"errors\":{\"total\":%llu,\"connect\":%llu,\"socket\":%llu,\"malformed\":%llu,\"unfinished\":%llu}}\n",
+                    (unsigned long long)errors, (unsigned long long)stats.connectErrors,
+                    (unsigned long long)stats.socketErrors, (unsigned long long)stats.malformed,
+                    (unsigned long long)stats.unfinished);
+        return;
+    }
+
+    std::printf("%s loop, %d connections on %d threads, %.2fs\n", options.rate > 0 ? "Open" : "Closed",
+                options.connections, options.threads, seconds);
+    if (options.rate > 0) std::printf("  offered      %10.1f req/s\n", options.rate);
+    std::printf("  throughput   %10.1f req/s  (%llu of %llu sent)\n", stats.completed / seconds,
+                (unsigned long long)stats.completed, (unsigned long long)stats.sent);
+    std::printf("  received     %10.1f MB/s\n", stats.bytesReceived / seconds / 1e6);
+    std::printf("  latency      mean %.0fus", mean);
+    for (const auto& q : quantiles) std::printf("  %s %lluus", q.label, (unsigned long long)quantileMicros(stats, q.q));
+    std::printf("  max %lluus\n", (unsigned long long)stats.latencyMaxMicros);
+    std::printf("  status       2xx %llu  3xx %llu  4xx %llu  5xx %llu\n", (unsigned long long)stats.statusClasses[2],
+                (unsigned long long)stats.statusClasses[3], (unsigned long long)stats.statusClasses[4],
+                (unsigned long long)stats.statusClasses[5]);
+    std::printf("  errors       %llu  (connect %llu, socket %llu, malformed %llu; %llu unfinished)\n",
+                (unsigned long long)errors, (unsigned long long)stats.connectErrors,
+                (unsigned long long)stats.socketErrors, (unsigned long long)stats.malformed,
+                (unsigned long long)stats.unfinished);
+}
+
+static bool resolve(const Options& options, struct sockaddr_in& address) {
+    struct addrinfo hints = {};
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    struct addrinfo* result = nullptr;
+    if (getaddrinfo(options.host.c_str(), nullptr, &hints, &result) != 0 || !result) return false;
+    address = *reinterpret_cast<struct sockaddr_in*>(result->ai_addr);
+    address.sin_port = htons(static_cast<unsigned short>(options.port));
+    freeaddrinfo(result);
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+        std::string flag = argv[i];
+        if (flag == "--json") {
+            options.json = true;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            std::fprintf(stderr, "Missing value for %s\n", argv[i]);
+            return 1;
+        }
+        const char* value = argv[++i];
+        if (flag == "--file") {
+            options.file = value;
+        } else if (flag == "--host") {
+            options.host = value;
+        } else if (flag == "--port") {
+            options.port = std::atoi(value);
+        } else if (flag == "--connections") {
+            options.connections = std::max(1, std::atoi(value));
+        } else if (flag == "--threads") {
+            options.threads = std::max(1, std::atoi(value));
+        } else if (flag == "--duration") {
+            options.duration = std::atof(value);
+        } else if (flag == "--rate") {
+            options.rate = std::atof(value);
+        } else {
+            std::fprintf(stderr, "Unknown option: %s\n", flag.c_str());
+            return 1;
+        }
+    }
+    if (options.file.empty()) {
+        std::fprintf(stderr, "Usage: algo_loadgen --file requests.jsonl [--host H] [--port N] [--connections N]\n"
+                             "                    [--threads N] [--duration S] [--rate N] [--json]\n");
+        return 1;
+    }
+    options.threads = std::min(options.threads, options.connections);
+
+#ifdef _WIN32
+    WSADATA wsaData;
+    if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0) {
+        std::fprintf(stderr, "WSAStartup failed\n");
+        return 1;
+    }
+#endif
+
+    std::vector<std::string> requests;
+    try {
+        requests = loadRequests(options);
+    } catch (const std::exception& e) {
+        std::fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+    struct sockaddr_in address;
+    if (!resolve(options, address)) {
+        std::fprintf(stderr, "Cannot resolve %s\n", options.host.c_str());
+        return 1;
+    }
+
+    // Connections and rate split evenly; threads start at different lines
+    std::vector<std::unique_ptr<LoadThread>> threads;
+    for (int t = 0; t < options.threads; ++t) {
+        int connections = options.connections / options.threads + (t < options.connections % options.threads);
+        size_t firstRequest = requests.size() * t / options.threads;
+        threads.emplace_back(new LoadThread(options, requests, address, connections, firstRequest,
+                                            options.rate / options.threads));
+    }
+
+    Clock::time_point start = Clock::now();
+    Clock::time_point deadline =
+        start + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(options.duration));
+    std::vector<std::thread> running;
+    for (auto& thread : threads) {
+        LoadThread* t = thread.get();
+        running.emplace_back([t, start, deadline] { t->run(start, deadline); });
+    }
+    for (auto& thread : running) thread.join();
+
+    LoadStats totals;
+    for (const auto& thread : threads) thread->addTo(totals);
+    report(options, totals, options.duration);
+
+#ifdef _WIN32
+    WSACleanup();
+#endif
+    return 0;
+}
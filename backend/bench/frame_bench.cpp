@@ -0,0 +1,95 @@
+// Frame serialization throughput: a merge sort traced with JsonTracer, which
+// renders every frame into one reused JsonWriter buffer, against the previous
+// serializer that built each frame with a fresh std::ostringstream.
+//
+// Usage: frame_bench [elements] [seconds]   (defaults: 10000 elements, 3 seconds each)
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "algorithms/tracer.h"
+
+typedef std::chrono::steady_clock Clock;
+
+// The ostringstream-per-frame arrayToJson that JsonWriter replaced
+static std::string streamArrayToJson(const std::vector<int>& arr, int highlightPos, int highlightPos2) {
+    std::ostringstream json;
+    json << "[";
+    for (size_t i = 0; i < arr.size(); ++i) {
+        if (i > 0) json << ",";
+
+        if (i == highlightPos || i == highlightPos2) {
+            json << "{\"value\":" << arr[i] << ",\"highlight\":true}";
+        } else {
+            json << "{\"value\":" << arr[i] << ",\"highlight\":false}";
+        }
+    }
+    json << "]";
+    return json.str();
+}
+
+// JsonTracer's sorting events as they were rendered before JsonWriter
+template <typename StepSink>
+class StreamJsonTracer {
+public:
+    explicit StreamJsonTracer(StepSink& steps) : steps(steps) {}
+
+    void highlight(const std::vector<int>& arr, int i = -1, int j = -1) { steps.push_back(streamArrayToJson(arr, i, j)); }
+    void compare(const std::vector<int>& arr, int i, int j) { steps.push_back(streamArrayToJson(arr, i, j)); }
+    void swap(const std::vector<int>& arr, int i, int j) { steps.push_back(streamArrayToJson(arr, i, j)); }
+    void write(const std::vector<int>& arr, int i) { steps.push_back(streamArrayToJson(arr, i, -1)); }
+
+private:
+    StepSink& steps;
+};
+
+// Discards frames, as a client socket would consume them, and stops the run
+// once the time is up
+class TimedSink {
+public:
+    struct TimeUp {};
+
+    explicit TimedSink(Clock::time_point deadline) : deadline(deadline), frames(0), bytes(0) {}
+
+    void push_back(const std::string& step) {
+        bytes += step.size();
+        if (++frames % 16 == 0 && Clock::now() >= deadline) throw TimeUp();
+    }
+
+    Clock::time_point deadline;
+    size_t frames;
+    size_t bytes;
+};
+
+template <template <typename> class Tracer>
+static void run(const char* name, const std::vector<int>& input, double seconds) {
+    auto start = Clock::now();
+    TimedSink sink(start + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(seconds)));
+    Tracer<TimedSink> tracer(sink);
+    try {
+        mergeSort(input, tracer);
+    } catch (const TimedSink::TimeUp&) {
+    }
+    double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+    std::printf("%-14s %10.0f frames/s %10.1f MB/s  (%zu frames in %.2fs)\n", name, sink.frames / elapsed,
+                sink.bytes / elapsed / 1e6, sink.frames, elapsed);
+}
+
+int main(int argc, char* argv[]) {
+    size_t elements = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 10000;
+    double seconds = argc > 2 ? std::atof(argv[2]) : 3.0;
+
+    std::mt19937 rng(42);
+    std::vector<int> input(elements);
+    for (auto& value : input) value = static_cast<int>(rng() % 1000000);
+
+    std::printf("merge sort frames, %zu elements\n", elements);
+    run<StreamJsonTracer>("ostringstream", input, seconds);
+    run<JsonTracer>("JsonWriter", input, seconds);
+    return 0;
+}
@@ -0,0 +1,136 @@
+#ifndef BINARY_TRACE_H
+#define BINARY_TRACE_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// The application/x-algo-trace encoding: a compact binary counterpart of the
+// delta trace (see DeltaTracer in tracer.h), for clients that ask for it.
+//
+// Integers are LEB128 varints; signed values are zigzag encoded first, and
+// positions that may be -1 are sent plus one. A trace is a header followed
+// by records, each one opcode byte and its operands:
+//
+//   header     "ALGT", version byte (2), kind byte, then for
+//              KIND_ARRAY  n, and the n initial values as little-endian int32
+//              KIND_GRAPH  nodes, edge count, and per edge source, target, zigzag weight
+//   HIGHLIGHT  i + 1, j + 1
+//   COMPARE    i, j
+//   SWAP       i, j                 then highlight i and j
+//   WRITE      i, zigzag value      arr[i] = value, then highlight i
+//   PROBE      pos + 1, status, operands                        search frame
+//   VISIT      current + 1, count, count nodes visited since the last frame, status, operands
+//   STRING     length, bytes        next entry of the status table, numbered from 0
+//   END        frames, length, bytes of a JSON object with the summary, e.g. {"result":3}
+//
+// A status is an index into the status table, followed by its operands. A
+// table entry is a template: each zero byte (STATUS_OPERAND, status_text.h)
+// in it stands for a number, sent as a zigzag varint after the index in the
+// order they appear. Every distinct template is defined once, by a STRING
+// record just before the first frame using it, so the table stays as small
+// as the set of status kinds an algorithm has, e.g. "Checking element at
+// index \0" for every probe of a linear search.
+enum BinaryTraceOp : uint8_t {
+    TRACE_HIGHLIGHT = 1,
+    TRACE_COMPARE = 2,
+    TRACE_SWAP = 3,
+    TRACE_WRITE = 4,
+    TRACE_PROBE = 5,
+    TRACE_VISIT = 6,
+    TRACE_STRING = 7,
+    TRACE_END = 8
+};
+
+const uint8_t BINARY_TRACE_VERSION = 2;
+const uint8_t BINARY_TRACE_KIND_ARRAY = 1;
+const uint8_t BINARY_TRACE_KIND_GRAPH = 2;
+
+// Append-only byte buffer for the encoding, reused like JsonWriter:
+// clear() keeps the capacity
+class BinaryWriter {
+public:
+    void clear() { out.clear(); }
+    void reserve(size_t bytes) { out.reserve(bytes); }
+    size_t size() const { return out.size(); }
+    const std::string& str() const { return out; }
+
+    // Hand the bytes over, leaving the writer empty
+    std::string release() {
+        std::string bytes;
+        bytes.swap(out);
+        return bytes;
+    }
+
+    BinaryWriter& byte(uint8_t value) {
+        out += static_cast<char>(value);
+        return *this;
+    }
+
+    BinaryWriter& varint(uint64_t value) {
+        while (value >= 0x80) {
+            out += static_cast<char>((value & 0x7f) | 0x80);
+            value >>= 7;
+        }
+        out += static_cast<char>(value);
+        return *this;
+    }
+
+    BinaryWriter& signedVarint(int64_t value) {
+        return varint((static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63));
+    }
+
+    BinaryWriter& int32(int32_t value) {
+        uint32_t bits = static_cast<uint32_t>(value);
+        char le[4] = {static_cast<char>(bits), static_cast<char>(bits >> 8), static_cast<char>(bits >> 16),
+                      static_cast<char>(bits >> 24)};
+        out.append(le, 4);
+        return *this;
+    }
+
+    BinaryWriter& bytes(std::string_view text) {
+        out.append(text.data(), text.size());
+        return *this;
+    }
+
+private:
+    std::string out;
+};
+
+// Header of a sorting or searching trace
+inline std::string binaryArrayTraceHeader(const std::vector<int>& initial) {
+    BinaryWriter header;
+    header.reserve(8 + initial.size() * 4);
+    header.bytes("ALGT").byte(BINARY_TRACE_VERSION).byte(BINARY_TRACE_KIND_ARRAY).varint(initial.size());
+    for (int value : initial) header.int32(value);
+    return header.release();
+}
+
+// Header of a graph trace; 'graph' is an AdjacencyList (graph.h)
+template <typename Graph>
+std::string binaryGraphTraceHeader(const Graph& graph) {
+    size_t edges = 0;
+    for (const auto& adjacent : graph) edges += adjacent.size();
+    BinaryWriter header;
+    header.bytes("ALGT").byte(BINARY_TRACE_VERSION).byte(BINARY_TRACE_KIND_GRAPH).varint(graph.size()).varint(edges);
+    for (size_t u = 0; u < graph.size(); ++u) {
+        for (const auto& edge : graph[u]) {
+            header.varint(u).varint(static_cast<uint64_t>(edge.first)).signedVarint(edge.second);
+        }
+    }
+    return header.release();
+}
+
+// END record closing a trace of 'frames' frames. 'extraFields' are the
+// summary members as the JSON formats append them: empty, or starting with
+// a comma.
+inline std::string binaryTraceEnd(size_t frames, const std::string& extraFields) {
+    std::string summary = extraFields.empty() ? "{}" : "{" + extraFields.substr(1) + "}";
+    BinaryWriter end;
+    end.byte(TRACE_END).varint(frames).varint(summary.size()).bytes(summary);
+    return end.release();
+}
+
+#endif // BINARY_TRACE_H
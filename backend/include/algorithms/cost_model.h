@@ -0,0 +1,75 @@
+#ifndef COST_MODEL_H
+#define COST_MODEL_H
+
+#include <cstddef>
+#include <cmath>
+
+// Frame format requested by the "trace" and "resolution" request fields
+struct TraceOptions {
+    bool delta = false;    // "trace":"delta" rather than the default "snapshot"
+    size_t resolution = 0; // Down-sample snapshot frames to this many buckets; 0 keeps every element
+    bool binary = false;   // Delta records in the application/x-algo-trace encoding (binary_trace.h)
+};
+
+// Order of a sort's input, where it is known from the request: quick sort
+// always pivots on the last element, which makes it quadratic on all of
+// these but Random
+enum class InputOrder { Random, Sorted, Reversed, NearlySorted, FewUnique, OrganPipe };
+
+struct InputShape {
+    InputOrder order = InputOrder::Random;
+    size_t swaps = 1;  // NearlySorted: pairs swapped out of order
+    size_t unique = 1; // FewUnique: distinct values
+};
+
+// What a traced run will cost, predicted from the algorithm and the size of
+// its input before anything runs. The estimators next to the algorithms
+// (estimateSortCost() and friends) count frames exactly where an algorithm
+// does the same work for any data of that size, and take the average over
+// random inputs where it does not, so sorted or reversed input can be off by
+// the gap between an algorithm's average and worst case.
+struct CostEstimate {
+    double frames = 0; // Frames the tracer emits
+    double bytes = 0;  // Encoded size of those frames
+    double millis = 0; // Server time to run the algorithm and render the frames
+};
+
+// Time to render and hand on one frame, and to write one byte of frame JSON,
+// as measured with algo_bench on one x86 core
+const double COST_NANOS_PER_FRAME = 60;
+const double COST_NANOS_PER_BYTE = 1.0;
+
+// Time to generate one value of a "generate" spec, or make one of its swaps
+const double COST_NANOS_PER_GENERATED_VALUE = 12;
+
+// Time per frame of a run that only counts its frames (CountingTracer)
+const double COST_NANOS_PER_COUNTED_FRAME = 2;
+
+// Fill in an estimate from its frame count and average frame size.
+// 'nanosPerByte' is above COST_NANOS_PER_BYTE for frames that take more
+// than copying to render.
+void setCostEstimate(CostEstimate& cost, double frames, double frameBytes,
+                     double nanosPerByte = COST_NANOS_PER_BYTE) {
+    cost.frames = frames;
+    cost.bytes = frames * (frameBytes + 1); // Frames are comma separated
+    cost.millis = (frames * COST_NANOS_PER_FRAME + cost.bytes * nanosPerByte) / 1e6;
+}
+
+// n log2 n, the comparisons of an efficient sort
+double costNLogN(size_t n) {
+    return n > 1 ? n * std::log2(static_cast<double>(n)) : 0;
+}
+
+// Decimal digits of n, for indices written into frames
+double costDigits(size_t n) {
+    return n < 10 ? 1 : std::floor(std::log10(static_cast<double>(n))) + 1;
+}
+
+// Bytes of n as a varint, for indices written into binary frames
+double costVarintBytes(size_t n) {
+    double bytes = 1;
+    for (; n >= 0x80; n >>= 7) ++bytes;
+    return bytes;
+}
+
+#endif // COST_MODEL_H
@@ -3,66 +3,112 @@
 
 #include <vector>
 #include <string>
-#include <sstream>
 #include <queue>
 #include <stack>
 #include <algorithm>
 #include <limits>
 #include <set>
 #include <utility>
+#include <tuple>
+
+#include "json_writer.h"
+#include "status_text.h"
+#include "cost_model.h"
 
 // Prevent max macro interference (Windows specific)
 #ifdef max
 #undef max
 #endif
 
-// Graph representation for visualization
-std::string graphStateToJson(const std::vector<std::vector<std::pair<int, int>>>& graph, 
-                            const std::vector<int>& visited, 
-                            int current,
-                            const std::string& status) {
-    std::ostringstream json;
-    json << "{\"nodes\":[";
+// Adjacency list: graph[u] holds (v, weight) pairs
+typedef std::vector<std::vector<std::pair<int, int>>> AdjacencyList;
+
+// Append the edge list of a graph as JSON, e.g. [{"source":0,"target":1,"weight":4}]
+void writeGraphEdgesJson(JsonWriter& json, const AdjacencyList& graph) {
+    json.raw('[');
+    bool firstEdge = true;
+    for (size_t u = 0; u < graph.size(); ++u) {
+        for (const auto& edge : graph[u]) {
+            if (!firstEdge) json.raw(',');
+            firstEdge = false;
+            json.raw("{\"source\":").number(u).raw(",\"target\":").number(edge.first);
+            json.raw(",\"weight\":").number(edge.second).raw('}');
+        }
+    }
+    json.raw(']');
+}
+
+// Edge list of a graph as JSON
+std::string graphEdgesToJson(const AdjacencyList& graph) {
+    JsonWriter json;
+    writeGraphEdgesJson(json, graph);
+    return json.release();
+}
+
+// Append a graph state as frame JSON
+void writeGraphStateJson(JsonWriter& json, const AdjacencyList& graph, const std::vector<int>& visited, int current,
+                         std::string_view status) {
+    json.raw("{\"nodes\":[");
     
     for (size_t i = 0; i < graph.size(); ++i) {
-        if (i > 0) json << ",";
+        if (i > 0) json.raw(',');
         
         // Determine node state (current, visited, unvisited)
-        std::string state = "unvisited";
-        if (static_cast<int>(i) == current) state = "current";
-        else if (std::find(visited.begin(), visited.end(), i) != visited.end()) state = "visited";
-        
-        json << "{\"id\":" << i << ",\"state\":\"" << state << "\"}";
+        json.raw("{\"id\":").number(i);
+        if (static_cast<int>(i) == current) {
+            json.raw(",\"state\":\"current\"}");
+        } else if (std::find(visited.begin(), visited.end(), i) != visited.end()) {
+            json.raw(",\"state\":\"visited\"}");
+        } else {
+            json.raw(",\"state\":\"unvisited\"}");
+        }
     }
     
-    json << "],\"edges\":[";
-    
-    // Add edges
-    bool firstEdge = true;
-    for (size_t u = 0; u < graph.size(); ++u) {
-        for (const auto& edge : graph[u]) {
-            int v = edge.first;
-            int weight = edge.second;
-            
-            if (!firstEdge) json << ",";
-            firstEdge = false;
-            
-            json << "{\"source\":" << u << ",\"target\":" << v << ",\"weight\":" << weight << "}";
+    json.raw("],\"edges\":");
+    writeGraphEdgesJson(json, graph);
+    json.raw(",\"status\":").string(status).raw('}');
+}
+
+// Graph representation for visualization
+std::string graphStateToJson(const std::vector<std::vector<std::pair<int, int>>>& graph, 
+                            const std::vector<int>& visited, 
+                            int current,
+                            const std::string& status) {
+    JsonWriter json;
+    writeGraphStateJson(json, graph, visited, current, status);
+    return json.release();
+}
+
+// Final status line of Dijkstra's algorithm
+void shortestPathsSummary(StatusText& status, const std::vector<int>& distances, int start) {
+    status << "Dijkstra complete. Shortest paths from " << start << ": ";
+    for (size_t i = 0; i < distances.size(); ++i) {
+        if (i != static_cast<size_t>(start)) {
+            if (distances[i] == std::numeric_limits<int>::max()) {
+                status << i << "(∞) ";
+            } else {
+                status << i << "(" << distances[i] << ") ";
+            }
         }
     }
-    
-    json << "],\"status\":\"" << status << "\"}";
-    return json.str();
 }
 
+// The graph algorithms are templates on a Tracer policy (see tracer.h):
+//   visit(graph, visited, current, describe)  a node is being processed
+//   edge(graph, visited, current, describe)   an edge is being examined
+//   state(graph, visited, current, describe)  any other frame
+// 'visited' only ever grows. 'describe' writes the status text into a
+// StatusText and is only called by tracers that render it, so untraced runs
+// never build the strings.
+
 // BFS algorithm with visualization steps
-std::vector<std::string> breadthFirstSearch(const std::vector<std::vector<std::pair<int, int>>>& graph, int start) {
-    std::vector<std::string> steps;
+template <typename Tracer>
+void breadthFirstSearch(const std::vector<std::vector<std::pair<int, int>>>& graph, int start, Tracer& tracer) {
     std::vector<int> visited;
     std::queue<int> q;
     
     // Add initial state
-    steps.push_back(graphStateToJson(graph, visited, start, "Starting BFS from node " + std::to_string(start)));
+    tracer.state(graph, visited, start, [&](StatusText& status) { status << "Starting BFS from node " << start; });
     
     q.push(start);
     visited.push_back(start);
@@ -72,7 +118,7 @@ std::vector<std::string> breadthFirstSearch(const std::vector<std::vector<std::p
         q.pop();
         
         // Add current node processing state
-        steps.push_back(graphStateToJson(graph, visited, current, "Processing node " + std::to_string(current)));
+        tracer.visit(graph, visited, current, [&](StatusText& status) { status << "Processing node " << current; });
         
         // Process all neighbors
         for (const auto& edge : graph[current]) {
@@ -81,33 +127,33 @@ std::vector<std::string> breadthFirstSearch(const std::vector<std::vector<std::p
             // If not visited
             if (std::find(visited.begin(), visited.end(), neighbor) == visited.end()) {
                 // Add edge traversal state
-                steps.push_back(graphStateToJson(graph, visited, current, 
-                    "Discovering edge " + std::to_string(current) + " -> " + std::to_string(neighbor)));
+                tracer.edge(graph, visited, current, [&](StatusText& status) {
+                    status << "Discovering edge " << current << " -> " << neighbor;
+                });
                 
                 visited.push_back(neighbor);
                 q.push(neighbor);
                 
                 // Add node discovery state
-                steps.push_back(graphStateToJson(graph, visited, neighbor, 
-                    "Discovered node " + std::to_string(neighbor)));
+                tracer.state(graph, visited, neighbor, [&](StatusText& status) {
+                    status << "Discovered node " << neighbor;
+                });
             }
         }
     }
     
     // Add final state
-    steps.push_back(graphStateToJson(graph, visited, -1, "BFS complete"));
-    
-    return steps;
+    tracer.state(graph, visited, -1, [](StatusText& status) { status << "BFS complete"; });
 }
 
 // DFS algorithm with visualization steps
-std::vector<std::string> depthFirstSearch(const std::vector<std::vector<std::pair<int, int>>>& graph, int start) {
-    std::vector<std::string> steps;
+template <typename Tracer>
+void depthFirstSearch(const std::vector<std::vector<std::pair<int, int>>>& graph, int start, Tracer& tracer) {
     std::vector<int> visited;
     std::stack<int> s;
     
     // Add initial state
-    steps.push_back(graphStateToJson(graph, visited, start, "Starting DFS from node " + std::to_string(start)));
+    tracer.state(graph, visited, start, [&](StatusText& status) { status << "Starting DFS from node " << start; });
     
     s.push(start);
     
@@ -124,7 +170,7 @@ std::vector<std::string> depthFirstSearch(const std::vector<std::vector<std::pai
         visited.push_back(current);
         
         // Add current node processing state
-        steps.push_back(graphStateToJson(graph, visited, current, "Processing node " + std::to_string(current)));
+        tracer.visit(graph, visited, current, [&](StatusText& status) { status << "Processing node " << current; });
         
         // Process all neighbors in reverse order (so they come out of stack in original order)
         for (auto it = graph[current].rbegin(); it != graph[current].rend(); ++it) {
@@ -133,8 +179,9 @@ std::vector<std::string> depthFirstSearch(const std::vector<std::vector<std::pai
             // If not visited
             if (std::find(visited.begin(), visited.end(), neighbor) == visited.end()) {
                 // Add edge consideration state
-                steps.push_back(graphStateToJson(graph, visited, current, 
-                    "Considering edge " + std::to_string(current) + " -> " + std::to_string(neighbor)));
+                tracer.edge(graph, visited, current, [&](StatusText& status) {
+                    status << "Considering edge " << current << " -> " << neighbor;
+                });
                 
                 s.push(neighbor);
             }
@@ -142,14 +189,12 @@ std::vector<std::string> depthFirstSearch(const std::vector<std::vector<std::pai
     }
     
     // Add final state
-    steps.push_back(graphStateToJson(graph, visited, -1, "DFS complete"));
-    
-    return steps;
+    tracer.state(graph, visited, -1, [](StatusText& status) { status << "DFS complete"; });
 }
 
 // Dijkstra's algorithm with visualization steps
-std::vector<std::string> dijkstraAlgorithm(const std::vector<std::vector<std::pair<int, int>>>& graph, int start) {
-    std::vector<std::string> steps;
+template <typename Tracer>
+void dijkstraAlgorithm(const std::vector<std::vector<std::pair<int, int>>>& graph, int start, Tracer& tracer) {
     std::vector<int> visited;
     std::vector<int> distances(graph.size(), std::numeric_limits<int>::max());
     std::vector<int> previous(graph.size(), -1);
@@ -158,7 +203,9 @@ std::vector<std::string> dijkstraAlgorithm(const std::vector<std::vector<std::pa
     std::priority_queue<std::pair<int, int>, std::vector<std::pair<int, int>>, std::greater<>> pq;
     
     // Add initial state
-    steps.push_back(graphStateToJson(graph, visited, start, "Starting Dijkstra's algorithm from node " + std::to_string(start)));
+    tracer.state(graph, visited, start, [&](StatusText& status) {
+        status << "Starting Dijkstra's algorithm from node " << start;
+    });
     
     // Initialize distances
     distances[start] = 0;
@@ -178,8 +225,9 @@ std::vector<std::string> dijkstraAlgorithm(const std::vector<std::vector<std::pa
         visited.push_back(current);
         
         // Add current node processing state
-        steps.push_back(graphStateToJson(graph, visited, current, 
-            "Processing node " + std::to_string(current) + " with distance " + std::to_string(dist)));
+        tracer.visit(graph, visited, current, [&](StatusText& status) {
+            status << "Processing node " << current << " with distance " << dist;
+        });
         
         // Process all neighbors
         for (const auto& edge : graph[current]) {
@@ -192,9 +240,10 @@ std::vector<std::string> dijkstraAlgorithm(const std::vector<std::vector<std::pa
             }
             
             // Add edge consideration state
-            steps.push_back(graphStateToJson(graph, visited, current, 
-                "Considering edge " + std::to_string(current) + " -> " + std::to_string(neighbor) + 
-                " with weight " + std::to_string(weight)));
+            tracer.edge(graph, visited, current, [&](StatusText& status) {
+                status << "Considering edge " << current << " -> " << neighbor
+                       << " with weight " << weight;
+            });
             
             // Relaxation step
             int newDist = dist + weight;
@@ -204,28 +253,15 @@ std::vector<std::string> dijkstraAlgorithm(const std::vector<std::vector<std::pa
                 pq.push({newDist, neighbor});
                 
                 // Add distance update state
-                steps.push_back(graphStateToJson(graph, visited, neighbor, 
-                    "Updated distance to node " + std::to_string(neighbor) + " = " + std::to_string(newDist)));
+                tracer.state(graph, visited, neighbor, [&](StatusText& status) {
+                    status << "Updated distance to node " << neighbor << " = " << newDist;
+                });
             }
         }
     }
     
     // Add final state with shortest paths
-    std::ostringstream paths;
-    paths << "Dijkstra complete. Shortest paths from " << start << ": ";
-    for (size_t i = 0; i < distances.size(); ++i) {
-        if (i != static_cast<size_t>(start)) {
-            if (distances[i] == std::numeric_limits<int>::max()) {
-                paths << i << "(∞) ";
-            } else {
-                paths << i << "(" << distances[i] << ") ";
-            }
-        }
-    }
-    
-    steps.push_back(graphStateToJson(graph, visited, -1, paths.str()));
-    
-    return steps;
+    tracer.state(graph, visited, -1, [&](StatusText& status) { shortestPathsSummary(status, distances, start); });
 }
 
 // Helper class for Kruskal's MST
@@ -267,12 +303,12 @@ public:
 };
 
 // Kruskal's MST algorithm with visualization steps
-std::vector<std::string> kruskalMST(const std::vector<std::vector<std::pair<int, int>>>& graph) {
-    std::vector<std::string> steps;
+template <typename Tracer>
+void kruskalMST(const std::vector<std::vector<std::pair<int, int>>>& graph, Tracer& tracer) {
     std::vector<int> visited;
     
     // Add initial state
-    steps.push_back(graphStateToJson(graph, visited, -1, "Starting Kruskal's MST algorithm"));
+    tracer.state(graph, visited, -1, [](StatusText& status) { status << "Starting Kruskal's MST algorithm"; });
     
     // Create edge list from adjacency list
     std::vector<std::tuple<int, int, int>> edges; // (weight, u, v)
@@ -302,9 +338,10 @@ std::vector<std::string> kruskalMST(const std::vector<std::vector<std::pair<int,
         int v = std::get<2>(edge);
         
         // Consider edge
-        steps.push_back(graphStateToJson(graph, visited, -1, 
-            "Considering edge " + std::to_string(u) + " -> " + std::to_string(v) + 
-            " with weight " + std::to_string(weight)));
+        tracer.edge(graph, visited, -1, [&](StatusText& status) {
+            status << "Considering edge " << u << " -> " << v
+                   << " with weight " << weight;
+        });
         
         // Check if adding edge creates a cycle
         if (ds.find(u) != ds.find(v)) {
@@ -319,14 +356,16 @@ std::vector<std::string> kruskalMST(const std::vector<std::vector<std::pair<int,
             }
             
             // Add edge addition state
-            steps.push_back(graphStateToJson(graph, visited, -1, 
-                "Added edge " + std::to_string(u) + " -> " + std::to_string(v) + 
-                " to MST (weight: " + std::to_string(weight) + ")"));
+            tracer.state(graph, visited, -1, [&](StatusText& status) {
+                status << "Added edge " << u << " -> " << v
+                       << " to MST (weight: " << weight << ")";
+            });
         } else {
             // Add cycle detection state
-            steps.push_back(graphStateToJson(graph, visited, -1, 
-                "Edge " + std::to_string(u) + " -> " + std::to_string(v) + 
-                " would create a cycle - skipping"));
+            tracer.state(graph, visited, -1, [&](StatusText& status) {
+                status << "Edge " << u << " -> " << v
+                       << " would create a cycle - skipping";
+            });
         }
     }
     
@@ -341,25 +380,25 @@ std::vector<std::string> kruskalMST(const std::vector<std::vector<std::pair<int,
         }
     }
     
-    steps.push_back(graphStateToJson(graph, visited, -1, 
-        "Kruskal's MST algorithm complete. Total MST weight: " + std::to_string(totalWeight)));
-    
-    return steps;
+    tracer.state(graph, visited, -1, [&](StatusText& status) {
+        status << "Kruskal's MST algorithm complete. Total MST weight: " << totalWeight;
+    });
 }
 
 // Prim's MST algorithm with visualization steps
-std::vector<std::string> primMST(const std::vector<std::vector<std::pair<int, int>>>& graph) {
-    if (graph.empty()) return {};
+template <typename Tracer>
+void primMST(const std::vector<std::vector<std::pair<int, int>>>& graph, Tracer& tracer) {
+    if (graph.empty()) return;
     
-    std::vector<std::string> steps;
     std::vector<int> visited;
     
     // Start from node 0
     int start = 0;
     
     // Add initial state
-    steps.push_back(graphStateToJson(graph, visited, start, 
-        "Starting Prim's MST algorithm from node " + std::to_string(start)));
+    tracer.state(graph, visited, start, [&](StatusText& status) {
+        status << "Starting Prim's MST algorithm from node " << start;
+    });
     
     // Priority queue for (weight, to, from) triples
     std::priority_queue<std::tuple<int, int, int>, 
@@ -373,8 +412,9 @@ std::vector<std::string> primMST(const std::vector<std::vector<std::pair<int, in
     }
     
     // Add edge consideration state
-    steps.push_back(graphStateToJson(graph, visited, start, 
-        "Added all edges from node " + std::to_string(start) + " to priority queue"));
+    tracer.state(graph, visited, start, [&](StatusText& status) {
+        status << "Added all edges from node " << start << " to priority queue";
+    });
     
     // Process edges
     int totalWeight = 0;
@@ -387,9 +427,10 @@ std::vector<std::string> primMST(const std::vector<std::vector<std::pair<int, in
         
         // If destination already visited, skip
         if (std::find(visited.begin(), visited.end(), to) != visited.end()) {
-            steps.push_back(graphStateToJson(graph, visited, -1, 
-                "Edge " + std::to_string(from) + " -> " + std::to_string(to) + 
-                " connects to already visited node - skipping"));
+            tracer.edge(graph, visited, -1, [&](StatusText& status) {
+                status << "Edge " << from << " -> " << to
+                       << " connects to already visited node - skipping";
+            });
             continue;
         }
         
@@ -398,9 +439,10 @@ std::vector<std::string> primMST(const std::vector<std::vector<std::pair<int, in
         visited.push_back(to);
         
         // Add edge addition state
-        steps.push_back(graphStateToJson(graph, visited, to, 
-            "Added edge " + std::to_string(from) + " -> " + std::to_string(to) + 
-            " to MST (weight: " + std::to_string(weight) + ")"));
+        tracer.visit(graph, visited, to, [&](StatusText& status) {
+            status << "Added edge " << from << " -> " << to
+                   << " to MST (weight: " << weight << ")";
+        });
         
         // Add adjacent edges of the new node
         for (const auto& edge : graph[to]) {
@@ -414,15 +456,63 @@ std::vector<std::string> primMST(const std::vector<std::vector<std::pair<int, in
         }
         
         // Add edge consideration state
-        steps.push_back(graphStateToJson(graph, visited, to, 
-            "Added all edges from node " + std::to_string(to) + " to priority queue"));
+        tracer.state(graph, visited, to, [&](StatusText& status) {
+            status << "Added all edges from node " << to << " to priority queue";
+        });
     }
     
     // Add final state
-    steps.push_back(graphStateToJson(graph, visited, -1, 
-        "Prim's MST algorithm complete. Total MST weight: " + std::to_string(totalWeight)));
-    
-    return steps;
+    tracer.state(graph, visited, -1, [&](StatusText& status) {
+        status << "Prim's MST algorithm complete. Total MST weight: " << totalWeight;
+    });
+}
+
+// Time to compare one visited list entry while rendering a snapshot frame
+const double COST_NANOS_PER_VISITED_CHECK = 0.3;
+
+// Predicted cost of tracing a graph algorithm on 'nodes' nodes and 'edges'
+// adjacency list entries (an undirected edge is two) in the given format
+// (see cost_model.h); false for an unknown algorithm. The counts assume
+// every node is reachable from the start node and were fitted with
+// CountingTracer on random connected graphs.
+bool estimateGraphCost(const std::string& algorithm, size_t nodes, size_t edges, const TraceOptions& options,
+                       CostEstimate& cost) {
+    double v = static_cast<double>(nodes);
+    double e = static_cast<double>(edges);
+    double frames;
+    if (algorithm == "bfs") {
+        frames = 3 * v;
+    } else if (algorithm == "dfs") {
+        frames = v + e / 2;
+    } else if (algorithm == "dijkstra") {
+        frames = 2 * v + 0.55 * e;
+    } else if (algorithm == "kruskal") {
+        frames = e + 2;
+    } else if (algorithm == "prim") {
+        frames = 4 * v;
+    } else {
+        return false;
+    }
+
+    if (options.binary) {
+        // Opcode, current node, new visits, and a status index with two or
+        // three numbers (nodes, and a distance or weight)
+        setCostEstimate(cost, frames, 3 + 5 * costVarintBytes(nodes));
+        return true;
+    }
+    if (options.delta) {
+        // {"current":c,"visited":[...],"status":"..."}, each node sent once
+        setCostEstimate(cost, frames, 60 + costDigits(nodes));
+        return true;
+    }
+
+    // Every node as {"id":i,"state":"visited"} and every entry as
+    // {"source":u,"target":v,"weight":w}. Each node's state is looked up in
+    // the visited list, on average half full, which adds a term quadratic
+    // in the nodes to every frame.
+    setCostEstimate(cost, frames, 70 + 28 * v + 37 * e);
+    cost.millis += frames * v * (v / 2) * COST_NANOS_PER_VISITED_CHECK / 1e6;
+    return true;
 }
 
 #endif // GRAPH_H
\ No newline at end of file
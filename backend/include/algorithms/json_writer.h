@@ -0,0 +1,79 @@
+#ifndef JSON_WRITER_H
+#define JSON_WRITER_H
+
+#include <string>
+#include <string_view>
+#include <charconv>
+#include <cstddef>
+
+// Append-only JSON text builder over one growable buffer. Integers are
+// formatted with to_chars (no locale, no stream state) and literal fragments
+// such as {"value": are copied in with their length known at compile time.
+// clear() keeps the capacity, so a writer reused for every frame stops
+// allocating once it has grown to fit the largest frame.
+class JsonWriter {
+public:
+    void clear() { out.clear(); }
+    void reserve(size_t bytes) { out.reserve(bytes); }
+    size_t size() const { return out.size(); }
+    const std::string& str() const { return out; }
+
+    // Hand the text over, leaving the writer empty
+    std::string release() {
+        std::string text;
+        text.swap(out);
+        return text;
+    }
+
+    // Text copied as is: punctuation, member names and other fixed fragments
+    template <size_t N>
+    JsonWriter& raw(const char (&literal)[N]) {
+        out.append(literal, N - 1);
+        return *this;
+    }
+
+    JsonWriter& raw(std::string_view text) {
+        out.append(text.data(), text.size());
+        return *this;
+    }
+
+    JsonWriter& raw(char c) {
+        out += c;
+        return *this;
+    }
+
+    template <typename Integer>
+    JsonWriter& number(Integer value) {
+        char buf[24];
+        auto result = std::to_chars(buf, buf + sizeof(buf), value);
+        out.append(buf, result.ptr - buf);
+        return *this;
+    }
+
+    JsonWriter& boolean(bool value) {
+        return value ? raw("true") : raw("false");
+    }
+
+    // A quoted string, escaping quotes, backslashes and control characters
+    JsonWriter& string(std::string_view text) {
+        out += '"';
+        size_t start = 0;
+        for (size_t i = 0; i < text.size(); ++i) {
+            unsigned char c = static_cast<unsigned char>(text[i]);
+            if (c >= 0x20 && c != '"' && c != '\\') continue;
+            out.append(text.data() + start, i - start);
+            static const char hex[] = "0123456789abcdef";
+            char escape[6] = {'\\', 'u', '0', '0', hex[c >> 4], hex[c & 15]};
+            out.append(escape, 6);
+            start = i + 1;
+        }
+        out.append(text.data() + start, text.size() - start);
+        out += '"';
+        return *this;
+    }
+
+private:
+    std::string out;
+};
+
+#endif // JSON_WRITER_H
@@ -0,0 +1,38 @@
+#ifndef PHASE_TIMER_H
+#define PHASE_TIMER_H
+
+#include <chrono>
+#include <cstddef>
+
+// Time a traced run spends in the tracer, summed over all of its frames:
+// rendering each frame, and handing it to the step sink (appending it to the
+// response body, or writing it to the socket when streamed). Whatever else
+// the run took is the algorithm itself. Tracers only fill this in when given
+// one with setFrameTimes(), so an untimed run pays one null check per frame.
+struct FrameTimes {
+    std::chrono::steady_clock::duration render{0};
+    std::chrono::steady_clock::duration sink{0};
+    size_t frames = 0;
+};
+
+// Adds the time from construction to destruction to '*total'. With a null
+// 'total' it does nothing and never reads the clock.
+class PhaseSpan {
+public:
+    explicit PhaseSpan(std::chrono::steady_clock::duration* total) : total(total) {
+        if (total) start = std::chrono::steady_clock::now();
+    }
+
+    ~PhaseSpan() {
+        if (total) *total += std::chrono::steady_clock::now() - start;
+    }
+
+    PhaseSpan(const PhaseSpan&) = delete;
+    PhaseSpan& operator=(const PhaseSpan&) = delete;
+
+private:
+    std::chrono::steady_clock::duration* total;
+    std::chrono::steady_clock::time_point start;
+};
+
+#endif // PHASE_TIMER_H
@@ -3,43 +3,61 @@
 
 #include <vector>
 #include <string>
-#include <sstream>
+#include <algorithm>
 
-// Helper function to convert search state to JSON
-std::string searchStateToJson(const std::vector<int>& arr, int pos, const std::string& status) {
-    std::ostringstream json;
-    json << "{\"array\":[";
+#include "json_writer.h"
+#include "status_text.h"
+#include "cost_model.h"
+
+// Append a search state as frame JSON
+void writeSearchStateJson(JsonWriter& json, const std::vector<int>& arr, int pos, std::string_view status) {
+    json.raw("{\"array\":[");
     for (size_t i = 0; i < arr.size(); ++i) {
-        if (i > 0) json << ",";
+        if (i > 0) json.raw(',');
         
+        json.raw("{\"value\":").number(arr[i]);
         if (i == pos) {
-            json << "{\"value\":" << arr[i] << ",\"highlight\":true}";
+            json.raw(",\"highlight\":true}");
         } else {
-            json << "{\"value\":" << arr[i] << ",\"highlight\":false}";
+            json.raw(",\"highlight\":false}");
         }
     }
-    json << "],\"status\":\"" << status << "\"}";
-    return json.str();
+    json.raw("],\"status\":").string(status).raw('}');
+}
+
+// Helper function to convert search state to JSON
+std::string searchStateToJson(const std::vector<int>& arr, int pos, const std::string& status) {
+    JsonWriter json;
+    writeSearchStateJson(json, arr, pos, status);
+    return json.release();
 }
 
+// The searches are templates on a Tracer policy (see tracer.h):
+//   probe(arr, pos, describe)  arr[pos] is being compared with the target
+//   state(arr, pos, describe)  any other frame, with pos highlighted (-1 for none)
+// 'describe' writes the status text into a StatusText and is only called by
+// tracers that render it, so untraced runs never build the strings.
+
 // Linear Search with visualization steps
-int linearSearch(const std::vector<int>& arr, int target, std::vector<std::string>& steps) {
+template <typename Tracer>
+int linearSearch(const std::vector<int>& arr, int target, Tracer& tracer) {
     for (int i = 0; i < arr.size(); i++) {
         // Add current position to steps
-        steps.push_back(searchStateToJson(arr, i, "Checking element at index " + std::to_string(i)));
+        tracer.probe(arr, i, [&](StatusText& status) { status << "Checking element at index " << i; });
         
         if (arr[i] == target) {
-            steps.push_back(searchStateToJson(arr, i, "Found target at index " + std::to_string(i)));
+            tracer.state(arr, i, [&](StatusText& status) { status << "Found target at index " << i; });
             return i;
         }
     }
     
-    steps.push_back(searchStateToJson(arr, -1, "Target not found in array"));
+    tracer.state(arr, -1, [](StatusText& status) { status << "Target not found in array"; });
     return -1;
 }
 
 // Binary Search with visualization steps
-int binarySearch(const std::vector<int>& arr, int target, std::vector<std::string>& steps) {
+template <typename Tracer>
+int binarySearch(const std::vector<int>& arr, int target, Tracer& tracer) {
     int left = 0;
     int right = arr.size() - 1;
     
@@ -47,24 +65,57 @@ int binarySearch(const std::vector<int>& arr, int target, std::vector<std::strin
         int mid = left + (right - left) / 2;
         
         // Add current state to steps
-        steps.push_back(searchStateToJson(arr, mid, "Checking mid element at index " + std::to_string(mid)));
+        tracer.probe(arr, mid, [&](StatusText& status) { status << "Checking mid element at index " << mid; });
         
         if (arr[mid] == target) {
-            steps.push_back(searchStateToJson(arr, mid, "Found target at index " + std::to_string(mid)));
+            tracer.state(arr, mid, [&](StatusText& status) { status << "Found target at index " << mid; });
             return mid;
         }
         
         if (arr[mid] < target) {
-            steps.push_back(searchStateToJson(arr, mid, "Target is greater, moving to right half"));
+            tracer.state(arr, mid, [](StatusText& status) { status << "Target is greater, moving to right half"; });
             left = mid + 1;
         } else {
-            steps.push_back(searchStateToJson(arr, mid, "Target is smaller, moving to left half"));
+            tracer.state(arr, mid, [](StatusText& status) { status << "Target is smaller, moving to left half"; });
             right = mid - 1;
         }
     }
     
-    steps.push_back(searchStateToJson(arr, -1, "Target not found in array"));
+    tracer.state(arr, -1, [](StatusText& status) { status << "Target not found in array"; });
     return -1;
 }
 
+// Predicted cost of tracing a search of n elements in the given format (see
+// cost_model.h), for a target that is in the array at a random position;
+// a missing one doubles linear search's count. False for an unknown
+// algorithm.
+bool estimateSearchCost(const std::string& algorithm, size_t n, const TraceOptions& options, CostEstimate& cost) {
+    double size = static_cast<double>(n);
+    double frames;
+    if (algorithm == "linear") {
+        frames = size / 2 + 2;
+    } else if (algorithm == "binary") {
+        // A probe and the step that follows it, per halving
+        frames = 2 * std::log2(size + 1);
+    } else {
+        return false;
+    }
+
+    // The array as in a sorting frame plus a status line of about 40 bytes.
+    // Binary frames send the status as a table index and its one or two
+    // numbers, an index and sometimes a value.
+    double frameBytes;
+    if (options.binary) {
+        frameBytes = 3 + 3 * costVarintBytes(n);
+    } else if (options.delta) {
+        frameBytes = 60;
+    } else if (options.resolution > 0) {
+        frameBytes = 60 + 50 * static_cast<double>(std::min(options.resolution, n));
+    } else {
+        frameBytes = 60 + 34 * size;
+    }
+    setCostEstimate(cost, frames, frameBytes);
+    return true;
+}
+
 #endif // SEARCHING_H
\ No newline at end of file
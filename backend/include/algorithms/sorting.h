@@ -3,150 +3,242 @@
 
 #include <vector>
 #include <string>
-#include <sstream>
+#include <memory>
+#include <utility>
+#include <algorithm>
 
-// Helper function to convert array to JSON string
-std::string arrayToJson(const std::vector<int>& arr, int highlightPos = -1, int highlightPos2 = -1) {
-    std::ostringstream json;
-    json << "[";
+#include "json_writer.h"
+#include "cost_model.h"
+
+// Append an array as frame JSON, e.g. [{"value":5,"highlight":false},...]
+void writeArrayJson(JsonWriter& json, const std::vector<int>& arr, int highlightPos = -1, int highlightPos2 = -1) {
+    json.raw('[');
     for (size_t i = 0; i < arr.size(); ++i) {
-        if (i > 0) json << ",";
-        
+        if (i > 0) json.raw(',');
+
+        json.raw("{\"value\":").number(arr[i]);
         if (i == highlightPos || i == highlightPos2) {
-            json << "{\"value\":" << arr[i] << ",\"highlight\":true}";
+            json.raw(",\"highlight\":true}");
         } else {
-            json << "{\"value\":" << arr[i] << ",\"highlight\":false}";
+            json.raw(",\"highlight\":false}");
         }
     }
-    json << "]";
-    return json.str();
+    json.raw(']');
+}
+
+// Helper function to convert array to JSON string
+std::string arrayToJson(const std::vector<int>& arr, int highlightPos = -1, int highlightPos2 = -1) {
+    JsonWriter json;
+    writeArrayJson(json, arr, highlightPos, highlightPos2);
+    return json.release();
+}
+
+// Append a plain JSON array of values, e.g. [5,3,8]
+void writeValuesJson(JsonWriter& json, const std::vector<int>& arr) {
+    json.raw('[');
+    for (size_t i = 0; i < arr.size(); ++i) {
+        if (i > 0) json.raw(',');
+        json.number(arr[i]);
+    }
+    json.raw(']');
 }
 
+// Plain JSON array of values, e.g. [5,3,8]
+std::string valuesToJson(const std::vector<int>& arr) {
+    JsonWriter json;
+    writeValuesJson(json, arr);
+    return json.release();
+}
+
+// Down-sampled view of an array for drawing it at a fixed width: 'resolution'
+// buckets of consecutive elements, each summarized by its min and max. After
+// one position changes, update() refreshes just the bucket holding it, so
+// keeping the view current costs O(n / resolution) per change.
+class ArrayBuckets {
+public:
+    ArrayBuckets(const std::vector<int>& arr, size_t resolution)
+        : n(arr.size()), count(std::min(resolution, arr.size())), mins(count), maxs(count) {
+        for (size_t b = 0; b < count; ++b) refresh(arr, b);
+    }
+
+    void update(const std::vector<int>& arr, int pos) {
+        if (pos >= 0 && static_cast<size_t>(pos) < n) refresh(arr, bucketOf(pos));
+    }
+
+    // e.g. [{"min":2,"max":9,"highlight":false},...]; a bucket is highlighted
+    // when it holds either highlighted position
+    void write(JsonWriter& json, int highlightPos = -1, int highlightPos2 = -1) const {
+        long long h1 = highlightPos >= 0 && static_cast<size_t>(highlightPos) < n ? bucketOf(highlightPos) : -1;
+        long long h2 = highlightPos2 >= 0 && static_cast<size_t>(highlightPos2) < n ? bucketOf(highlightPos2) : -1;
+        json.raw('[');
+        for (size_t b = 0; b < count; ++b) {
+            if (b > 0) json.raw(',');
+            json.raw("{\"min\":").number(mins[b]).raw(",\"max\":").number(maxs[b]);
+            if (static_cast<long long>(b) == h1 || static_cast<long long>(b) == h2) {
+                json.raw(",\"highlight\":true}");
+            } else {
+                json.raw(",\"highlight\":false}");
+            }
+        }
+        json.raw(']');
+    }
+
+    std::string toJson(int highlightPos = -1, int highlightPos2 = -1) const {
+        JsonWriter json;
+        write(json, highlightPos, highlightPos2);
+        return json.release();
+    }
+
+private:
+    // Bucket b holds positions [b * n / count, (b + 1) * n / count)
+    size_t bucketOf(int pos) const {
+        return ((static_cast<unsigned long long>(pos) + 1) * count - 1) / n;
+    }
+
+    void refresh(const std::vector<int>& arr, size_t b) {
+        size_t begin = static_cast<unsigned long long>(b) * n / count;
+        size_t end = static_cast<unsigned long long>(b + 1) * n / count;
+        mins[b] = *std::min_element(arr.begin() + begin, arr.begin() + end);
+        maxs[b] = *std::max_element(arr.begin() + begin, arr.begin() + end);
+    }
+
+    size_t n;
+    size_t count;
+    std::vector<int> mins;
+    std::vector<int> maxs;
+};
+
+// The sorts are templates on a Tracer policy (see tracer.h) that is told what
+// the algorithm does; the algorithm performs each mutation itself first:
+//   highlight(arr, i, j)  mark up to two positions (-1 for none)
+//   compare(arr, i, j)    the elements at i and j are being compared
+//   swap(arr, i, j)       arr[i] and arr[j] have just been swapped
+//   write(arr, i)         arr[i] has just been assigned
+// With NullTracer every call is empty and the plain algorithm remains.
+//
+// The array is a std::vector<int> unless a caller names another 'Array',
+// e.g. a std::pmr::vector<int> to account for the memory a sort uses; its
+// scratch space is then allocated the same way (see ScratchVector).
+
+// A vector of T allocated like 'Array'
+template <typename Array, typename T>
+using ScratchVector =
+    std::vector<T, typename std::allocator_traits<typename Array::allocator_type>::template rebind_alloc<T>>;
+
 // Bubble Sort with steps
-std::vector<std::string> bubbleSort(std::vector<int> arr) {
-    std::vector<std::string> steps;
-    
+template <typename Tracer, typename Array = std::vector<int>>
+void bubbleSort(Array arr, Tracer& tracer) {
     // Add initial state
-    steps.push_back(arrayToJson(arr));
-    
+    tracer.highlight(arr);
+
     int n = arr.size();
     for (int i = 0; i < n-1; i++) {
         for (int j = 0; j < n-i-1; j++) {
             // Highlight current comparison elements
-            steps.push_back(arrayToJson(arr, j, j+1));
-            
+            tracer.compare(arr, j, j+1);
+
             if (arr[j] > arr[j+1]) {
                 std::swap(arr[j], arr[j+1]);
                 // Add the state after swap
-                steps.push_back(arrayToJson(arr, j, j+1));
+                tracer.swap(arr, j, j+1);
             }
         }
     }
-    
+
     // Add final state
-    steps.push_back(arrayToJson(arr));
-    
-    return steps;
+    tracer.highlight(arr);
 }
 
 // Insertion Sort with steps
-std::vector<std::string> insertionSort(std::vector<int> arr) {
-    std::vector<std::string> steps;
-    
+template <typename Tracer, typename Array = std::vector<int>>
+void insertionSort(Array arr, Tracer& tracer) {
     // Add initial state
-    steps.push_back(arrayToJson(arr));
-    
+    tracer.highlight(arr);
+
     int n = arr.size();
     for (int i = 1; i < n; i++) {
         int key = arr[i];
         int j = i - 1;
-        
+
         // Highlight the key element
-        steps.push_back(arrayToJson(arr, i));
-        
+        tracer.highlight(arr, i);
+
         while (j >= 0 && arr[j] > key) {
             // Highlight comparison
-            steps.push_back(arrayToJson(arr, j, i));
-            
+            tracer.compare(arr, j, i);
+
             arr[j + 1] = arr[j];
-            j--;
-            
+
             // Show the movement
-            steps.push_back(arrayToJson(arr, j+1));
+            tracer.write(arr, j+1);
+            j--;
         }
         arr[j + 1] = key;
-        
+
         // Show insertion of key
-        steps.push_back(arrayToJson(arr, j+1));
+        tracer.write(arr, j+1);
     }
-    
+
     // Add final state
-    steps.push_back(arrayToJson(arr));
-    
-    return steps;
+    tracer.highlight(arr);
 }
 
 // Selection Sort with steps
-std::vector<std::string> selectionSort(std::vector<int> arr) {
-    std::vector<std::string> steps;
-    
+template <typename Tracer, typename Array = std::vector<int>>
+void selectionSort(Array arr, Tracer& tracer) {
     // Add initial state
-    steps.push_back(arrayToJson(arr));
-    
+    tracer.highlight(arr);
+
     int n = arr.size();
     for (int i = 0; i < n-1; i++) {
         int min_idx = i;
-        
+
         // Highlight current position
-        steps.push_back(arrayToJson(arr, i));
-        
+        tracer.highlight(arr, i);
+
         for (int j = i+1; j < n; j++) {
             // Highlight comparison
-            steps.push_back(arrayToJson(arr, min_idx, j));
-            
+            tracer.compare(arr, min_idx, j);
+
             if (arr[j] < arr[min_idx])
                 min_idx = j;
         }
-        
+
         // Highlight min element found
-        steps.push_back(arrayToJson(arr, i, min_idx));
-        
+        tracer.highlight(arr, i, min_idx);
+
         std::swap(arr[min_idx], arr[i]);
-        
+
         // Show after swap
-        steps.push_back(arrayToJson(arr, i));
+        tracer.swap(arr, i, min_idx);
     }
-    
+
     // Add final state
-    steps.push_back(arrayToJson(arr));
-    
-    return steps;
+    tracer.highlight(arr);
 }
 
-// Merge two subarrays and track steps
-void merge(std::vector<int>& arr, int left, int mid, int right, std::vector<std::string>& steps) {
+// Merge two subarrays and track steps. 'scratch' is as long as 'arr' and
+// holds the copies of both halves, so a whole sort allocates it once rather
+// than two temp arrays per merge.
+template <typename Tracer, typename Array>
+void merge(Array& arr, int left, int mid, int right, Array& scratch, Tracer& tracer) {
     int n1 = mid - left + 1;
     int n2 = right - mid;
-    
-    // Create temp arrays
-    std::vector<int> L(n1), R(n2);
-    
-    // Copy data to temp arrays
-    for (int i = 0; i < n1; i++)
-        L[i] = arr[left + i];
-    for (int j = 0; j < n2; j++)
-        R[j] = arr[mid + 1 + j];
-    
+
+    // Copy data to temp arrays, the halves of scratch[left..right]
+    std::copy(arr.begin() + left, arr.begin() + right + 1, scratch.begin() + left);
+    const int* L = scratch.data() + left;
+    const int* R = scratch.data() + mid + 1;
+
     // Merge the temp arrays back into arr[left..right]
     int i = 0; // Initial index of first subarray
     int j = 0; // Initial index of second subarray
     int k = left; // Initial index of merged subarray
-    
+
     while (i < n1 && j < n2) {
         // Highlight the comparison elements
-        std::vector<int> tempArr = arr;
-        steps.push_back(arrayToJson(arr, left + i, mid + 1 + j));
-        
+        tracer.compare(arr, left + i, mid + 1 + j);
+
         if (L[i] <= R[j]) {
             arr[k] = L[i];
             i++;
@@ -155,196 +247,263 @@ void merge(std::vector<int>& arr, int left, int mid, int right, std::vector<std:
             j++;
         }
         k++;
-        
+
         // Show the array after placement
-        steps.push_back(arrayToJson(arr, k - 1));
+        tracer.write(arr, k - 1);
     }
-    
+
     // Copy the remaining elements of L[]
     while (i < n1) {
         arr[k] = L[i];
-        steps.push_back(arrayToJson(arr, k));
+        tracer.write(arr, k);
         i++;
         k++;
     }
-    
+
     // Copy the remaining elements of R[]
     while (j < n2) {
         arr[k] = R[j];
-        steps.push_back(arrayToJson(arr, k));
+        tracer.write(arr, k);
         j++;
         k++;
     }
 }
 
 // Merge sort with steps
-void mergeSortHelper(std::vector<int>& arr, int left, int right, std::vector<std::string>& steps) {
+template <typename Tracer, typename Array>
+void mergeSortHelper(Array& arr, int left, int right, Array& scratch, Tracer& tracer) {
     if (left < right) {
         // Same as (left + right) / 2, but avoids overflow for large left and right
         int mid = left + (right - left) / 2;
-        
+
         // Highlight the divide step
-        steps.push_back(arrayToJson(arr, left, right));
-        
+        tracer.highlight(arr, left, right);
+
         // Sort first and second halves
-        mergeSortHelper(arr, left, mid, steps);
-        mergeSortHelper(arr, mid + 1, right, steps);
-        
+        mergeSortHelper(arr, left, mid, scratch, tracer);
+        mergeSortHelper(arr, mid + 1, right, scratch, tracer);
+
         // Highlight before merge
-        steps.push_back(arrayToJson(arr, left, right));
-        
+        tracer.highlight(arr, left, right);
+
         // Merge the sorted halves
-        merge(arr, left, mid, right, steps);
+        merge(arr, left, mid, right, scratch, tracer);
     }
 }
 
 // Merge Sort wrapper function
-std::vector<std::string> mergeSort(std::vector<int> arr) {
-    std::vector<std::string> steps;
-    
+template <typename Tracer, typename Array = std::vector<int>>
+void mergeSort(Array arr, Tracer& tracer) {
     // Add initial state
-    steps.push_back(arrayToJson(arr));
-    
+    tracer.highlight(arr);
+
     // Call the recursive helper function
-    mergeSortHelper(arr, 0, arr.size() - 1, steps);
-    
+    Array scratch(arr.size(), arr.get_allocator());
+    mergeSortHelper(arr, 0, arr.size() - 1, scratch, tracer);
+
     // Add final state
-    steps.push_back(arrayToJson(arr));
-    
-    return steps;
+    tracer.highlight(arr);
 }
 
 // Partition function for Quick Sort
-int partition(std::vector<int>& arr, int low, int high, std::vector<std::string>& steps) {
+template <typename Tracer, typename Array>
+int partition(Array& arr, int low, int high, Tracer& tracer) {
     int pivot = arr[high]; // pivot
     int i = (low - 1); // Index of smaller element
-    
+
     // Highlight pivot
-    steps.push_back(arrayToJson(arr, high));
-    
+    tracer.highlight(arr, high);
+
     for (int j = low; j <= high - 1; j++) {
         // Highlight current element being compared
-        steps.push_back(arrayToJson(arr, j, high));
-        
+        tracer.compare(arr, j, high);
+
         // If current element is smaller than the pivot
         if (arr[j] < pivot) {
             i++; // increment index of smaller element
             std::swap(arr[i], arr[j]);
-            
+
             // Show after swap
-            steps.push_back(arrayToJson(arr, i, j));
+            tracer.swap(arr, i, j);
         }
     }
-    
+
     // Swap pivot into its final position
     std::swap(arr[i + 1], arr[high]);
-    
+
     // Show after pivot placement
-    steps.push_back(arrayToJson(arr, i + 1));
-    
+    tracer.swap(arr, i + 1, high);
+
     return (i + 1);
 }
 
-// Quick sort helper
-void quickSortHelper(std::vector<int>& arr, int low, int high, std::vector<std::string>& steps) {
-    if (low < high) {
+// Quick sort helper. Ranges wait on an explicit stack rather than the call
+// stack, since sorted input makes the partitions maximally unbalanced and the
+// recursion n levels deep; popping the left part first keeps the same order.
+template <typename Tracer, typename Array>
+void quickSortHelper(Array& arr, int low, int high, Tracer& tracer) {
+    ScratchVector<Array, std::pair<int, int>> ranges(arr.get_allocator());
+    ranges.push_back({low, high});
+
+    while (!ranges.empty()) {
+        low = ranges.back().first;
+        high = ranges.back().second;
+        ranges.pop_back();
+        if (low >= high) continue;
+
         // Highlight current partition
-        steps.push_back(arrayToJson(arr, low, high));
-        
+        tracer.highlight(arr, low, high);
+
         // pi is partitioning index
-        int pi = partition(arr, low, high, steps);
-        
+        int pi = partition(arr, low, high, tracer);
+
         // Separately sort elements before and after partition
-        quickSortHelper(arr, low, pi - 1, steps);
-        quickSortHelper(arr, pi + 1, high, steps);
+        ranges.push_back({pi + 1, high});
+        ranges.push_back({low, pi - 1});
     }
 }
 
 // Quick Sort wrapper function
-std::vector<std::string> quickSort(std::vector<int> arr) {
-    std::vector<std::string> steps;
-    
+template <typename Tracer, typename Array = std::vector<int>>
+void quickSort(Array arr, Tracer& tracer) {
     // Add initial state
-    steps.push_back(arrayToJson(arr));
-    
+    tracer.highlight(arr);
+
     // Call the recursive helper function
-    quickSortHelper(arr, 0, arr.size() - 1, steps);
-    
+    quickSortHelper(arr, 0, arr.size() - 1, tracer);
+
     // Add final state
-    steps.push_back(arrayToJson(arr));
-    
-    return steps;
+    tracer.highlight(arr);
 }
 
 // Heapify a subtree rooted at index i
-void heapify(std::vector<int>& arr, int n, int i, std::vector<std::string>& steps) {
+template <typename Tracer, typename Array>
+void heapify(Array& arr, int n, int i, Tracer& tracer) {
     int largest = i; // Initialize largest as root
     int left = 2 * i + 1; // left = 2*i + 1
     int right = 2 * i + 2; // right = 2*i + 2
-    
+
     // Highlight current root
-    steps.push_back(arrayToJson(arr, i));
-    
+    tracer.highlight(arr, i);
+
     // If left child is larger than root
-    if (left < n && arr[left] > arr[largest]) {
-        steps.push_back(arrayToJson(arr, left, largest));
-        largest = left;
+    if (left < n) {
+        tracer.compare(arr, left, largest);
+        if (arr[left] > arr[largest])
+            largest = left;
     }
-    
+
     // If right child is larger than largest so far
-    if (right < n && arr[right] > arr[largest]) {
-        steps.push_back(arrayToJson(arr, right, largest));
-        largest = right;
+    if (right < n) {
+        tracer.compare(arr, right, largest);
+        if (arr[right] > arr[largest])
+            largest = right;
     }
-    
+
     // If largest is not root
     if (largest != i) {
-        steps.push_back(arrayToJson(arr, i, largest));
+        tracer.highlight(arr, i, largest);
         std::swap(arr[i], arr[largest]);
-        
+
         // Show after swap
-        steps.push_back(arrayToJson(arr, i, largest));
-        
+        tracer.swap(arr, i, largest);
+
         // Recursively heapify the affected sub-tree
-        heapify(arr, n, largest, steps);
+        heapify(arr, n, largest, tracer);
     }
 }
 
 // Heap Sort function
-std::vector<std::string> heapSort(std::vector<int> arr) {
-    std::vector<std::string> steps;
-    
+template <typename Tracer, typename Array = std::vector<int>>
+void heapSort(Array arr, Tracer& tracer) {
     // Add initial state
-    steps.push_back(arrayToJson(arr));
-    
+    tracer.highlight(arr);
+
     int n = arr.size();
-    
+
     // Build heap (rearrange array)
     for (int i = n / 2 - 1; i >= 0; i--) {
-        steps.push_back(arrayToJson(arr, i));
-        heapify(arr, n, i, steps);
+        tracer.highlight(arr, i);
+        heapify(arr, n, i, tracer);
     }
-    
+
     // Add state after heap is built
-    steps.push_back(arrayToJson(arr));
-    
+    tracer.highlight(arr);
+
     // One by one extract an element from heap
     for (int i = n - 1; i > 0; i--) {
         // Move current root to end
-        steps.push_back(arrayToJson(arr, 0, i));
+        tracer.highlight(arr, 0, i);
         std::swap(arr[0], arr[i]);
-        
+
         // Show after swap
-        steps.push_back(arrayToJson(arr, i));
-        
+        tracer.swap(arr, 0, i);
+
         // Call max heapify on the reduced heap
-        heapify(arr, i, 0, steps);
+        heapify(arr, i, 0, tracer);
     }
-    
+
     // Add final state
-    steps.push_back(arrayToJson(arr));
-    
-    return steps;
+    tracer.highlight(arr);
+}
+
+// Predicted cost of tracing a sort of n elements of the given shape in the
+// given format (see cost_model.h); false for an unknown algorithm. The frame
+// counts are those of CountingTracer: selection sort's is exact, bubble and
+// insertion sort move about half of the pairs they compare on random input
+// and all of them on reversed input. Quick sort compares and swaps every
+// pair on sorted input, and on the other orders it degrades on it is
+// quadratic in the length of the sorted runs or of the runs of equal values.
+// Orders that make a sort cheaper than on random input are not credited.
+bool estimateSortCost(const std::string& algorithm, size_t n, const InputShape& shape, const TraceOptions& options,
+                      CostEstimate& cost) {
+    double size = static_cast<double>(n);
+    double pairs = size * (size - 1) / 2;
+    bool reversed = shape.order == InputOrder::Reversed;
+    double frames;
+    if (algorithm == "bubble") {
+        frames = 2 + (reversed ? 2 : 1.5) * pairs;
+    } else if (algorithm == "insertion") {
+        // A compare and a write per shift, a highlight and a write per pass
+        frames = 2 + (reversed ? 2 : 1) * pairs + 2 * std::max(size - 1, 0.0);
+    } else if (algorithm == "selection") {
+        frames = 2 + pairs + 3 * std::max(size - 1, 0.0);
+    } else if (algorithm == "merge") {
+        frames = 2 + 2 * costNLogN(n) + 0.75 * size;
+    } else if (algorithm == "quick") {
+        double quadratic = 0;
+        switch (shape.order) {
+            case InputOrder::Sorted: quadratic = 2 * pairs; break;
+            case InputOrder::Reversed: quadratic = 1.5 * pairs; break;
+            case InputOrder::OrganPipe: quadratic = 0.31 * pairs; break;
+            case InputOrder::NearlySorted:
+                quadratic = std::min(2 * pairs, 4 * pairs / (std::max<size_t>(shape.swaps, 1) + 1));
+                break;
+            case InputOrder::FewUnique: quadratic = std::min(2 * pairs, pairs / std::max<size_t>(shape.unique, 1)); break;
+            default: break;
+        }
+        frames = 2 + quadratic + 1.82 * costNLogN(n);
+    } else if (algorithm == "heap") {
+        frames = 2 + 4.57 * costNLogN(n);
+    } else {
+        return false;
+    }
+
+    // Snapshot elements are {"value":V,"highlight":false}, buckets add a
+    // min and a max, delta records are ["c",i,j] and binary ones an opcode
+    // and two varints
+    double frameBytes;
+    if (options.binary) {
+        frameBytes = 1 + 2 * costVarintBytes(n);
+    } else if (options.delta) {
+        frameBytes = 7 + 2 * costDigits(n);
+    } else if (options.resolution > 0) {
+        frameBytes = 2 + 50 * static_cast<double>(std::min(options.resolution, n));
+    } else {
+        frameBytes = 2 + 34 * size;
+    }
+    setCostEstimate(cost, frames, frameBytes);
+    return true;
 }
 
-#endif // SORTING_H
\ No newline at end of file
+#endif // SORTING_H
@@ -0,0 +1,72 @@
+#ifndef STATUS_TEXT_H
+#define STATUS_TEXT_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+
+// Status line of a search or graph frame, appended piece by piece into a
+// buffer that the tracer owns, e.g.
+//   status << "Discovering edge " << current << " -> " << neighbor;
+// The buffer is reused for every frame, so once it has grown to fit the
+// longest status, describing a frame no longer allocates.
+//
+// Given an 'operands' list, numbers are not written out: each one leaves
+// STATUS_OPERAND in the text and is appended to the list, so the text is
+// the same template for every frame of that kind (see BinaryTracer).
+const char STATUS_OPERAND = '\0';
+
+class StatusText {
+public:
+    explicit StatusText(std::string& out, std::vector<int64_t>* operands = nullptr) : out(out), operands(operands) {}
+
+    StatusText& operator<<(std::string_view text) {
+        out.append(text.data(), text.size());
+        return *this;
+    }
+
+    StatusText& operator<<(int value) { return number(value); }
+    StatusText& operator<<(size_t value) { return number(value); }
+
+private:
+    template <typename Integer>
+    StatusText& number(Integer value) {
+        if (operands) {
+            out += STATUS_OPERAND;
+            operands->push_back(static_cast<int64_t>(value));
+            return *this;
+        }
+        char buf[24];
+        auto result = std::to_chars(buf, buf + sizeof(buf), value);
+        out.append(buf, result.ptr - buf);
+        return *this;
+    }
+
+    std::string& out;
+    std::vector<int64_t>* operands;
+};
+
+// Run a describe callable (see tracer.h) into 'buffer' and return the text,
+// which stays valid until the buffer is next used
+template <typename Describe>
+std::string_view renderStatus(std::string& buffer, Describe& describe) {
+    buffer.clear();
+    StatusText status(buffer);
+    describe(status);
+    return buffer;
+}
+
+// The same as a template, its numbers in 'operands' (cleared first)
+template <typename Describe>
+std::string_view renderStatusTemplate(std::string& buffer, std::vector<int64_t>& operands, Describe& describe) {
+    buffer.clear();
+    operands.clear();
+    StatusText status(buffer, &operands);
+    describe(status);
+    return buffer;
+}
+
+#endif // STATUS_TEXT_H
@@ -0,0 +1,503 @@
+#ifndef TRACER_H
+#define TRACER_H
+
+#include <vector>
+#include <string>
+#include <cstddef>
+#include <chrono>
+#include <memory>
+#include <unordered_map>
+
+#include "sorting.h"
+#include "searching.h"
+#include "graph.h"
+#include "json_writer.h"
+#include "binary_trace.h"
+#include "status_text.h"
+#include "phase_timer.h"
+
+// Tracer policies for the algorithm templates in sorting.h, searching.h and
+// graph.h. An algorithm is instantiated with one of these and calls it at
+// every point a visualization frame could be taken; the policy decides what
+// that costs. Status text is passed as a callable that writes it into a
+// StatusText (status_text.h), so it is only built when a tracer actually
+// renders it, and then into a buffer the tracer reuses.
+//
+// The rendering tracers take setFrameTimes() to sum how long rendering and
+// pushing frames took, for request phase tracing.
+//
+//   JsonTracer      one full JSON snapshot per frame (the classic format)
+//   DeltaTracer     one compact change record per frame
+//   BinaryTracer    the delta records in the binary encoding of binary_trace.h
+//   BucketTracer    snapshots down-sampled to a fixed number of min/max buckets
+//   CountingTracer  counts frames and operations, renders nothing
+//   BudgetTracer    CountingTracer that abandons the run at a deadline
+//   NullTracer      does nothing; the algorithm compiles to its plain form
+
+// Renders frames into one reused JsonWriter buffer (or BinaryWriter) and
+// pushes them to 'steps': any type with push_back(std::string), e.g. a
+// std::vector<std::string> to collect them, or a writer that streams them
+// out. Given a FrameTimes with setFrameTimes(), it also sums the time spent
+// rendering and pushing.
+template <typename StepSink, typename Writer = JsonWriter>
+class FrameEmitter {
+public:
+    explicit FrameEmitter(StepSink& steps) : steps(steps), times(nullptr) {}
+
+    void setFrameTimes(FrameTimes* frameTimes) { times = frameTimes; }
+
+    // 'render' appends one frame to the Writer it is passed
+    template <typename Render>
+    void emit(Render render) {
+        {
+            PhaseSpan span(times ? &times->render : nullptr);
+            frame.clear();
+            render(frame);
+        }
+        PhaseSpan span(times ? &times->sink : nullptr);
+        steps.push_back(frame.str());
+        if (times) ++times->frames;
+    }
+
+    // Status text of a describe callable, in a buffer reused for every frame
+    template <typename Describe>
+    std::string_view status(Describe& describe) {
+        return renderStatus(statusText, describe);
+    }
+
+    // The same as a template, its numbers in 'operands' (see StatusText)
+    template <typename Describe>
+    std::string_view statusTemplate(std::vector<int64_t>& operands, Describe& describe) {
+        return renderStatusTemplate(statusText, operands, describe);
+    }
+
+private:
+    StepSink& steps;
+    Writer frame;
+    std::string statusText;
+    FrameTimes* times;
+};
+
+// Full JSON snapshots, one per frame
+template <typename StepSink>
+class JsonTracer {
+public:
+    explicit JsonTracer(StepSink& steps) : out(steps) {}
+
+    void setFrameTimes(FrameTimes* times) { out.setFrameTimes(times); }
+
+    // Sorting
+    void highlight(const std::vector<int>& arr, int i = -1, int j = -1) { arrayFrame(arr, i, j); }
+    void compare(const std::vector<int>& arr, int i, int j) { arrayFrame(arr, i, j); }
+    void swap(const std::vector<int>& arr, int i, int j) { arrayFrame(arr, i, j); }
+    void write(const std::vector<int>& arr, int i) { arrayFrame(arr, i, -1); }
+
+    // Searching
+    template <typename Describe>
+    void probe(const std::vector<int>& arr, int pos, Describe describe) {
+        out.emit([&](JsonWriter& frame) { writeSearchStateJson(frame, arr, pos, out.status(describe)); });
+    }
+
+    template <typename Describe>
+    void state(const std::vector<int>& arr, int pos, Describe describe) {
+        probe(arr, pos, describe);
+    }
+
+    // Graphs
+    template <typename Describe>
+    void visit(const AdjacencyList& graph, const std::vector<int>& visited, int current, Describe describe) {
+        out.emit([&](JsonWriter& frame) {
+            writeGraphStateJson(frame, graph, visited, current, out.status(describe));
+        });
+    }
+
+    template <typename Describe>
+    void edge(const AdjacencyList& graph, const std::vector<int>& visited, int current, Describe describe) {
+        visit(graph, visited, current, describe);
+    }
+
+    template <typename Describe>
+    void state(const AdjacencyList& graph, const std::vector<int>& visited, int current, Describe describe) {
+        visit(graph, visited, current, describe);
+    }
+
+private:
+    void arrayFrame(const std::vector<int>& arr, int i, int j) {
+        out.emit([&](JsonWriter& frame) { writeArrayJson(frame, arr, i, j); });
+    }
+
+    FrameEmitter<StepSink> out;
+};
+
+// Change records relative to data the client already has (the initial array
+// or the graph), so trace size is O(frames) rather than O(n * frames).
+//   Sorting:   ["h"] / ["h",i] / ["h",i,j]  highlight
+//              ["c",i,j]                    compare
+//              ["s",i,j]                    swap, then highlight i and j
+//              ["w",i,v]                    arr[i] = v, then highlight i
+//   Searching: {"pos":i,"status":"..."}
+//   Graphs:    {"current":c,"visited":[nodes visited since the last frame],"status":"..."}
+template <typename StepSink>
+class DeltaTracer {
+public:
+    explicit DeltaTracer(StepSink& steps) : out(steps), visitedSent(0) {}
+
+    void setFrameTimes(FrameTimes* times) { out.setFrameTimes(times); }
+
+    // Sorting
+    void highlight(const std::vector<int>&, int i = -1, int j = -1) {
+        out.emit([&](JsonWriter& frame) {
+            frame.raw("[\"h\"");
+            if (i >= 0 || j >= 0) frame.raw(',').number(i);
+            if (j >= 0) frame.raw(',').number(j);
+            frame.raw(']');
+        });
+    }
+
+    void compare(const std::vector<int>&, int i, int j) { op("[\"c\",", i, j); }
+    void swap(const std::vector<int>&, int i, int j) { op("[\"s\",", i, j); }
+    void write(const std::vector<int>& arr, int i) { op("[\"w\",", i, arr[i]); }
+
+    // Searching
+    template <typename Describe>
+    void probe(const std::vector<int>&, int pos, Describe describe) {
+        out.emit([&](JsonWriter& frame) {
+            frame.raw("{\"pos\":").number(pos).raw(",\"status\":").string(out.status(describe)).raw('}');
+        });
+    }
+
+    template <typename Describe>
+    void state(const std::vector<int>& arr, int pos, Describe describe) {
+        probe(arr, pos, describe);
+    }
+
+    // Graphs
+    template <typename Describe>
+    void visit(const AdjacencyList&, const std::vector<int>& visited, int current, Describe describe) {
+        out.emit([&](JsonWriter& frame) {
+            frame.raw("{\"current\":").number(current).raw(",\"visited\":[");
+            for (size_t i = visitedSent; i < visited.size(); ++i) {
+                if (i > visitedSent) frame.raw(',');
+                frame.number(visited[i]);
+            }
+            frame.raw("],\"status\":").string(out.status(describe)).raw('}');
+        });
+        visitedSent = visited.size();
+    }
+
+    template <typename Describe>
+    void edge(const AdjacencyList& graph, const std::vector<int>& visited, int current, Describe describe) {
+        visit(graph, visited, current, describe);
+    }
+
+    template <typename Describe>
+    void state(const AdjacencyList& graph, const std::vector<int>& visited, int current, Describe describe) {
+        visit(graph, visited, current, describe);
+    }
+
+private:
+    // 'prefix' is the opening of the record, e.g. ["s",
+    template <size_t N>
+    void op(const char (&prefix)[N], int a, int b) {
+        out.emit([&](JsonWriter& frame) { frame.raw(prefix).number(a).raw(',').number(b).raw(']'); });
+    }
+
+    FrameEmitter<StepSink> out;
+    size_t visitedSent; // Prefix of the graph algorithm's visited list already sent
+};
+
+// The records of DeltaTracer in the application/x-algo-trace encoding (see
+// binary_trace.h), a few bytes each. Status strings are sent once, in a
+// STRING record ahead of the first frame that uses them, and referred to
+// by number after that.
+template <typename StepSink>
+class BinaryTracer {
+public:
+    explicit BinaryTracer(StepSink& steps) : out(steps), visitedSent(0) {}
+
+    void setFrameTimes(FrameTimes* times) { out.setFrameTimes(times); }
+
+    // Sorting
+    void highlight(const std::vector<int>&, int i = -1, int j = -1) {
+        out.emit([&](BinaryWriter& frame) { frame.byte(TRACE_HIGHLIGHT).varint(i + 1).varint(j + 1); });
+    }
+
+    void compare(const std::vector<int>&, int i, int j) {
+        out.emit([&](BinaryWriter& frame) { frame.byte(TRACE_COMPARE).varint(i).varint(j); });
+    }
+
+    void swap(const std::vector<int>&, int i, int j) {
+        out.emit([&](BinaryWriter& frame) { frame.byte(TRACE_SWAP).varint(i).varint(j); });
+    }
+
+    void write(const std::vector<int>& arr, int i) {
+        out.emit([&](BinaryWriter& frame) { frame.byte(TRACE_WRITE).varint(i).signedVarint(arr[i]); });
+    }
+
+    // Searching
+    template <typename Describe>
+    void probe(const std::vector<int>&, int pos, Describe describe) {
+        out.emit([&](BinaryWriter& frame) {
+            uint32_t status = intern(frame, describe);
+            frame.byte(TRACE_PROBE).varint(pos + 1);
+            writeStatus(frame, status);
+        });
+    }
+
+    template <typename Describe>
+    void state(const std::vector<int>& arr, int pos, Describe describe) {
+        probe(arr, pos, describe);
+    }
+
+    // Graphs
+    template <typename Describe>
+    void visit(const AdjacencyList&, const std::vector<int>& visited, int current, Describe describe) {
+        out.emit([&](BinaryWriter& frame) {
+            uint32_t status = intern(frame, describe);
+            frame.byte(TRACE_VISIT).varint(current + 1).varint(visited.size() - visitedSent);
+            for (size_t i = visitedSent; i < visited.size(); ++i) frame.varint(visited[i]);
+            writeStatus(frame, status);
+        });
+        visitedSent = visited.size();
+    }
+
+    template <typename Describe>
+    void edge(const AdjacencyList& graph, const std::vector<int>& visited, int current, Describe describe) {
+        visit(graph, visited, current, describe);
+    }
+
+    template <typename Describe>
+    void state(const AdjacencyList& graph, const std::vector<int>& visited, int current, Describe describe) {
+        visit(graph, visited, current, describe);
+    }
+
+private:
+    // Number of the frame's status template in the table, defining it in
+    // 'frame' first if it is new. The status's numbers are left in
+    // 'operands', so the table holds one entry per kind of status however
+    // many indices and values the frames mention.
+    template <typename Describe>
+    uint32_t intern(BinaryWriter& frame, Describe& describe) {
+        lookup.assign(out.statusTemplate(operands, describe));
+        auto found = statuses.find(lookup);
+        if (found != statuses.end()) return found->second;
+        uint32_t id = static_cast<uint32_t>(statuses.size());
+        statuses.emplace(lookup, id);
+        frame.byte(TRACE_STRING).varint(lookup.size()).bytes(lookup);
+        return id;
+    }
+
+    void writeStatus(BinaryWriter& frame, uint32_t status) {
+        frame.varint(status);
+        for (int64_t operand : operands) frame.signedVarint(operand);
+    }
+
+    FrameEmitter<StepSink, BinaryWriter> out;
+    size_t visitedSent; // Prefix of the graph algorithm's visited list already sent
+    std::unordered_map<std::string, uint32_t> statuses;
+    std::string lookup; // Reused key, so looking up a known status does not allocate
+    std::vector<int64_t> operands; // Numbers of the current frame's status
+};
+
+// Snapshot frames down-sampled to at most 'resolution' buckets (see
+// ArrayBuckets), so a frame is O(resolution) however large the array is.
+// The buckets are kept current from the swap and write events rather than
+// recomputed per frame. Sorting frames are bucket arrays; searching frames
+// are {"array":buckets,"status":"..."}; graph frames are not down-sampled.
+template <typename StepSink>
+class BucketTracer {
+public:
+    BucketTracer(StepSink& steps, size_t resolution) : out(steps), resolution(resolution) {}
+
+    void setFrameTimes(FrameTimes* times) { out.setFrameTimes(times); }
+
+    // Sorting
+    void highlight(const std::vector<int>& arr, int i = -1, int j = -1) { bucketFrame(view(arr), i, j); }
+    void compare(const std::vector<int>& arr, int i, int j) { bucketFrame(view(arr), i, j); }
+
+    void swap(const std::vector<int>& arr, int i, int j) {
+        view(arr).update(arr, i);
+        buckets->update(arr, j);
+        bucketFrame(*buckets, i, j);
+    }
+
+    void write(const std::vector<int>& arr, int i) {
+        view(arr).update(arr, i);
+        bucketFrame(*buckets, i, -1);
+    }
+
+    // Searching
+    template <typename Describe>
+    void probe(const std::vector<int>& arr, int pos, Describe describe) {
+        const ArrayBuckets& current = view(arr);
+        out.emit([&](JsonWriter& frame) {
+            frame.raw("{\"array\":");
+            current.write(frame, pos);
+            frame.raw(",\"status\":").string(out.status(describe)).raw('}');
+        });
+    }
+
+    template <typename Describe>
+    void state(const std::vector<int>& arr, int pos, Describe describe) {
+        probe(arr, pos, describe);
+    }
+
+    // Graphs
+    template <typename Describe>
+    void visit(const AdjacencyList& graph, const std::vector<int>& visited, int current, Describe describe) {
+        out.emit([&](JsonWriter& frame) {
+            writeGraphStateJson(frame, graph, visited, current, out.status(describe));
+        });
+    }
+
+    template <typename Describe>
+    void edge(const AdjacencyList& graph, const std::vector<int>& visited, int current, Describe describe) {
+        visit(graph, visited, current, describe);
+    }
+
+    template <typename Describe>
+    void state(const AdjacencyList& graph, const std::vector<int>& visited, int current, Describe describe) {
+        visit(graph, visited, current, describe);
+    }
+
+private:
+    // Built from the first frame's array
+    ArrayBuckets& view(const std::vector<int>& arr) {
+        if (!buckets) buckets.reset(new ArrayBuckets(arr, resolution));
+        return *buckets;
+    }
+
+    void bucketFrame(const ArrayBuckets& current, int i, int j) {
+        out.emit([&](JsonWriter& frame) { current.write(frame, i, j); });
+    }
+
+    FrameEmitter<StepSink> out;
+    size_t resolution;
+    std::unique_ptr<ArrayBuckets> buckets;
+};
+
+// Counts what a visualized run would show without rendering any of it
+class CountingTracer {
+public:
+    size_t steps = 0;       // Frames a JsonTracer would have produced
+    size_t comparisons = 0; // Sort comparisons and search probes
+    size_t swaps = 0;
+    size_t writes = 0;
+    size_t nodeVisits = 0;
+    size_t edgeChecks = 0;
+
+    // Sorting, of any Array (see sorting.h)
+    template <typename Array>
+    void highlight(const Array&, int = -1, int = -1) { ++steps; }
+    template <typename Array>
+    void compare(const Array&, int, int) { ++steps; ++comparisons; }
+    template <typename Array>
+    void swap(const Array&, int, int) { ++steps; ++swaps; }
+    template <typename Array>
+    void write(const Array&, int) { ++steps; ++writes; }
+
+    // Searching
+    template <typename Describe>
+    void probe(const std::vector<int>&, int, Describe) { ++steps; ++comparisons; }
+
+    template <typename Describe>
+    void state(const std::vector<int>&, int, Describe) { ++steps; }
+
+    // Graphs
+    template <typename Describe>
+    void visit(const AdjacencyList&, const std::vector<int>&, int, Describe) { ++steps; ++nodeVisits; }
+
+    template <typename Describe>
+    void edge(const AdjacencyList&, const std::vector<int>&, int, Describe) { ++steps; ++edgeChecks; }
+
+    template <typename Describe>
+    void state(const AdjacencyList&, const std::vector<int>&, int, Describe) { ++steps; }
+};
+
+// Thrown out of an algorithm by BudgetTracer once its deadline has passed
+struct TraceBudgetExceeded {};
+
+// Counts like CountingTracer, and throws TraceBudgetExceeded from the first
+// event after 'deadline'. The clock is only read every CHECK_INTERVAL events,
+// so the overrun is bounded by that many operations.
+class BudgetTracer : public CountingTracer {
+public:
+    explicit BudgetTracer(std::chrono::steady_clock::time_point deadline) : deadline(deadline), events(0) {}
+
+    // Sorting, of any Array (see sorting.h)
+    template <typename Array>
+    void highlight(const Array& arr, int i = -1, int j = -1) { CountingTracer::highlight(arr, i, j); tick(); }
+    template <typename Array>
+    void compare(const Array& arr, int i, int j) { CountingTracer::compare(arr, i, j); tick(); }
+    template <typename Array>
+    void swap(const Array& arr, int i, int j) { CountingTracer::swap(arr, i, j); tick(); }
+    template <typename Array>
+    void write(const Array& arr, int i) { CountingTracer::write(arr, i); tick(); }
+
+    // Searching
+    template <typename Describe>
+    void probe(const std::vector<int>& arr, int pos, Describe describe) { CountingTracer::probe(arr, pos, describe); tick(); }
+
+    template <typename Describe>
+    void state(const std::vector<int>& arr, int pos, Describe describe) { CountingTracer::state(arr, pos, describe); tick(); }
+
+    // Graphs
+    template <typename Describe>
+    void visit(const AdjacencyList& graph, const std::vector<int>& visited, int current, Describe describe) {
+        CountingTracer::visit(graph, visited, current, describe);
+        tick();
+    }
+
+    template <typename Describe>
+    void edge(const AdjacencyList& graph, const std::vector<int>& visited, int current, Describe describe) {
+        CountingTracer::edge(graph, visited, current, describe);
+        tick();
+    }
+
+    template <typename Describe>
+    void state(const AdjacencyList& graph, const std::vector<int>& visited, int current, Describe describe) {
+        CountingTracer::state(graph, visited, current, describe);
+        tick();
+    }
+
+private:
+    static const size_t CHECK_INTERVAL = 4096;
+
+    void tick() {
+        if (++events % CHECK_INTERVAL == 0 && std::chrono::steady_clock::now() >= deadline) {
+            throw TraceBudgetExceeded();
+        }
+    }
+
+    std::chrono::steady_clock::time_point deadline;
+    size_t events;
+};
+
+// Untraced runs: every call is empty and inlines away
+class NullTracer {
+public:
+    // Sorting
+    void highlight(const std::vector<int>&, int = -1, int = -1) {}
+    void compare(const std::vector<int>&, int, int) {}
+    void swap(const std::vector<int>&, int, int) {}
+    void write(const std::vector<int>&, int) {}
+
+    // Searching
+    template <typename Describe>
+    void probe(const std::vector<int>&, int, Describe) {}
+
+    template <typename Describe>
+    void state(const std::vector<int>&, int, Describe) {}
+
+    // Graphs
+    template <typename Describe>
+    void visit(const AdjacencyList&, const std::vector<int>&, int, Describe) {}
+
+    template <typename Describe>
+    void edge(const AdjacencyList&, const std::vector<int>&, int, Describe) {}
+
+    template <typename Describe>
+    void state(const AdjacencyList&, const std::vector<int>&, int, Describe) {}
+};
+
+#endif // TRACER_H
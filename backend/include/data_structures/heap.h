@@ -6,30 +6,27 @@
 #include <sstream>
 #include <algorithm>
 
-// Global heap for visualization
-static std::vector<int> heapArray;
+#include "algorithms/json_writer.h"
 
-// Convert heap to JSON for visualization
+// Convert heap to a JSON member for visualization, e.g. "heap":[...]; callers
+// wrap it in the braces of their frame object
 std::string heapToJson(const std::vector<int>& heap, int highlightIndex = -1, int highlightIndex2 = -1) {
-    std::ostringstream json;
-    json << "{\"heap\":[";
+    JsonWriter json;
+    json.raw("\"heap\":[");
     
     for (size_t i = 0; i < heap.size(); ++i) {
-        if (i > 0) json << ",";
-        
-        json << "{\"value\":" << heap[i];
+        if (i > 0) json.raw(',');
         
+        json.raw("{\"value\":").number(heap[i]);
         if (i == highlightIndex || i == highlightIndex2) {
-            json << ",\"highlight\":true";
+            json.raw(",\"highlight\":true}");
         } else {
-            json << ",\"highlight\":false";
+            json.raw(",\"highlight\":false}");
         }
-        
-        json << "}";
     }
     
-    json << "]}";
-    return json.str();
+    json.raw(']');
+    return json.release();
 }
 
 // Helper function to get status text with indices
@@ -115,8 +112,11 @@ void buildHeapWithVisualization(std::vector<int>& heap, std::vector<std::string>
                    ",\"status\":\"Max heap built successfully\"}");
 }
 
+// The operations below act on the heap passed as heapArray; each client
+// session has its own (see session_store.h)
+
 // Heap insert operation
-std::vector<std::string> heapInsert(int value) {
+std::vector<std::string> heapInsert(std::vector<int>& heapArray, int value) {
     std::vector<std::string> steps;
     
     // Add initial state
@@ -166,7 +166,7 @@ std::vector<std::string> heapInsert(int value) {
 }
 
 // Heap extract max operation
-std::vector<std::string> heapExtractMax() {
+std::vector<std::string> heapExtractMax(std::vector<int>& heapArray) {
     std::vector<std::string> steps;
     
     // Add initial state
@@ -207,7 +207,7 @@ std::vector<std::string> heapExtractMax() {
 }
 
 // Create a new heap from an array
-std::vector<std::string> createHeap(const std::vector<int>& array) {
+std::vector<std::string> createHeap(std::vector<int>& heapArray, const std::vector<int>& array) {
     std::vector<std::string> steps;
     
     // Add initial state
@@ -226,7 +226,7 @@ std::vector<std::string> createHeap(const std::vector<int>& array) {
 }
 
 // Clear the heap
-std::vector<std::string> clearHeap() {
+std::vector<std::string> clearHeap(std::vector<int>& heapArray) {
     std::vector<std::string> steps;
     
     // Add initial state
@@ -8,6 +8,8 @@
 #include <algorithm>
 #include <memory>
 
+#include "algorithms/json_writer.h"
+
 // Binary Search Tree Node
 struct TreeNode {
     int value;
@@ -17,29 +19,50 @@ struct TreeNode {
     TreeNode(int val) : value(val), left(nullptr), right(nullptr) {}
 };
 
-// Global BST root for visualization
-static std::shared_ptr<TreeNode> bstRoot = nullptr;
+// Append a tree as JSON for visualization
+void writeTreeJson(JsonWriter& json, const std::shared_ptr<TreeNode>& root, int highlightValue, bool isFound) {
+    if (!root) {
+        json.raw("null");
+        return;
+    }
+    
+    json.raw("{\"value\":").number(root->value);
+    json.raw(",\"highlight\":").boolean(root->value == highlightValue);
+    json.raw(",\"found\":").boolean(isFound && root->value == highlightValue);
+    json.raw(",\"left\":");
+    writeTreeJson(json, root->left, highlightValue, isFound);
+    json.raw(",\"right\":");
+    writeTreeJson(json, root->right, highlightValue, isFound);
+    json.raw('}');
+}
 
 // Convert tree to JSON for visualization
 std::string treeToJson(std::shared_ptr<TreeNode> root, int highlightValue = -1, bool isFound = false) {
-    if (!root) {
-        return "null";
+    JsonWriter json;
+    writeTreeJson(json, root, highlightValue, isFound);
+    return json.release();
+}
+
+// Number of nodes in a tree
+size_t bstNodeCount(const std::shared_ptr<TreeNode>& root) {
+    size_t count = 0;
+    std::vector<TreeNode*> pending;
+    if (root) pending.push_back(root.get());
+    while (!pending.empty()) {
+        TreeNode* node = pending.back();
+        pending.pop_back();
+        ++count;
+        if (node->left) pending.push_back(node->left.get());
+        if (node->right) pending.push_back(node->right.get());
     }
-    
-    std::ostringstream json;
-    json << "{";
-    json << "\"value\":" << root->value << ",";
-    json << "\"highlight\":" << (root->value == highlightValue ? "true" : "false") << ",";
-    json << "\"found\":" << (isFound && root->value == highlightValue ? "true" : "false") << ",";
-    json << "\"left\":" << treeToJson(root->left, highlightValue, isFound) << ",";
-    json << "\"right\":" << treeToJson(root->right, highlightValue, isFound);
-    json << "}";
-    
-    return json.str();
+    return count;
 }
 
+// The operations below act on the tree whose root is passed as bstRoot; each
+// client session has its own (see session_store.h)
+
 // BST Insert operation
-std::vector<std::string> bstInsert(int value) {
+std::vector<std::string> bstInsert(std::shared_ptr<TreeNode>& bstRoot, int value) {
     std::vector<std::string> steps;
     
     // Add initial state
@@ -92,7 +115,7 @@ std::vector<std::string> bstInsert(int value) {
 }
 
 // BST Search operation
-std::vector<std::string> bstSearch(int value) {
+std::vector<std::string> bstSearch(const std::shared_ptr<TreeNode>& bstRoot, int value) {
     std::vector<std::string> steps;
     
     // Add initial state
@@ -150,8 +173,9 @@ std::shared_ptr<TreeNode> findMinValueNode(std::shared_ptr<TreeNode> node) {
     return current;
 }
 
-// Helper function for BST deletion
-std::shared_ptr<TreeNode> deleteNodeHelper(std::shared_ptr<TreeNode> root, int value, std::vector<std::string>& steps) {
+// Helper function for BST deletion; bstRoot is the whole tree, for the frames
+std::shared_ptr<TreeNode> deleteNodeHelper(const std::shared_ptr<TreeNode>& bstRoot, std::shared_ptr<TreeNode> root,
+                                           int value, std::vector<std::string>& steps) {
     // Base case
     if (!root) {
         return nullptr;
@@ -165,11 +189,11 @@ std::shared_ptr<TreeNode> deleteNodeHelper(std::shared_ptr<TreeNode> root, int v
     if (value < root->value) {
         steps.push_back("{\"tree\":" + treeToJson(bstRoot, root->value) + 
                        ",\"status\":\"" + std::to_string(value) + " < " + std::to_string(root->value) + ", moving to left subtree\"}");
-        root->left = deleteNodeHelper(root->left, value, steps);
+        root->left = deleteNodeHelper(bstRoot, root->left, value, steps);
     } else if (value > root->value) {
         steps.push_back("{\"tree\":" + treeToJson(bstRoot, root->value) + 
                        ",\"status\":\"" + std::to_string(value) + " > " + std::to_string(root->value) + ", moving to right subtree\"}");
-        root->right = deleteNodeHelper(root->right, value, steps);
+        root->right = deleteNodeHelper(bstRoot, root->right, value, steps);
     } else {
         // Node to be deleted found
         steps.push_back("{\"tree\":" + treeToJson(bstRoot, root->value, true) + 
@@ -205,14 +229,14 @@ std::shared_ptr<TreeNode> deleteNodeHelper(std::shared_ptr<TreeNode> root, int v
         // Delete the successor
         steps.push_back("{\"tree\":" + treeToJson(bstRoot, temp->value) + 
                        ",\"status\":\"Now deleting the successor node " + std::to_string(temp->value) + " from right subtree\"}");
-        root->right = deleteNodeHelper(root->right, temp->value, steps);
+        root->right = deleteNodeHelper(bstRoot, root->right, temp->value, steps);
     }
     
     return root;
 }
 
 // BST Delete operation
-std::vector<std::string> bstDelete(int value) {
+std::vector<std::string> bstDelete(std::shared_ptr<TreeNode>& bstRoot, int value) {
     std::vector<std::string> steps;
     
     // Add initial state
@@ -225,7 +249,7 @@ std::vector<std::string> bstDelete(int value) {
     }
     
     // Delete the node
-    bstRoot = deleteNodeHelper(bstRoot, value, steps);
+    bstRoot = deleteNodeHelper(bstRoot, bstRoot, value, steps);
     
     // Final state
     steps.push_back("{\"tree\":" + treeToJson(bstRoot) + ",\"status\":\"Deletion complete\"}");
@@ -234,7 +258,7 @@ std::vector<std::string> bstDelete(int value) {
 }
 
 // Clear the BST
-std::vector<std::string> bstClear() {
+std::vector<std::string> bstClear(std::shared_ptr<TreeNode>& bstRoot) {
     std::vector<std::string> steps;
     
     // Add initial state
@@ -0,0 +1,14 @@
+#include "alloc_stats.h"
+
+void* CountingResource::do_allocate(size_t bytes, size_t alignment) {
+    void* p = upstream->allocate(bytes, alignment);
+    counted.allocations++;
+    counted.bytesInUse += static_cast<int64_t>(bytes);
+    if (counted.bytesInUse > counted.peakBytes) counted.peakBytes = counted.bytesInUse;
+    return p;
+}
+
+void CountingResource::do_deallocate(void* p, size_t bytes, size_t alignment) {
+    upstream->deallocate(p, bytes, alignment);
+    counted.bytesInUse -= static_cast<int64_t>(bytes);
+}
@@ -0,0 +1,35 @@
+#ifndef ALLOC_STATS_H
+#define ALLOC_STATS_H
+
+#include <cstdint>
+#include <cstddef>
+#include <memory_resource>
+
+// Heap used by a piece of work that allocates through a CountingResource
+struct AllocStats {
+    uint64_t allocations = 0;
+    int64_t bytesInUse = 0;
+    int64_t peakBytes = 0; // Highest bytesInUse so far
+};
+
+// A memory resource that counts the allocations made through it and hands
+// them on to 'upstream'. One is made for each piece of work to measure, e.g.
+// each sort of a race, so only that work pays for the counting. Its
+// counters are plain, so it is meant for use by one thread at a time.
+class CountingResource : public std::pmr::memory_resource {
+public:
+    explicit CountingResource(std::pmr::memory_resource* upstream = std::pmr::new_delete_resource())
+        : upstream(upstream) {}
+
+    const AllocStats& stats() const { return counted; }
+
+private:
+    void* do_allocate(size_t bytes, size_t alignment) override;
+    void do_deallocate(void* p, size_t bytes, size_t alignment) override;
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+
+    std::pmr::memory_resource* upstream;
+    AllocStats counted;
+};
+
+#endif // ALLOC_STATS_H
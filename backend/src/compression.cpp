@@ -0,0 +1,214 @@
+#include "compression.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cctype>
+#include <algorithm>
+
+#ifdef ALGO_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+// Size of the scratch buffer zlib deflates into; only the bytes it produced
+// are appended to the output
+static const size_t DEFLATE_STEP = 16 * 1024;
+
+const char* contentEncodingName(ContentEncoding encoding) {
+    switch (encoding) {
+        case ContentEncoding::Gzip: return "gzip";
+        case ContentEncoding::Deflate: return "deflate";
+        default: return "";
+    }
+}
+
+static bool sameToken(const std::string& text, size_t begin, size_t end, const char* token) {
+    size_t i = begin;
+    for (; i < end && *token; ++i, ++token) {
+        if (std::tolower(static_cast<unsigned char>(text[i])) != *token) return false;
+    }
+    return i == end && !*token;
+}
+
+ContentEncoding negotiateEncoding(const std::string& acceptEncoding) {
+#ifdef ALGO_HAVE_ZLIB
+    // Weight given to gzip, deflate and any other coding; -1 when unnamed
+    double gzip = -1, deflate = -1, any = -1;
+    size_t pos = 0;
+    while (pos < acceptEncoding.size()) {
+        size_t end = acceptEncoding.find(',', pos);
+        if (end == std::string::npos) end = acceptEncoding.size();
+
+        size_t begin = pos;
+        while (begin < end && std::isspace(static_cast<unsigned char>(acceptEncoding[begin]))) ++begin;
+        size_t tokenEnd = begin;
+        while (tokenEnd < end && acceptEncoding[tokenEnd] != ';' &&
+               !std::isspace(static_cast<unsigned char>(acceptEncoding[tokenEnd]))) {
+            ++tokenEnd;
+        }
+        double q = 1;
+        size_t param = acceptEncoding.find("q=", tokenEnd);
+        if (param < end) q = std::atof(acceptEncoding.c_str() + param + 2);
+
+        if (sameToken(acceptEncoding, begin, tokenEnd, "gzip") || sameToken(acceptEncoding, begin, tokenEnd, "x-gzip")) {
+            gzip = q;
+        } else if (sameToken(acceptEncoding, begin, tokenEnd, "deflate")) {
+            deflate = q;
+        } else if (sameToken(acceptEncoding, begin, tokenEnd, "*")) {
+            any = q;
+        }
+        pos = end + 1;
+    }
+    if (gzip < 0) gzip = any;
+    if (deflate < 0) deflate = any;
+
+    if (gzip > 0 && gzip >= deflate) return ContentEncoding::Gzip;
+    if (deflate > 0) return ContentEncoding::Deflate;
+#else
+    (void)acceptEncoding;
+#endif
+    return ContentEncoding::Identity;
+}
+
+#ifdef ALGO_HAVE_ZLIB
+
+struct StreamCompressor::State {
+    z_stream stream;
+    bool open = false;
+    Bytef scratch[DEFLATE_STEP];
+};
+
+StreamCompressor::StreamCompressor(ContentEncoding encoding, int level) : state(new State()) {
+    // Window bits above 15 ask zlib for a gzip wrapper instead of its own
+    int windowBits = encoding == ContentEncoding::Gzip ? 15 + 16 : 15;
+    state->open = deflateInit2(&state->stream, level, Z_DEFLATED, windowBits, 8, Z_DEFAULT_STRATEGY) == Z_OK;
+}
+
+StreamCompressor::~StreamCompressor() {
+    if (state->open) deflateEnd(&state->stream);
+}
+
+bool StreamCompressor::opened() const {
+    return state->open;
+}
+
+void StreamCompressor::deflateInto(const char* data, size_t length, int mode, std::string& out) {
+    if (!state->open) return;
+    z_stream& z = state->stream;
+    z.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+    z.avail_in = static_cast<uInt>(length);
+    for (;;) {
+        z.next_out = state->scratch;
+        z.avail_out = static_cast<uInt>(DEFLATE_STEP);
+        int result = deflate(&z, mode);
+        out.append(reinterpret_cast<const char*>(state->scratch), DEFLATE_STEP - z.avail_out);
+        // Done once the input is taken and, when flushing, zlib had room to spare
+        if (result == Z_STREAM_END || result == Z_STREAM_ERROR) break;
+        if (z.avail_in == 0 && (mode == Z_NO_FLUSH || z.avail_out > 0)) break;
+    }
+}
+
+void StreamCompressor::write(const char* data, size_t length, std::string& out) {
+    // zlib counts input in 32 bits
+    const size_t step = 1u << 30;
+    for (size_t done = 0; done < length; done += step) {
+        deflateInto(data + done, std::min(step, length - done), Z_NO_FLUSH, out);
+    }
+}
+
+void StreamCompressor::flush(std::string& out) {
+    deflateInto(nullptr, 0, Z_SYNC_FLUSH, out);
+}
+
+void StreamCompressor::finish(std::string& out) {
+    deflateInto(nullptr, 0, Z_FINISH, out);
+}
+
+#else
+
+// Never negotiated; bodies pass through unchanged
+struct StreamCompressor::State {};
+
+StreamCompressor::StreamCompressor(ContentEncoding, int) : state(new State()) {}
+StreamCompressor::~StreamCompressor() {}
+
+bool StreamCompressor::opened() const {
+    return false;
+}
+
+void StreamCompressor::deflateInto(const char* data, size_t length, int, std::string& out) {
+    out.append(data, length);
+}
+
+void StreamCompressor::write(const char* data, size_t length, std::string& out) {
+    deflateInto(data, length, 0, out);
+}
+
+void StreamCompressor::flush(std::string&) {}
+void StreamCompressor::finish(std::string&) {}
+
+#endif
+
+std::string CompressionStats::renderPrometheus() const {
+    char text[768];
+    std::snprintf(text, sizeof(text),
+                  "# HELP algo_compressed_responses_total Responses sent with a gzip or deflate content coding.\n"
+                  "# TYPE algo_compressed_responses_total counter\n"
+                  "algo_compressed_responses_total %llu\n"
+                  "# HELP algo_compression_input_bytes_total Body bytes of those responses before compression.\n"
+                  "# TYPE algo_compression_input_bytes_total counter\n"
+                  "algo_compression_input_bytes_total %llu\n"
+                  "# HELP algo_compression_output_bytes_total Body bytes of those responses as sent.\n"
+                  "# TYPE algo_compression_output_bytes_total counter\n"
+                  "algo_compression_output_bytes_total %llu\n",
+                  (unsigned long long)responses.load(std::memory_order_relaxed),
+                  (unsigned long long)bytesIn.load(std::memory_order_relaxed),
+                  (unsigned long long)bytesOut.load(std::memory_order_relaxed));
+    return text;
+}
+
+CompressingStream::CompressingStream(ResponseStream& out, StreamCompressor& compressor, CompressionStats& stats)
+    : out(out), compressor(compressor), stats(stats), bytesIn(0), bytesOut(0) {}
+
+void CompressingStream::write(const char* data, size_t length) {
+    bytesIn += length;
+    if (pending.size() + length < STREAM_BLOCK) {
+        pending.append(data, length);
+        return;
+    }
+    // A full block: compress what was held back and this write together,
+    // without copying the write
+    compressor.write(pending.data(), pending.size(), compressed);
+    compressor.write(data, length, compressed);
+    pending.clear();
+    flushBlock();
+}
+
+void CompressingStream::flushBlock() {
+    compressor.write(pending.data(), pending.size(), compressed);
+    pending.clear();
+    compressor.flush(compressed);
+    if (compressed.empty()) return;
+    out.write(compressed);
+    out.flush();
+    bytesOut += compressed.size();
+    compressed.clear();
+}
+
+void CompressingStream::finish() {
+    compressor.write(pending.data(), pending.size(), compressed);
+    pending.clear();
+    compressor.finish(compressed);
+    out.write(compressed);
+    bytesOut += compressed.size();
+    compressed.clear();
+    stats.add(bytesIn, bytesOut);
+}
+
+bool compressBody(const HttpResponse& response, ContentEncoding encoding, int level, std::string& out) {
+    StreamCompressor compressor(encoding, level);
+    if (!compressor.opened()) return false;
+    compressor.write(response.body.data(), response.body.size(), out);
+    for (const auto& part : response.bodyParts) compressor.write(part.data(), part.size(), out);
+    compressor.write(response.sharedBody.data, response.sharedBody.length, out);
+    compressor.finish(out);
+    return true;
+}
@@ -0,0 +1,112 @@
+#ifndef COMPRESSION_H
+#define COMPRESSION_H
+
+#include <string>
+#include <atomic>
+#include <memory>
+#include <cstdint>
+#include <cstddef>
+
+#include "http.h"
+
+// Content codings the server can apply to a response body. Without zlib
+// (ALGO_HAVE_ZLIB unset) only Identity is ever negotiated.
+enum class ContentEncoding {
+    Identity,
+    Gzip,
+    Deflate // The zlib format, as HTTP's "deflate" means
+};
+
+// Value of the Content-Encoding header, empty for Identity
+const char* contentEncodingName(ContentEncoding encoding);
+
+// The coding to use for a request's Accept-Encoding header: gzip if the
+// client takes it, else deflate, else none. Codings with q=0 are refused,
+// and "*" stands for any coding not named.
+ContentEncoding negotiateEncoding(const std::string& acceptEncoding);
+
+// Compresses a body that is produced in pieces. Input is collected until
+// flush() or finish(), which compress it into 'out' as a block the client
+// can decode on its own, so a streamed trace is readable chunk by chunk.
+class StreamCompressor {
+public:
+    // 'level' is zlib's, 1 (fastest) to 9 (smallest)
+    StreamCompressor(ContentEncoding encoding, int level);
+    ~StreamCompressor();
+
+    StreamCompressor(const StreamCompressor&) = delete;
+    StreamCompressor& operator=(const StreamCompressor&) = delete;
+
+    // False when zlib could not set up the coding, e.g. out of memory, or
+    // without zlib; nothing would be compressed, so the body must be sent
+    // as it is, without a Content-Encoding
+    bool opened() const;
+
+    // Compress [data, data + length) into 'out', holding back what zlib
+    // buffers until the next flush()
+    void write(const char* data, size_t length, std::string& out);
+
+    // Everything written so far, compressed into 'out'
+    void flush(std::string& out);
+
+    // The end of the body; nothing may be written after it
+    void finish(std::string& out);
+
+private:
+    void deflateInto(const char* data, size_t length, int mode, std::string& out);
+
+    struct State;
+    std::unique_ptr<State> state;
+};
+
+// Sizes of the bodies compressed, for /api/metrics
+struct CompressionStats {
+    std::atomic<uint64_t> responses{0};
+    std::atomic<uint64_t> bytesIn{0};
+    std::atomic<uint64_t> bytesOut{0};
+
+    void add(size_t in, size_t out) {
+        responses.fetch_add(1, std::memory_order_relaxed);
+        bytesIn.fetch_add(in, std::memory_order_relaxed);
+        bytesOut.fetch_add(out, std::memory_order_relaxed);
+    }
+
+    // Responses compressed and bytes before and after, in the Prometheus text format
+    std::string renderPrometheus() const;
+};
+
+// Passes a produced body on to 'out' compressed by 'compressor', which must
+// have opened, and counts it in 'stats' once finished. Writes are held back
+// until STREAM_BLOCK bytes have gathered, as many as a chunk of an
+// uncompressed stream, and then compressed and flushed to 'out' as a block
+// of their own. So zlib runs once per block rather than once per frame, and
+// a compressed stream reaches the client as often as an uncompressed one.
+class CompressingStream : public ResponseStream {
+public:
+    static const size_t STREAM_BLOCK = 64 * 1024;
+
+    CompressingStream(ResponseStream& out, StreamCompressor& compressor, CompressionStats& stats);
+
+    void write(const char* data, size_t length) override;
+    void flush() override { flushBlock(); }
+
+    // Compress what is left and the end of the body
+    void finish();
+
+private:
+    void flushBlock();
+
+    ResponseStream& out;
+    StreamCompressor& compressor;
+    CompressionStats& stats;
+    std::string compressed;
+    std::string pending; // Written since the last flushed block, not yet compressed
+    size_t bytesIn;
+    size_t bytesOut;
+};
+
+// The body of a buffered response compressed as a whole into 'out'; false,
+// with 'out' untouched, if the compressor did not open
+bool compressBody(const HttpResponse& response, ContentEncoding encoding, int level, std::string& out);
+
+#endif // COMPRESSION_H
@@ -0,0 +1,550 @@
+#include "disk_cache.h"
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <iostream>
+#include <filesystem>
+#include <system_error>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#ifdef ALGO_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+namespace fs = std::filesystem;
+
+// Segments are a quarter of the capacity, within these bounds, so that
+// compacting one frees a useful amount without rewriting much
+const size_t MIN_SEGMENT_BYTES = 1 << 20;
+const size_t MAX_SEGMENT_BYTES = 64 << 20;
+
+const uint32_t RECORD_MAGIC = 0x32524741; // "AGR2"
+const uint32_t INDEX_MAGIC = 0x31494741;  // "AGI1"
+const uint32_t INDEX_VERSION = 1;
+
+const char* const INDEX_FILE = "index.bin";
+const char* const INDEX_TEMP_FILE = "index.tmp";
+const char* const KEY_FILE = "key.bin";
+const char* const KEY_TEMP_FILE = "key.tmp";
+
+// Precedes every result in a segment; the content type, algorithm, content
+// coding and body follow it, and the record is padded to a multiple of 8
+// bytes. 'crc' is the CRC-32 of everything after the header up to the
+// padding. Records of older versions have another magic and are dropped.
+struct RecordHeader {
+    uint32_t magic;
+    uint32_t contentTypeLength;
+    uint64_t keyHigh;
+    uint64_t keyLow;
+    uint64_t steps;
+    uint32_t algorithmLength;
+    uint32_t contentEncodingLength;
+    uint64_t bodyLength;
+    uint32_t crc;
+    uint32_t reserved;
+};
+
+// The index file is an IndexHeader followed by one IndexEntry per record
+// appended; a later entry for the same key replaces an earlier one
+struct IndexHeader {
+    uint32_t magic;
+    uint32_t version;
+};
+
+struct IndexEntry {
+    uint64_t keyHigh;
+    uint64_t keyLow;
+    uint32_t segment;
+    uint32_t reserved;
+    uint64_t offset;
+    uint64_t length;
+};
+
+static size_t recordLength(size_t contentType, size_t algorithm, size_t contentEncoding, size_t body) {
+    return (sizeof(RecordHeader) + contentType + algorithm + contentEncoding + body + 7) & ~size_t(7);
+}
+
+// CRC-32 (IEEE 802.3, as zlib and gzip use) of [data, data + length),
+// continuing from 'crc' so a record can be summed a piece at a time
+static uint32_t checksum(uint32_t crc, const char* data, size_t length) {
+#ifdef ALGO_HAVE_ZLIB
+    // zlib's computes the same CRC several bytes at a time; it counts in 32 bits
+    const size_t step = 1u << 30;
+    for (size_t done = 0; done < length; done += step) {
+        crc = static_cast<uint32_t>(crc32(crc, reinterpret_cast<const Bytef*>(data + done),
+                                          static_cast<uInt>(std::min(step, length - done))));
+    }
+    return crc;
+#else
+    static const std::array<uint32_t, 256> table = [] {
+        std::array<uint32_t, 256> t;
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t c = i;
+            for (int bit = 0; bit < 8; ++bit) c = c & 1 ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            t[i] = c;
+        }
+        return t;
+    }();
+    crc = ~crc;
+    for (size_t i = 0; i < length; ++i) crc = table[(crc ^ static_cast<unsigned char>(data[i])) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+#endif
+}
+
+// The CRC a record's header should carry
+static uint32_t recordCrc(const char* record, const RecordHeader& header) {
+    size_t length = static_cast<size_t>(header.contentTypeLength) + header.algorithmLength +
+                    header.contentEncodingLength + header.bodyLength;
+    return checksum(0, record + sizeof(RecordHeader), length);
+}
+
+MappedFile::~MappedFile() {
+    if (!base) return;
+#ifdef _WIN32
+    UnmapViewOfFile(base);
+#else
+    munmap(base, length);
+#endif
+}
+
+bool MappedFile::open(const std::string& path, size_t size) {
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE,
+                              FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_ALWAYS,
+                              FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) return false;
+    LARGE_INTEGER fileSize;
+    if (size > 0) {
+        fileSize.QuadPart = static_cast<LONGLONG>(size);
+        if (!SetFilePointerEx(file, fileSize, nullptr, FILE_BEGIN) || !SetEndOfFile(file)) {
+            CloseHandle(file);
+            return false;
+        }
+    } else if (GetFileSizeEx(file, &fileSize)) {
+        size = static_cast<size_t>(fileSize.QuadPart);
+    }
+    if (size == 0) {
+        CloseHandle(file);
+        return false;
+    }
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READWRITE, 0, 0, nullptr);
+    void* view = mapping ? MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, size) : nullptr;
+    if (mapping) CloseHandle(mapping);
+    CloseHandle(file);
+    if (!view) return false;
+#else
+    int fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd < 0) return false;
+    if (size > 0) {
+        // Reserve the blocks up front: running out of disk while writing
+        // through the mapping would raise SIGBUS instead of failing here
+        bool resized = ftruncate(fd, static_cast<off_t>(size)) == 0;
+#ifdef __linux__
+        resized = resized && posix_fallocate(fd, 0, static_cast<off_t>(size)) == 0;
+#endif
+        if (!resized) {
+            ::close(fd);
+            return false;
+        }
+    } else {
+        struct stat st;
+        if (fstat(fd, &st) == 0) size = static_cast<size_t>(st.st_size);
+    }
+    if (size == 0) {
+        ::close(fd);
+        return false;
+    }
+    void* view = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (view == MAP_FAILED) return false;
+#endif
+    base = static_cast<char*>(view);
+    length = size;
+    return true;
+}
+
+bool MappedFile::sync(size_t offset, size_t bytes) {
+#ifdef _WIN32
+    return FlushViewOfFile(base + offset, bytes) != 0;
+#else
+    // msync takes whole pages
+    static const size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    size_t start = offset / page * page;
+    return msync(base + start, offset + bytes - start, MS_SYNC) == 0;
+#endif
+}
+
+DiskCache::DiskCache(const std::string& directory, size_t capacityBytes)
+    : directory(directory), hashKey(randomHashKey()), capacityBytes(capacityBytes),
+      segmentBytes(std::min(std::max(capacityBytes / 4, MIN_SEGMENT_BYTES), MAX_SEGMENT_BYTES)), bytes(0),
+      nextSegmentId(1), indexFile(nullptr), hits(0), misses(0), compactions(0) {
+    if (this->directory.empty()) return;
+    if (!load()) {
+        std::cerr << "Disk cache in " << directory << " is unavailable; running without it" << std::endl;
+        index.clear();
+        segments.clear();
+        this->directory.clear();
+    }
+}
+
+DiskCache::~DiskCache() {
+    if (indexFile) std::fclose(indexFile);
+}
+
+size_t DiskCache::maxEntryBytes() const {
+    return segmentBytes - recordLength(256, 64, 16, 0);
+}
+
+std::string DiskCache::segmentPath(uint32_t id) const {
+    char name[32];
+    std::snprintf(name, sizeof(name), "segment-%06u.bin", id);
+    return (fs::path(directory) / name).string();
+}
+
+bool DiskCache::load() {
+    std::error_code ec;
+    fs::create_directories(directory, ec);
+    if (ec) return false;
+    bool newKey;
+    if (!loadHashKey(newKey)) return false;
+
+    // Where each key's record was last appended, by the index
+    struct Found {
+        ResultKey key;
+        uint32_t segment;
+        size_t offset;
+        size_t length;
+    };
+    std::vector<Found> found;
+    // Records hashed with a lost key can never be found again
+    if (!newKey) {
+        MappedFile indexMap;
+        fs::path indexPath = fs::path(directory) / INDEX_FILE;
+        if (fs::exists(indexPath, ec) && indexMap.open(indexPath.string(), 0) &&
+            indexMap.size() >= sizeof(IndexHeader)) {
+            IndexHeader header;
+            std::memcpy(&header, indexMap.data(), sizeof(header));
+            if (header.magic == INDEX_MAGIC && header.version == INDEX_VERSION) {
+                size_t count = (indexMap.size() - sizeof(IndexHeader)) / sizeof(IndexEntry);
+                for (size_t i = 0; i < count; ++i) {
+                    IndexEntry entry;
+                    std::memcpy(&entry, indexMap.data() + sizeof(IndexHeader) + i * sizeof(IndexEntry), sizeof(entry));
+                    ResultKey key;
+                    key.high = entry.keyHigh;
+                    key.low = entry.keyLow;
+                    found.push_back(Found{key, entry.segment, static_cast<size_t>(entry.offset),
+                                          static_cast<size_t>(entry.length)});
+                }
+            }
+        }
+    }
+
+    // Segments the index points into, trimmed to the records in them and
+    // mapped; files it does not point into are left over from a compaction
+    std::vector<uint32_t> ids;
+    for (const auto& file : fs::directory_iterator(directory, ec)) {
+        unsigned id;
+        if (std::sscanf(file.path().filename().string().c_str(), "segment-%u.bin", &id) == 1) ids.push_back(id);
+    }
+    std::sort(ids.begin(), ids.end());
+    std::unordered_map<uint32_t, std::shared_ptr<Segment>> byId;
+    for (uint32_t id : ids) {
+        nextSegmentId = std::max(nextSegmentId, id + 1);
+        size_t used = 0;
+        for (const auto& f : found) {
+            if (f.segment == id) used = std::max(used, f.offset + f.length);
+        }
+        std::string path = segmentPath(id);
+        size_t fileSize = static_cast<size_t>(fs::file_size(path, ec));
+        used = ec ? 0 : std::min(used, fileSize);
+        if (used > 0 && used < fileSize) fs::resize_file(path, used, ec);
+
+        auto segment = std::make_shared<Segment>();
+        segment->id = id;
+        if (used == 0 || ec || !segment->file.open(path, 0)) {
+            fs::remove(path, ec);
+            continue;
+        }
+        segment->used = segment->file.size();
+        bytes += segment->used;
+        segments.push_back(segment);
+        byId[id] = segment;
+    }
+
+    // Keep the entries whose records are intact, their CRC included, so
+    // that find() never has to check one; the last one per key wins
+    for (const auto& f : found) {
+        auto it = byId.find(f.segment);
+        if (it == byId.end()) continue;
+        const Segment& segment = *it->second;
+        if (f.offset + sizeof(RecordHeader) > segment.used || f.length > segment.used - f.offset) continue;
+        RecordHeader header;
+        std::memcpy(&header, segment.file.data() + f.offset, sizeof(header));
+        if (header.magic != RECORD_MAGIC || header.keyHigh != f.key.high || header.keyLow != f.key.low ||
+            recordLength(header.contentTypeLength, header.algorithmLength, header.contentEncodingLength,
+                         header.bodyLength) != f.length ||
+            recordCrc(segment.file.data() + f.offset, header) != header.crc) {
+            continue;
+        }
+        index[f.key] = Location{it->second, f.offset, f.length, false};
+    }
+
+    return rewriteIndex() && startSegment();
+}
+
+bool DiskCache::loadHashKey(bool& created) {
+    fs::path keyPath = fs::path(directory) / KEY_FILE;
+    created = false;
+    if (std::FILE* file = std::fopen(keyPath.string().c_str(), "rb")) {
+        bool read = std::fread(&hashKey, sizeof(hashKey), 1, file) == 1;
+        std::fclose(file);
+        if (read) return true;
+    }
+
+    // Written aside and renamed into place, so a crash never leaves half a key
+    created = true;
+    fs::path tempPath = fs::path(directory) / KEY_TEMP_FILE;
+    std::FILE* temp = std::fopen(tempPath.string().c_str(), "wb");
+    if (!temp) return false;
+    bool written = std::fwrite(&hashKey, sizeof(hashKey), 1, temp) == 1;
+    written = std::fclose(temp) == 0 && written;
+    std::error_code ec;
+    if (written) fs::rename(tempPath, keyPath, ec);
+    return written && !ec;
+}
+
+bool DiskCache::startSegment() {
+    auto segment = std::make_shared<Segment>();
+    segment->id = nextSegmentId++;
+    if (!segment->file.open(segmentPath(segment->id), segmentBytes)) return false;
+    segments.push_back(segment);
+    std::lock_guard<std::mutex> lock(mutex);
+    bytes += segmentBytes;
+    return true;
+}
+
+bool DiskCache::fits(size_t length) const {
+    const Segment& newest = *segments.back();
+    return newest.file.size() - newest.used >= length || bytes + segmentBytes <= capacityBytes;
+}
+
+std::shared_ptr<DiskCache::Segment> DiskCache::reserve(size_t length) {
+    if (length > segmentBytes) return nullptr;
+    if (segments.back()->file.size() - segments.back()->used < length && !startSegment()) return nullptr;
+    return segments.back();
+}
+
+void DiskCache::commit(const ResultKey& key, const std::shared_ptr<Segment>& segment, size_t length) {
+    // The record reaches the disk before the entry naming it, so a crash
+    // cannot leave the index pointing at a record that was never written
+    if (!segment->file.sync(segment->used, length)) return;
+    IndexEntry entry = {key.high, key.low, segment->id, 0, segment->used, length};
+    std::fwrite(&entry, sizeof(entry), 1, indexFile);
+    std::fflush(indexFile);
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        index[key] = Location{segment, segment->used, length, false};
+    }
+    segment->used += length;
+}
+
+bool DiskCache::find(const ResultKey& key, CachedResult& result, SharedBody& body) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = index.find(key);
+    if (it == index.end()) {
+        misses.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    Location& location = it->second;
+    const char* record = location.segment->file.data() + location.offset;
+    RecordHeader header;
+    std::memcpy(&header, record, sizeof(header));
+    hits.fetch_add(1, std::memory_order_relaxed);
+    location.served = true;
+    const char* text = record + sizeof(header);
+    result.contentType.assign(text, header.contentTypeLength);
+    text += header.contentTypeLength;
+    result.algorithm.assign(text, header.algorithmLength);
+    text += header.algorithmLength;
+    result.contentEncoding.assign(text, header.contentEncodingLength);
+    text += header.contentEncodingLength;
+    result.steps = static_cast<size_t>(header.steps);
+    body.owner = location.segment;
+    body.data = text;
+    body.length = static_cast<size_t>(header.bodyLength);
+    return true;
+}
+
+void DiskCache::insert(const ResultKey& key, const CachedResult& result) {
+    if (!enabled() || result.body.size() > maxEntryBytes()) return;
+    size_t length = recordLength(result.contentType.size(), result.algorithm.size(), result.contentEncoding.size(),
+                                 result.body.size());
+    if (length > segmentBytes) return;
+
+    // The record is copied, summed and synced holding only writeMutex;
+    // find() waits for nothing but the index update in commit()
+    std::lock_guard<std::mutex> writing(writeMutex);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (index.count(key)) return;
+    }
+    while (!fits(length) && segments.size() > 1) {
+        compactOldest();
+    }
+    if (!fits(length)) return;
+
+    std::shared_ptr<Segment> segment = reserve(length);
+    if (!segment) return;
+    RecordHeader header = {RECORD_MAGIC,
+                           static_cast<uint32_t>(result.contentType.size()),
+                           key.high,
+                           key.low,
+                           result.steps,
+                           static_cast<uint32_t>(result.algorithm.size()),
+                           static_cast<uint32_t>(result.contentEncoding.size()),
+                           result.body.size(),
+                           0,
+                           0};
+    char* out = segment->file.data() + segment->used;
+    std::memcpy(out, &header, sizeof(header));
+    out += sizeof(header);
+    std::memcpy(out, result.contentType.data(), result.contentType.size());
+    out += result.contentType.size();
+    std::memcpy(out, result.algorithm.data(), result.algorithm.size());
+    out += result.algorithm.size();
+    std::memcpy(out, result.contentEncoding.data(), result.contentEncoding.size());
+    out += result.contentEncoding.size();
+    std::memcpy(out, result.body.data(), result.body.size());
+    header.crc = recordCrc(segment->file.data() + segment->used, header);
+    std::memcpy(segment->file.data() + segment->used, &header, sizeof(header));
+    commit(key, segment, length);
+}
+
+void DiskCache::compactOldest() {
+    removeDoomedFiles();
+
+    std::shared_ptr<Segment> oldest = segments.front();
+    segments.erase(segments.begin());
+
+    // Served results move to the newest segment while there is room for
+    // them; everything else in the oldest segment is dropped. Until a moved
+    // result is committed again, it is a miss.
+    std::vector<std::pair<ResultKey, Location>> moving;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        bytes -= oldest->file.size();
+        for (auto it = index.begin(); it != index.end();) {
+            if (it->second.segment != oldest) {
+                ++it;
+                continue;
+            }
+            if (it->second.served) moving.push_back(*it);
+            it = index.erase(it);
+        }
+    }
+    for (const auto& entry : moving) {
+        const Location& from = entry.second;
+        if (!fits(from.length)) continue;
+        std::shared_ptr<Segment> segment = reserve(from.length);
+        if (!segment) break;
+        std::memcpy(segment->file.data() + segment->used, oldest->file.data() + from.offset, from.length);
+        commit(entry.first, segment, from.length);
+    }
+    compactions.fetch_add(1, std::memory_order_relaxed);
+
+    // A mapping that is still being sent from keeps the file's pages; on
+    // Windows it also keeps the file, which is deleted at a later compaction
+    std::string path = segmentPath(oldest->id);
+    oldest.reset();
+    std::error_code ec;
+    if (!fs::remove(path, ec) && ec) doomedFiles.push_back(path);
+    rewriteIndex();
+}
+
+void DiskCache::removeDoomedFiles() {
+    std::vector<std::string> remaining;
+    for (const auto& path : doomedFiles) {
+        std::error_code ec;
+        if (!fs::remove(path, ec) && ec) remaining.push_back(path);
+    }
+    doomedFiles.swap(remaining);
+}
+
+bool DiskCache::rewriteIndex() {
+    // Written aside and renamed over the index, so a crash leaves one or the other
+    fs::path tempPath = fs::path(directory) / INDEX_TEMP_FILE;
+    std::FILE* temp = std::fopen(tempPath.string().c_str(), "wb");
+    if (!temp) return false;
+    // Only writers change which results are indexed, so the entries taken
+    // here stay current while they are written out
+    std::vector<IndexEntry> entries;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        entries.reserve(index.size());
+        for (const auto& entry : index) {
+            const Location& location = entry.second;
+            entries.push_back({entry.first.high, entry.first.low, location.segment->id, 0, location.offset,
+                               location.length});
+        }
+    }
+    IndexHeader header = {INDEX_MAGIC, INDEX_VERSION};
+    bool written = std::fwrite(&header, sizeof(header), 1, temp) == 1;
+    written = written && (entries.empty() ||
+                          std::fwrite(entries.data(), sizeof(IndexEntry), entries.size(), temp) == entries.size());
+    written = std::fclose(temp) == 0 && written;
+
+    if (indexFile) std::fclose(indexFile);
+    indexFile = nullptr;
+    std::error_code ec;
+    fs::path indexPath = fs::path(directory) / INDEX_FILE;
+    if (written) fs::rename(tempPath, indexPath, ec);
+    indexFile = std::fopen(indexPath.string().c_str(), "ab");
+    return written && !ec && indexFile;
+}
+
+std::string DiskCache::renderPrometheus() const {
+    size_t entries;
+    size_t used;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        entries = index.size();
+        used = bytes;
+    }
+
+    char text[1280];
+    std::snprintf(text, sizeof(text),
+                  "# HELP algo_disk_cache_hits_total Algorithm requests answered from the disk cache.\n"
+                  "# TYPE algo_disk_cache_hits_total counter\n"
+                  "algo_disk_cache_hits_total %llu\n"
+                  "# HELP algo_disk_cache_misses_total Result cache misses the disk cache could not answer.\n"
+                  "# TYPE algo_disk_cache_misses_total counter\n"
+                  "algo_disk_cache_misses_total %llu\n"
+                  "# HELP algo_disk_cache_compactions_total Segments compacted away to stay within the capacity.\n"
+                  "# TYPE algo_disk_cache_compactions_total counter\n"
+                  "algo_disk_cache_compactions_total %llu\n"
+                  "# HELP algo_disk_cache_entries Results on disk.\n"
+                  "# TYPE algo_disk_cache_entries gauge\n"
+                  "algo_disk_cache_entries %zu\n"
+                  "# HELP algo_disk_cache_bytes Bytes of the segment files, the newest one's preallocated space included.\n"
+                  "# TYPE algo_disk_cache_bytes gauge\n"
+                  "algo_disk_cache_bytes %zu\n"
+                  "# HELP algo_disk_cache_capacity_bytes Bytes the disk cache may use.\n"
+                  "# TYPE algo_disk_cache_capacity_bytes gauge\n"
+                  "algo_disk_cache_capacity_bytes %zu\n",
+                  (unsigned long long)hits.load(std::memory_order_relaxed),
+                  (unsigned long long)misses.load(std::memory_order_relaxed),
+                  (unsigned long long)compactions.load(std::memory_order_relaxed), entries, used, capacityBytes);
+    return text;
+}
@@ -0,0 +1,151 @@
+#ifndef DISK_CACHE_H
+#define DISK_CACHE_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <cstdio>
+#include <cstdint>
+#include <unordered_map>
+
+#include "http.h"
+#include "result_cache.h"
+
+// A file mapped into memory, read-write and shared, so what is written to
+// the mapping reaches the file through the page cache
+class MappedFile {
+public:
+    MappedFile() {}
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // Map 'path', created if missing and first resized to 'size' bytes
+    // unless that is 0, which maps the file at its current size. False on
+    // any failure, or for an empty file.
+    bool open(const std::string& path, size_t size);
+
+    char* data() const { return base; }
+    size_t size() const { return length; }
+
+    // Write [offset, offset + bytes) of the mapping through to the disk
+    // and wait for it; false if that failed
+    bool sync(size_t offset, size_t bytes);
+
+private:
+    char* base = nullptr;
+    size_t length = 0;
+};
+
+// Results of deterministic algorithm runs kept on disk across restarts, as
+// the second tier behind ResultCache. Results are appended to segment files
+// of a fixed size that are mapped into memory, and every append is logged
+// in an index file. On startup the index is mapped and replayed, checked
+// against the records it points to, and hits are served straight from the
+// mapped segments, i.e. from the page cache.
+//
+// Every record is synced to disk before it is logged, and carries a CRC
+// that is checked when the cache is loaded. Segment
+// files are preallocated in full, and count against the capacity at that
+// size from the moment they are started.
+//
+// Once the segments would take more than the capacity, the oldest one is
+// compacted away: the results in it that were served since it was last
+// compacted are appended again, the rest are dropped, the file is deleted
+// and the index rewritten to the live results.
+class DiskCache {
+public:
+    // An empty 'directory' turns the cache off; so does one that cannot be
+    // created or written, which is reported on stderr
+    DiskCache(const std::string& directory, size_t capacityBytes);
+    ~DiskCache();
+
+    DiskCache(const DiskCache&) = delete;
+    DiskCache& operator=(const DiskCache&) = delete;
+
+    bool enabled() const { return !directory.empty(); }
+
+    // Key to hash requests into ResultKeys with. It is kept with the cache,
+    // so the results stored survive a restart; without a cache it is new
+    // to this process.
+    const HashKey& resultHashKey() const { return hashKey; }
+
+    // Largest body insert() keeps
+    size_t maxEntryBytes() const;
+
+    // The result stored under 'key' with its body left in the mapped
+    // segment, or false; counts a hit or a miss
+    bool find(const ResultKey& key, CachedResult& result, SharedBody& body);
+
+    // Append a result, unless one is stored under the same key; may compact
+    void insert(const ResultKey& key, const CachedResult& result);
+
+    // Hits, misses, results and bytes in the Prometheus text format
+    std::string renderPrometheus() const;
+
+private:
+    struct Segment {
+        uint32_t id;
+        MappedFile file;
+        size_t used = 0; // Bytes of records from the start of the file
+    };
+
+    // Where a result's record is
+    struct Location {
+        std::shared_ptr<Segment> segment;
+        size_t offset;
+        size_t length;
+        bool served; // Since its segment was last compacted
+    };
+
+    struct KeyHash {
+        size_t operator()(const ResultKey& key) const { return static_cast<size_t>(key.low); }
+    };
+
+    std::string segmentPath(uint32_t id) const;
+    bool load();
+    bool loadHashKey(bool& created);
+    bool startSegment();
+
+    // Whether a record of 'length' bytes fits in the newest segment, or a
+    // new segment fits within the capacity
+    bool fits(size_t length) const;
+
+    // Room for a record of 'length' bytes at the end of the newest segment,
+    // which is started when the last one is full; null if it cannot be
+    std::shared_ptr<Segment> reserve(size_t length);
+
+    // Log and index a record written at the end of 'segment'
+    void commit(const ResultKey& key, const std::shared_ptr<Segment>& segment, size_t length);
+
+    void compactOldest();
+    bool rewriteIndex();
+    void removeDoomedFiles();
+
+    std::string directory;
+    HashKey hashKey;
+    size_t capacityBytes;
+    size_t segmentBytes;
+
+    // Inserting and compacting hold writeMutex throughout, so one writer at
+    // a time owns the segments, their tails, the index file and 'doomedFiles'.
+    // 'mutex' guards the index and 'bytes', and is only held briefly, so a
+    // find() from an event loop never waits for a write to reach the disk.
+    std::mutex writeMutex;
+    mutable std::mutex mutex;
+    std::unordered_map<ResultKey, Location, KeyHash> index;
+    std::vector<std::shared_ptr<Segment>> segments; // Oldest first; the last is appended to
+    size_t bytes;                                   // Size of all segment files, preallocated and dead space included
+    uint32_t nextSegmentId;
+    std::FILE* indexFile;
+    std::vector<std::string> doomedFiles; // Compacted segments a mapping still kept from being deleted
+
+    std::atomic<uint64_t> hits;
+    std::atomic<uint64_t> misses;
+    std::atomic<uint64_t> compactions;
+};
+
+#endif // DISK_CACHE_H
@@ -0,0 +1,366 @@
+#include "generators.h"
+#include <random>
+#include <stdexcept>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include <cmath>
+
+// Elements, nodes or edges generated per block, each from its own stream
+static const size_t BLOCK = 1 << 16;
+
+// Largest value of a generated array
+static const int MAX_VALUE = 1000000000;
+
+// R-MAT's chances of recursing into the top-left, top-right and bottom-left
+// quadrant; the rest go bottom-right
+static const double RMAT_A = 0.57;
+static const double RMAT_B = 0.19;
+static const double RMAT_C = 0.19;
+
+static const double PI = 3.14159265358979323846;
+
+// mt19937_64 with draws defined here rather than by <random>'s
+// distributions, whose results differ between standard libraries
+class Random {
+public:
+    explicit Random(uint64_t seed) : engine(seed) {}
+
+    // Uniform in [0, 1)
+    double unit() { return static_cast<double>(engine() >> 11) * (1.0 / 9007199254740992.0); }
+
+    // Uniform in [0, n)
+    uint64_t below(uint64_t n) { return std::min(static_cast<uint64_t>(unit() * n), n - 1); }
+
+private:
+    std::mt19937_64 engine;
+};
+
+// Seed of one block's stream: SplitMix64 of the spec's seed and the block
+static uint64_t blockSeed(uint64_t seed, uint64_t block) {
+    uint64_t z = seed + (block + 1) * 0x9e3779b97f4a7c15ULL;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+// Calls generate(block, begin, end) for every block of [0, count). Up to
+// one block per CPU core runs at a time, the calling thread included.
+template <typename Generate>
+static void forEachBlock(size_t count, Generate generate) {
+    size_t blocks = (count + BLOCK - 1) / BLOCK;
+    std::atomic<size_t> next(0);
+    auto worker = [&]() {
+        for (size_t b = next++; b < blocks; b = next++) {
+            generate(b, b * BLOCK, std::min(count, (b + 1) * BLOCK));
+        }
+    };
+
+    size_t threads = std::min<size_t>(std::max(1u, std::thread::hardware_concurrency()), blocks);
+    std::vector<std::thread> pool;
+    for (size_t t = 1; t < threads; ++t) {
+        pool.emplace_back(worker);
+    }
+    worker();
+    for (auto& t : pool) {
+        t.join();
+    }
+}
+
+// Ascending values: a running sum of random gaps averaging 1e9 / size.
+// Each block sums its own gaps, then is shifted by the sums before it.
+static void fillSorted(std::vector<int>& values, uint64_t seed) {
+    size_t n = values.size();
+    uint64_t maxGap = n > 0 ? 2ull * MAX_VALUE / n : 0;
+    std::vector<int64_t> offsets((n + BLOCK - 1) / BLOCK + 1, 0);
+    forEachBlock(n, [&](size_t block, size_t begin, size_t end) {
+        Random random(blockSeed(seed, block));
+        int64_t sum = 0;
+        for (size_t i = begin; i < end; ++i) {
+            sum += static_cast<int64_t>(random.below(maxGap + 1));
+            values[i] = static_cast<int>(sum);
+        }
+        offsets[block + 1] = sum;
+    });
+    for (size_t b = 1; b < offsets.size(); ++b) {
+        offsets[b] += offsets[b - 1];
+    }
+    forEachBlock(n, [&](size_t block, size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) values[i] += static_cast<int>(offsets[block]);
+    });
+}
+
+std::vector<int> generateArray(const ArraySpec& spec) {
+    const std::string& distribution = spec.distribution;
+    size_t n = spec.size;
+    std::vector<int> values(n);
+
+    if (distribution == "uniform") {
+        forEachBlock(n, [&](size_t block, size_t begin, size_t end) {
+            Random random(blockSeed(spec.seed, block));
+            for (size_t i = begin; i < end; ++i) values[i] = static_cast<int>(random.below(MAX_VALUE + 1ull));
+        });
+    } else if (distribution == "sorted") {
+        fillSorted(values, spec.seed);
+    } else if (distribution == "reversed") {
+        fillSorted(values, spec.seed);
+        std::reverse(values.begin(), values.end());
+    } else if (distribution == "nearly-sorted") {
+        fillSorted(values, spec.seed);
+        if (n > 1) {
+            size_t swaps = spec.swaps > 0 ? spec.swaps : std::max<size_t>(1, n / 100);
+            Random random(spec.seed);
+            for (size_t s = 0; s < swaps; ++s) {
+                std::swap(values[random.below(n)], values[random.below(n)]);
+            }
+        }
+    } else if (distribution == "few-unique") {
+        std::vector<int> pool(spec.unique > 0 ? spec.unique : 10);
+        Random choose(spec.seed);
+        for (auto& v : pool) v = static_cast<int>(choose.below(MAX_VALUE + 1ull));
+        forEachBlock(n, [&](size_t block, size_t begin, size_t end) {
+            Random random(blockSeed(spec.seed, block));
+            for (size_t i = begin; i < end; ++i) values[i] = pool[random.below(pool.size())];
+        });
+    } else if (distribution == "organ-pipe") {
+        forEachBlock(n, [&](size_t, size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) values[i] = static_cast<int>(std::min(i, n - 1 - i));
+        });
+    } else {
+        throw std::invalid_argument("Unknown distribution: " + distribution);
+    }
+    return values;
+}
+
+namespace {
+
+struct Edge {
+    int u;
+    int v;
+    int weight;
+};
+
+// Edges generated block by block; each block's are in order
+typedef std::vector<std::vector<Edge>> EdgeBlocks;
+
+} // namespace
+
+// Calls generate(random, begin, end, edges) for every block of [0, count)
+// of nodes or edges, in parallel, with the block's stream
+template <typename Generate>
+static EdgeBlocks generateEdges(size_t count, uint64_t seed, Generate generate) {
+    EdgeBlocks blocks((count + BLOCK - 1) / BLOCK);
+    forEachBlock(count, [&](size_t block, size_t begin, size_t end) {
+        Random random(blockSeed(seed, block));
+        generate(random, begin, end, blocks[block]);
+    });
+    return blocks;
+}
+
+static int randomWeight(Random& random, int maxWeight) {
+    return 1 + static_cast<int>(random.below(static_cast<uint64_t>(maxWeight)));
+}
+
+// Each pair u < v joined with probability p, skipping ahead geometrically
+// between joined pairs so the work is in the edges, not the pairs
+static EdgeBlocks erdosRenyiEdges(const GraphSpec& spec) {
+    size_t n = spec.nodes;
+    double p = n > 1 ? std::min(1.0, spec.degree / (n - 1)) : 0;
+    if (p <= 0) return EdgeBlocks();
+    double logMiss = std::log1p(-p);
+    return generateEdges(n, spec.seed, [&](Random& random, size_t begin, size_t end, std::vector<Edge>& edges) {
+        for (size_t u = begin; u < end; ++u) {
+            size_t v = u + 1;
+            for (;;) {
+                if (p < 1) {
+                    double skip = std::floor(std::log(1 - random.unit()) / logMiss);
+                    if (skip >= static_cast<double>(n)) break;
+                    v += static_cast<size_t>(skip);
+                }
+                if (v >= n) break;
+                edges.push_back({static_cast<int>(u), static_cast<int>(v), randomWeight(random, spec.maxWeight)});
+                ++v;
+            }
+        }
+    });
+}
+
+static size_t gridRows(const GraphSpec& spec) {
+    if (spec.rows > 0) return std::min(spec.rows, spec.nodes);
+    return std::max<size_t>(1, static_cast<size_t>(std::sqrt(static_cast<double>(spec.nodes))));
+}
+
+// Node r * cols + c joined to the nodes right of and below it
+static EdgeBlocks gridEdges(const GraphSpec& spec) {
+    size_t n = spec.nodes;
+    size_t cols = (n + gridRows(spec) - 1) / gridRows(spec);
+    return generateEdges(n, spec.seed, [&](Random& random, size_t begin, size_t end, std::vector<Edge>& edges) {
+        for (size_t u = begin; u < end; ++u) {
+            if ((u + 1) % cols != 0 && u + 1 < n) {
+                edges.push_back({static_cast<int>(u), static_cast<int>(u + 1), randomWeight(random, spec.maxWeight)});
+            }
+            if (u + cols < n) {
+                edges.push_back(
+                    {static_cast<int>(u), static_cast<int>(u + cols), randomWeight(random, spec.maxWeight)});
+            }
+        }
+    });
+}
+
+// Edges placed by R-MAT on the adjacency matrix rounded up to a power of
+// two: a quadrant is picked per level, with most of the chance on the
+// top-left, which piles edges onto a few nodes. Self loops and nodes past
+// the last are drawn again; repeated edges are dropped, so a node gets a
+// little under 'degree' neighbours on average. No more edges are drawn than
+// the graph can hold, so the draws stay within expectedGraphEntries().
+static EdgeBlocks rmatEdges(const GraphSpec& spec) {
+    size_t n = spec.nodes;
+    if (n < 2) return EdgeBlocks();
+    double degree = std::min(spec.degree, static_cast<double>(n - 1));
+    size_t count = static_cast<size_t>(std::llround(n * degree / 2));
+    int levels = 0;
+    while ((size_t(1) << levels) < n) ++levels;
+
+    EdgeBlocks blocks =
+        generateEdges(count, spec.seed, [&](Random& random, size_t begin, size_t end, std::vector<Edge>& edges) {
+            edges.reserve(end - begin);
+            for (size_t e = begin; e < end; ++e) {
+                size_t u, v;
+                do {
+                    u = 0;
+                    v = 0;
+                    for (int level = levels - 1; level >= 0; --level) {
+                        double r = random.unit();
+                        if (r >= RMAT_A + RMAT_B + RMAT_C) {
+                            u |= size_t(1) << level;
+                            v |= size_t(1) << level;
+                        } else if (r >= RMAT_A + RMAT_B) {
+                            u |= size_t(1) << level;
+                        } else if (r >= RMAT_A) {
+                            v |= size_t(1) << level;
+                        }
+                    }
+                } while (u >= n || v >= n || u == v);
+                edges.push_back({static_cast<int>(std::min(u, v)), static_cast<int>(std::max(u, v)),
+                                 randomWeight(random, spec.maxWeight)});
+            }
+        });
+
+    // Drop repeats, keeping the lightest
+    std::vector<Edge> edges;
+    edges.reserve(count);
+    for (const auto& block : blocks) edges.insert(edges.end(), block.begin(), block.end());
+    std::sort(edges.begin(), edges.end(), [](const Edge& a, const Edge& b) {
+        return a.u != b.u ? a.u < b.u : a.v != b.v ? a.v < b.v : a.weight < b.weight;
+    });
+    edges.erase(std::unique(edges.begin(), edges.end(),
+                            [](const Edge& a, const Edge& b) { return a.u == b.u && a.v == b.v; }),
+                edges.end());
+    EdgeBlocks unique(1);
+    unique[0] = std::move(edges);
+    return unique;
+}
+
+// Points uniform in the unit square, joined when closer than the radius
+// that gives 'degree' neighbours on average, weighted from 1 for touching
+// to maxWeight at the radius. Points are bucketed into cells at least a
+// radius wide, so only the adjacent cells are searched.
+static EdgeBlocks geometricEdges(const GraphSpec& spec) {
+    size_t n = spec.nodes;
+    if (n < 2 || spec.degree <= 0) return EdgeBlocks();
+    double radius = std::min(std::sqrt(spec.degree / (PI * n)), 1.5);
+
+    std::vector<double> x(n), y(n);
+    forEachBlock(n, [&](size_t block, size_t begin, size_t end) {
+        Random random(blockSeed(spec.seed, block));
+        for (size_t i = begin; i < end; ++i) {
+            x[i] = random.unit();
+            y[i] = random.unit();
+        }
+    });
+
+    size_t side = std::max<size_t>(
+        1, std::min(static_cast<size_t>(1 / radius), static_cast<size_t>(std::sqrt(static_cast<double>(n))) + 1));
+    auto cellOf = [&](double coordinate) { return std::min(static_cast<size_t>(coordinate * side), side - 1); };
+    std::vector<uint32_t> cellStart(side * side + 1, 0);
+    for (size_t i = 0; i < n; ++i) ++cellStart[cellOf(y[i]) * side + cellOf(x[i]) + 1];
+    for (size_t c = 1; c < cellStart.size(); ++c) cellStart[c] += cellStart[c - 1];
+    std::vector<uint32_t> cellPoints(n);
+    std::vector<uint32_t> filled(cellStart.begin(), cellStart.end() - 1);
+    for (size_t i = 0; i < n; ++i) cellPoints[filled[cellOf(y[i]) * side + cellOf(x[i])]++] = static_cast<uint32_t>(i);
+
+    // Streams of their own, after the ones the points were drawn from
+    uint64_t edgeSeed = blockSeed(spec.seed, (n + BLOCK - 1) / BLOCK);
+    return generateEdges(n, edgeSeed, [&](Random&, size_t begin, size_t end, std::vector<Edge>& edges) {
+        for (size_t u = begin; u < end; ++u) {
+            size_t cx = cellOf(x[u]), cy = cellOf(y[u]);
+            for (size_t ny = cy > 0 ? cy - 1 : 0; ny <= std::min(cy + 1, side - 1); ++ny) {
+                for (size_t nx = cx > 0 ? cx - 1 : 0; nx <= std::min(cx + 1, side - 1); ++nx) {
+                    size_t cell = ny * side + nx;
+                    for (uint32_t k = cellStart[cell]; k < cellStart[cell + 1]; ++k) {
+                        size_t v = cellPoints[k];
+                        if (v <= u) continue;
+                        double dx = x[u] - x[v], dy = y[u] - y[v];
+                        double distance = std::sqrt(dx * dx + dy * dy);
+                        if (distance >= radius) continue;
+                        int weight = 1 + static_cast<int>(distance / radius * (spec.maxWeight - 1));
+                        edges.push_back({static_cast<int>(u), static_cast<int>(v), weight});
+                    }
+                }
+            }
+        }
+    });
+}
+
+size_t expectedGraphEntries(const GraphSpec& spec) {
+    double n = static_cast<double>(spec.nodes);
+    if (spec.model == "grid") {
+        double rows = static_cast<double>(gridRows(spec));
+        double cols = std::ceil(n / std::max(rows, 1.0));
+        return static_cast<size_t>(std::max(0.0, 2 * (2 * n - rows - cols)));
+    }
+    return static_cast<size_t>(n * std::max(0.0, std::min(spec.degree, n - 1)));
+}
+
+GeneratedGraph generateGraph(const GraphSpec& spec) {
+    if (spec.nodes == 0 || spec.nodes > static_cast<size_t>(INT32_MAX)) {
+        throw std::invalid_argument("A generated graph needs at least one node");
+    }
+    if (spec.maxWeight < 1) {
+        throw std::invalid_argument("maxWeight must be at least 1");
+    }
+    if (!(spec.degree >= 0)) {
+        throw std::invalid_argument("degree must not be negative");
+    }
+
+    EdgeBlocks blocks;
+    if (spec.model == "erdos-renyi") {
+        blocks = erdosRenyiEdges(spec);
+    } else if (spec.model == "grid") {
+        blocks = gridEdges(spec);
+    } else if (spec.model == "rmat") {
+        blocks = rmatEdges(spec);
+    } else if (spec.model == "geometric") {
+        blocks = geometricEdges(spec);
+    } else {
+        throw std::invalid_argument("Unknown graph model: " + spec.model);
+    }
+
+    // Both directions of every edge, in the order the blocks made them
+    std::vector<uint32_t> degrees(spec.nodes, 0);
+    for (const auto& block : blocks) {
+        for (const Edge& e : block) {
+            ++degrees[e.u];
+            ++degrees[e.v];
+        }
+    }
+    GeneratedGraph graph(spec.nodes);
+    for (size_t i = 0; i < spec.nodes; ++i) graph[i].reserve(degrees[i]);
+    for (const auto& block : blocks) {
+        for (const Edge& e : block) {
+            graph[e.u].emplace_back(e.v, e.weight);
+            graph[e.v].emplace_back(e.u, e.weight);
+        }
+    }
+    return graph;
+}
@@ -0,0 +1,58 @@
+#ifndef GENERATORS_H
+#define GENERATORS_H
+
+#include <string>
+#include <vector>
+#include <utility>
+#include <cstdint>
+
+// Seeded input generators, so large inputs need not be sent over the wire.
+// The same spec always yields the same data, however many threads generate
+// it: the output is cut into fixed blocks, each with a random stream of its
+// own derived from the seed, and the blocks are generated in parallel.
+
+// Supported array distributions:
+//   "uniform"        values drawn uniformly from [0, 1e9]
+//   "sorted"         ascending random values spread over [0, 1e9]
+//   "reversed"       the same, descending
+//   "nearly-sorted"  sorted, then 'swaps' random pairs of elements swapped
+//   "few-unique"     'unique' distinct values, drawn uniformly
+//   "organ-pipe"     0, 1, 2, ... rising to the middle and falling back to 0
+struct ArraySpec {
+    std::string distribution = "uniform";
+    size_t size = 0;
+    uint64_t seed = 1;
+    size_t swaps = 0;  // For "nearly-sorted"; 0 means one per 100 elements
+    size_t unique = 0; // For "few-unique"; 0 means 10
+};
+
+// Throws std::invalid_argument for an unknown distribution.
+std::vector<int> generateArray(const ArraySpec& spec);
+
+// Adjacency lists of (target, weight), the same type as AdjacencyList (graph.h)
+typedef std::vector<std::vector<std::pair<int, int>>> GeneratedGraph;
+
+// Supported graph models, all undirected, so every edge is listed under
+// both of its nodes, with weights drawn from [1, maxWeight]:
+//   "erdos-renyi"  every pair of nodes joined with the same probability
+//   "grid"         a 'rows' by nodes / rows lattice joined to its four neighbours
+//   "rmat"         R-MAT recursive quadrants, a skewed power-law degree distribution
+//   "geometric"    random points in the unit square, joined within a radius
+//                  and weighted by their distance
+// 'degree' is the average number of neighbours a node gets, except on grids.
+struct GraphSpec {
+    std::string model = "erdos-renyi";
+    size_t nodes = 0;
+    double degree = 4;
+    size_t rows = 0; // For "grid"; 0 makes it as near square as can be
+    int maxWeight = 10;
+    uint64_t seed = 1;
+};
+
+// Adjacency list entries, i.e. twice the edges, a spec is expected to yield
+size_t expectedGraphEntries(const GraphSpec& spec);
+
+// Throws std::invalid_argument for an unknown model or a spec out of range.
+GeneratedGraph generateGraph(const GraphSpec& spec);
+
+#endif // GENERATORS_H
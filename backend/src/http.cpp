@@ -0,0 +1,373 @@
+#include "http.h"
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <string_view>
+
+// CORS headers for all responses
+static const std::string CORS_HEADERS = "Access-Control-Allow-Origin: *\r\n"
+                                       "Access-Control-Allow-Methods: GET, POST, DELETE, OPTIONS\r\n"
+                                       "Access-Control-Allow-Headers: Content-Type, X-Session-Id, If-None-Match\r\n"
+                                       "Access-Control-Expose-Headers: ETag\r\n";
+
+static std::string toLower(std::string s) {
+    std::transform(s.begin(), s.end(), s.begin(), [](unsigned char c) { return std::tolower(c); });
+    return s;
+}
+
+static std::string trim(const std::string& s) {
+    size_t start = s.find_first_not_of(" \t");
+    if (start == std::string::npos) return "";
+    size_t end = s.find_last_not_of(" \t");
+    return s.substr(start, end - start + 1);
+}
+
+std::string HttpRequest::header(const std::string& name) const {
+    for (const auto& h : headers) {
+        if (h.first == name) return h.second;
+    }
+    return "";
+}
+
+static std::string percentDecode(const std::string& s) {
+    std::string out;
+    out.reserve(s.size());
+    for (size_t i = 0; i < s.size(); ++i) {
+        if (s[i] == '+') {
+            out += ' ';
+        } else if (s[i] == '%' && i + 2 < s.size() && std::isxdigit(static_cast<unsigned char>(s[i + 1])) &&
+                   std::isxdigit(static_cast<unsigned char>(s[i + 2]))) {
+            out += static_cast<char>(std::stoi(s.substr(i + 1, 2), nullptr, 16));
+            i += 2;
+        } else {
+            out += s[i];
+        }
+    }
+    return out;
+}
+
+std::string HttpRequest::queryParam(const std::string& name) const {
+    size_t pos = 0;
+    while (pos <= query.size()) {
+        size_t end = query.find('&', pos);
+        if (end == std::string::npos) end = query.size();
+        size_t eq = query.find('=', pos);
+        if (eq != std::string::npos && eq < end && query.compare(pos, eq - pos, name) == 0 && eq - pos == name.size()) {
+            return percentDecode(query.substr(eq + 1, end - eq - 1));
+        }
+        pos = end + 1;
+    }
+    return "";
+}
+
+std::string HttpRequest::cookie(const std::string& name) const {
+    std::string cookies = header("cookie");
+    size_t pos = 0;
+    while (pos < cookies.size()) {
+        size_t end = cookies.find(';', pos);
+        if (end == std::string::npos) end = cookies.size();
+        std::string pair = trim(cookies.substr(pos, end - pos));
+        size_t eq = pair.find('=');
+        if (eq != std::string::npos && pair.compare(0, eq, name) == 0 && eq == name.size()) {
+            return pair.substr(eq + 1);
+        }
+        pos = end + 1;
+    }
+    return "";
+}
+
+bool HttpRequest::keepAlive() const {
+    std::string connection = toLower(header("connection"));
+    if (version == "HTTP/1.0") {
+        return connection.find("keep-alive") != std::string::npos;
+    }
+    return connection.find("close") == std::string::npos;
+}
+
+const char* statusText(int statusCode) {
+    switch (statusCode) {
+        case 200: return "OK";
+        case 204: return "No Content";
+        case 304: return "Not Modified";
+        case 400: return "Bad Request";
+        case 404: return "Not Found";
+        case 405: return "Method Not Allowed";
+        case 408: return "Request Timeout";
+        case 413: return "Payload Too Large";
+        case 431: return "Request Header Fields Too Large";
+        case 500: return "Internal Server Error";
+        case 501: return "Not Implemented";
+        case 503: return "Service Unavailable";
+        default: return "Unknown";
+    }
+}
+
+bool parseRequestHead(const char* data, size_t length, HttpRequest& request) {
+    std::string head(data, length);
+
+    // Request line: METHOD SP target SP version
+    size_t line_end = head.find("\r\n");
+    std::string requestLine = head.substr(0, line_end);
+
+    size_t method_end = requestLine.find(' ');
+    if (method_end == std::string::npos) return false;
+    size_t path_end = requestLine.find(' ', method_end + 1);
+    if (path_end == std::string::npos) return false;
+
+    request.method = requestLine.substr(0, method_end);
+    std::string target = requestLine.substr(method_end + 1, path_end - method_end - 1);
+    request.version = requestLine.substr(path_end + 1);
+    if (request.method.empty() || target.empty() || request.version.compare(0, 5, "HTTP/") != 0) {
+        return false;
+    }
+
+    size_t query_start = target.find('?');
+    if (query_start != std::string::npos) {
+        request.path = target.substr(0, query_start);
+        request.query = target.substr(query_start + 1);
+    } else {
+        request.path = target;
+        request.query.clear();
+    }
+
+    // Header fields
+    request.headers.clear();
+    size_t pos = (line_end == std::string::npos) ? head.size() : line_end + 2;
+    while (pos < head.size()) {
+        size_t next = head.find("\r\n", pos);
+        if (next == std::string::npos) next = head.size();
+
+        size_t colon = head.find(':', pos);
+        if (colon == std::string::npos || colon > next) return false;
+
+        request.headers.emplace_back(toLower(head.substr(pos, colon - pos)),
+                                     trim(head.substr(colon + 1, next - colon - 1)));
+        pos = next + 2;
+    }
+
+    return true;
+}
+
+HttpRequestParser::HttpRequestParser(size_t maxHeaderBytes, size_t maxBodyBytes)
+    : maxHeaderBytes(maxHeaderBytes), maxBodyBytes(maxBodyBytes) {
+    reset();
+}
+
+void HttpRequestParser::reset() {
+    state = Head;
+    scanned = 0;
+    remaining = 0;
+    continueRequested = false;
+    error = 0;
+    errorText = "";
+    req = HttpRequest();
+}
+
+HttpRequestParser::Status HttpRequestParser::status() const {
+    if (state == Done) return Complete;
+    if (state == Error) return Failed;
+    return NeedMore;
+}
+
+bool HttpRequestParser::headComplete() const {
+    return state != Head && state != Error;
+}
+
+int HttpRequestParser::errorStatus() const {
+    return error;
+}
+
+const char* HttpRequestParser::errorMessage() const {
+    return errorText;
+}
+
+bool HttpRequestParser::takeContinueRequest() {
+    bool requested = continueRequested;
+    continueRequested = false;
+    return requested;
+}
+
+size_t HttpRequestParser::bodyBytesWanted() const {
+    return state == FixedBody ? remaining : 0;
+}
+
+void HttpRequestParser::bodyAppended(size_t count) {
+    remaining -= std::min(count, remaining);
+    if (state == FixedBody && remaining == 0) state = Done;
+}
+
+HttpRequest& HttpRequestParser::request() {
+    return req;
+}
+
+size_t HttpRequestParser::fail(int statusCode, const char* message) {
+    state = Error;
+    error = statusCode;
+    errorText = message;
+    return 0;
+}
+
+size_t HttpRequestParser::feed(const char* data, size_t length) {
+    size_t used = 0;
+    while (used < length) {
+        size_t n = 0;
+        switch (state) {
+            case Head:
+                n = parseHead(data + used, length - used);
+                break;
+            case FixedBody:
+                n = std::min(remaining, length - used);
+                req.body.append(data + used, n);
+                bodyAppended(n);
+                break;
+            case ChunkSize:
+            case ChunkData:
+            case ChunkDataEnd:
+            case Trailers:
+                n = parseChunked(data + used, length - used);
+                break;
+            case Done:
+            case Error:
+                return used;
+        }
+        if (n == 0 && (state == Head || state == ChunkSize || state == ChunkDataEnd || state == Trailers)) {
+            break; // Incomplete line or head; wait for more bytes
+        }
+        used += n;
+    }
+    return used;
+}
+
+size_t HttpRequestParser::parseHead(const char* data, size_t length) {
+    // Skip stray CRLFs between pipelined requests
+    if (scanned == 0) {
+        size_t skip = 0;
+        while (skip + 1 < length && data[skip] == '\r' && data[skip + 1] == '\n') skip += 2;
+        if (skip > 0) return skip;
+    }
+
+    std::string_view view(data, length);
+    size_t from = scanned > 3 ? scanned - 3 : 0;
+    size_t header_end = view.find("\r\n\r\n", from);
+    if (header_end == std::string_view::npos) {
+        scanned = length;
+        if (length > maxHeaderBytes) return fail(431, "Request headers too large");
+        return 0;
+    }
+    if (header_end > maxHeaderBytes) return fail(431, "Request headers too large");
+    scanned = 0;
+
+    if (!parseRequestHead(data, header_end, req)) return fail(400, "Malformed request");
+
+    std::string expect = toLower(req.header("expect"));
+    continueRequested = expect == "100-continue";
+
+    std::string transferEncoding = toLower(req.header("transfer-encoding"));
+    if (!transferEncoding.empty()) {
+        if (transferEncoding.size() < 7 ||
+            transferEncoding.compare(transferEncoding.size() - 7, 7, "chunked") != 0) {
+            return fail(501, "Unsupported transfer encoding");
+        }
+        state = ChunkSize;
+        return header_end + 4;
+    }
+
+    std::string contentLength = req.header("content-length");
+    remaining = 0;
+    if (!contentLength.empty()) {
+        if (contentLength.find_first_not_of("0123456789") != std::string::npos || contentLength.size() > 18) {
+            return fail(400, "Invalid Content-Length");
+        }
+        remaining = std::strtoull(contentLength.c_str(), nullptr, 10);
+        if (remaining > maxBodyBytes) return fail(413, "Request body too large");
+    }
+
+    if (remaining > 0) {
+        req.body.reserve(remaining);
+        state = FixedBody;
+    } else {
+        state = Done;
+    }
+    return header_end + 4;
+}
+
+size_t HttpRequestParser::parseChunked(const char* data, size_t length) {
+    if (state == ChunkData) {
+        size_t n = std::min(remaining, length);
+        req.body.append(data, n);
+        remaining -= n;
+        if (remaining == 0) state = ChunkDataEnd;
+        return n;
+    }
+
+    if (state == ChunkDataEnd) {
+        if (length < 2) return 0;
+        if (data[0] != '\r' || data[1] != '\n') return fail(400, "Malformed chunk");
+        state = ChunkSize;
+        return 2;
+    }
+
+    // ChunkSize and Trailers are line based
+    std::string_view view(data, length);
+    size_t line_end = view.find("\r\n", scanned > 0 ? scanned - 1 : 0);
+    if (line_end == std::string_view::npos) {
+        scanned = length;
+        if (length > maxHeaderBytes) return fail(431, "Chunk header too large");
+        return 0;
+    }
+    scanned = 0;
+
+    if (state == Trailers) {
+        // Trailer fields are accepted and ignored; an empty line ends the message
+        if (line_end == 0) state = Done;
+        return line_end + 2;
+    }
+
+    // Chunk size in hex, optionally followed by ";extensions"
+    size_t size = 0;
+    size_t digits = 0;
+    for (size_t i = 0; i < line_end && std::isxdigit(static_cast<unsigned char>(data[i])); ++i, ++digits) {
+        if (digits >= 15) return fail(400, "Malformed chunk");
+        char c = static_cast<char>(std::tolower(static_cast<unsigned char>(data[i])));
+        size = size * 16 + static_cast<size_t>(c <= '9' ? c - '0' : c - 'a' + 10);
+    }
+    if (digits == 0) return fail(400, "Malformed chunk");
+    // Only whitespace may come between the size and its extensions
+    size_t rest = digits;
+    while (rest < line_end && (data[rest] == ' ' || data[rest] == '\t')) ++rest;
+    if (rest < line_end && data[rest] != ';') return fail(400, "Malformed chunk");
+
+    if (size == 0) {
+        state = Trailers;
+    } else {
+        if (req.body.size() + size > maxBodyBytes) return fail(413, "Request body too large");
+        remaining = size;
+        state = ChunkData;
+    }
+    return line_end + 2;
+}
+
+std::string serializeResponseHead(const HttpResponse& response, size_t bodyLength, bool chunked, bool keepAlive,
+                                  int keepAliveTimeoutSec) {
+    std::string head = "HTTP/1.1 " + std::to_string(response.status) + " " + statusText(response.status) + "\r\n" +
+                       CORS_HEADERS;
+    if ((chunked || bodyLength > 0) && !response.contentType.empty()) {
+        head += "Content-Type: " + response.contentType + "\r\n";
+    }
+    for (const auto& h : response.headers) {
+        head += h.first + ": " + h.second + "\r\n";
+    }
+    if (chunked) {
+        head += "Transfer-Encoding: chunked\r\n";
+    } else if (response.status != 304) { // A 304 never has a body
+        head += "Content-Length: " + std::to_string(bodyLength) + "\r\n";
+    }
+    if (keepAlive) {
+        head += "Connection: keep-alive\r\n"
+                "Keep-Alive: timeout=" + std::to_string(keepAliveTimeoutSec) + "\r\n";
+    } else {
+        head += "Connection: close\r\n";
+    }
+    head += "\r\n";
+    return head;
+}
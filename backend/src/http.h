@@ -0,0 +1,160 @@
+#ifndef HTTP_H
+#define HTTP_H
+
+#include <string>
+#include <vector>
+#include <utility>
+#include <functional>
+#include <memory>
+#include <memory_resource>
+
+struct RequestMetrics; // metrics.h
+
+// A parsed HTTP/1.x request
+struct HttpRequest {
+    std::string method;
+    std::string path;
+    std::string query;   // Text after '?', without the '?'
+    std::string version; // e.g. "HTTP/1.1"
+    std::vector<std::pair<std::string, std::string>> headers; // Names are lower-cased
+    std::string body;
+
+    // Where handlers allocate temporaries that die with the request, such as
+    // the parsed body; the server points it at its worker's RequestArena
+    std::pmr::memory_resource* arena = std::pmr::get_default_resource();
+
+    // Where handlers report the algorithm they ran and the frames it
+    // produced, for /api/metrics; may be null
+    RequestMetrics* metrics = nullptr;
+
+    // Value of a header (name must be lower-case), or an empty string
+    std::string header(const std::string& name) const;
+
+    // Percent-decoded value of a query string parameter, or an empty string
+    std::string queryParam(const std::string& name) const;
+
+    // Value of a cookie from the Cookie header, or an empty string
+    std::string cookie(const std::string& name) const;
+
+    // HTTP/1.1 defaults to persistent connections, HTTP/1.0 must opt in
+    bool keepAlive() const;
+};
+
+// Sink for a response body that is produced while it is being sent
+class ResponseStream {
+public:
+    virtual ~ResponseStream() {}
+    virtual void write(const char* data, size_t length) = 0;
+
+    // Send what was written so far now, rather than collect more first
+    virtual void flush() {}
+
+    void write(const std::string& data) { write(data.data(), data.size()); }
+};
+
+// Body bytes that live in a buffer shared with other responses, such as a
+// cached result or a mapped cache file; 'owner' keeps them alive until sent
+struct SharedBody {
+    std::shared_ptr<const void> owner;
+    const char* data = nullptr;
+    size_t length = 0;
+};
+
+// A response produced by a route handler. Either 'body' followed by
+// 'bodyParts' and 'sharedBody' holds the complete payload, or 'producer'
+// writes it incrementally and it is sent with chunked transfer coding as it
+// is generated. Large bodies are built as parts so that they are never
+// copied into one buffer, and shared ones are sent from where they are kept.
+struct HttpResponse {
+    int status = 200;
+    std::string contentType = "application/json";
+    std::string body;
+    std::vector<std::string> bodyParts;
+    SharedBody sharedBody;
+    std::function<void(ResponseStream&)> producer;
+    std::vector<std::pair<std::string, std::string>> headers; // Extra headers, e.g. Set-Cookie
+
+    size_t bodySize() const {
+        size_t size = body.size() + sharedBody.length;
+        for (const auto& part : bodyParts) size += part.size();
+        return size;
+    }
+};
+
+// Reason phrase for a status code
+const char* statusText(int statusCode);
+
+// Parse the request line and headers in [data, data + length), which must end
+// just before the blank line. Returns false for malformed input.
+bool parseRequestHead(const char* data, size_t length, HttpRequest& request);
+
+// Incremental HTTP/1.1 request parser. Bytes are offered with feed(); the
+// parser consumes what it can and any unconsumed tail must be offered again
+// (with more data appended) on the next call, so request heads are parsed in
+// place in the connection buffer. Supports Content-Length and chunked bodies.
+class HttpRequestParser {
+public:
+    enum Status {
+        NeedMore,
+        Complete,
+        Failed
+    };
+
+    HttpRequestParser(size_t maxHeaderBytes, size_t maxBodyBytes);
+
+    // Consume bytes from [data, data + length); returns the number used
+    size_t feed(const char* data, size_t length);
+
+    Status status() const;
+    bool headComplete() const;
+
+    // HTTP status to answer with once the parser has Failed (400, 413, 431 or 501)
+    int errorStatus() const;
+    const char* errorMessage() const;
+
+    // True once, right after a head carrying "Expect: 100-continue" was parsed
+    bool takeContinueRequest();
+
+    // Bytes of a Content-Length body still expected. Callers may receive these
+    // straight into request().body and report them with bodyAppended().
+    size_t bodyBytesWanted() const;
+    void bodyAppended(size_t count);
+
+    HttpRequest& request();
+
+    // Prepare for the next request on the same connection
+    void reset();
+
+private:
+    enum State {
+        Head,
+        FixedBody,
+        ChunkSize,
+        ChunkData,
+        ChunkDataEnd,
+        Trailers,
+        Done,
+        Error
+    };
+
+    size_t parseHead(const char* data, size_t length);
+    size_t parseChunked(const char* data, size_t length);
+    size_t fail(int statusCode, const char* message);
+
+    State state;
+    size_t maxHeaderBytes;
+    size_t maxBodyBytes;
+    size_t scanned;   // Bytes already searched for the end of the current head or line
+    size_t remaining; // Bytes left in the fixed-length body or current chunk
+    bool continueRequested;
+    int error;
+    const char* errorText;
+    HttpRequest req;
+};
+
+// Status line and headers for a response with 'bodyLength' bytes of body,
+// or for a chunked body of unknown length when 'chunked' is set
+std::string serializeResponseHead(const HttpResponse& response, size_t bodyLength, bool chunked, bool keepAlive,
+                                  int keepAliveTimeoutSec);
+
+#endif // HTTP_H
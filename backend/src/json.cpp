@@ -0,0 +1,214 @@
+#include "json.h"
+#include <algorithm>
+#include <cstdint>
+
+static bool isSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+static void skipSpace(const char*& p, const char* end) {
+    while (p < end && isSpace(*p)) ++p;
+}
+
+[[noreturn]] static void fail(const char* what, const char* begin, const char* at) {
+    throw std::invalid_argument(std::string("Invalid JSON: ") + what + " at offset " + std::to_string(at - begin));
+}
+
+// Append code point 'cp' to 'out' as UTF-8
+static void appendUtf8(std::pmr::string& out, uint32_t cp) {
+    if (cp < 0x80) {
+        out += static_cast<char>(cp);
+    } else if (cp < 0x800) {
+        out += static_cast<char>(0xC0 | (cp >> 6));
+        out += static_cast<char>(0x80 | (cp & 0x3F));
+    } else if (cp < 0x10000) {
+        out += static_cast<char>(0xE0 | (cp >> 12));
+        out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (cp & 0x3F));
+    } else {
+        out += static_cast<char>(0xF0 | (cp >> 18));
+        out += static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+        out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (cp & 0x3F));
+    }
+}
+
+static uint32_t parseHex4(const char* p, const char* end, const char* begin) {
+    uint32_t value = 0;
+    if (end - p < 4) fail("truncated \\u escape", begin, p);
+    auto result = std::from_chars(p, p + 4, value, 16);
+    if (result.ptr != p + 4) fail("bad \\u escape", begin, p);
+    return value;
+}
+
+// Scans the string starting at the opening quote at 'p' and leaves 'p' just
+// past the closing quote. Returns its contents, decoded into 'decoded' only
+// if it holds escape sequences.
+static std::string_view scanString(const char*& p, const char* end, const char* begin, std::pmr::deque<std::pmr::string>& decoded) {
+    const char* start = ++p;
+    while (p < end && *p != '"' && *p != '\\') ++p;
+    if (p < end && *p == '"') return std::string_view(start, p++ - start);
+
+    std::pmr::string out(start, p - start, decoded.get_allocator());
+    while (p < end && *p != '"') {
+        if (*p != '\\') {
+            out += *p++;
+            continue;
+        }
+        if (++p == end) break;
+        char c = *p++;
+        switch (c) {
+            case '"': out += '"'; break;
+            case '\\': out += '\\'; break;
+            case '/': out += '/'; break;
+            case 'b': out += '\b'; break;
+            case 'f': out += '\f'; break;
+            case 'n': out += '\n'; break;
+            case 'r': out += '\r'; break;
+            case 't': out += '\t'; break;
+            case 'u': {
+                uint32_t cp = parseHex4(p, end, begin);
+                p += 4;
+                // A high surrogate followed by a low one encodes a code point above U+FFFF
+                if (cp >= 0xD800 && cp < 0xDC00 && end - p >= 6 && p[0] == '\\' && p[1] == 'u') {
+                    uint32_t low = parseHex4(p + 2, end, begin);
+                    if (low >= 0xDC00 && low < 0xE000) {
+                        cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+                        p += 6;
+                    }
+                }
+                appendUtf8(out, cp);
+                break;
+            }
+            default:
+                fail("bad escape", begin, p - 1);
+        }
+    }
+    if (p == end) fail("unterminated string", begin, start - 1);
+    ++p;
+    decoded.push_back(std::move(out));
+    return decoded.back();
+}
+
+// Leaves 'p' just past the array or object opening at 'p'. Only brackets and
+// strings are tracked; the contents are validated by whoever parses them.
+static void skipContainer(const char*& p, const char* end, const char* begin) {
+    const char* start = p;
+    int depth = 0;
+    while (p < end) {
+        char c = *p++;
+        if (c == '[' || c == '{') {
+            ++depth;
+        } else if (c == ']' || c == '}') {
+            if (--depth == 0) return;
+        } else if (c == '"') {
+            while (p < end && *p != '"') p += *p == '\\' ? 2 : 1;
+            if (p >= end) break;
+            ++p;
+        }
+    }
+    fail("unterminated array or object", begin, start);
+}
+
+JsonObject::JsonObject(std::string_view text, std::pmr::memory_resource* memory) : members(memory), decoded(memory) {
+    const char* begin = text.data();
+    const char* p = begin;
+    const char* end = begin + text.size();
+
+    skipSpace(p, end);
+    if (p == end || *p != '{') fail("expected '{'", begin, p);
+    ++p;
+    skipSpace(p, end);
+    if (p < end && *p == '}') {
+        ++p;
+    } else {
+        for (;;) {
+            skipSpace(p, end);
+            if (p == end || *p != '"') fail("expected a member name", begin, p);
+            std::string_view key = scanString(p, end, begin, decoded);
+
+            skipSpace(p, end);
+            if (p == end || *p != ':') fail("expected ':'", begin, p);
+            ++p;
+            skipSpace(p, end);
+            if (p == end) fail("expected a value", begin, p);
+
+            std::string_view value;
+            if (*p == '"') {
+                value = scanString(p, end, begin, decoded);
+            } else if (*p == '[' || *p == '{') {
+                const char* start = p;
+                skipContainer(p, end, begin);
+                value = std::string_view(start, p - start);
+            } else {
+                // Number or literal
+                const char* start = p;
+                while (p < end && *p != ',' && *p != '}' && !isSpace(*p)) ++p;
+                if (p == start) fail("expected a value", begin, p);
+                value = std::string_view(start, p - start);
+            }
+            members.emplace_back(key, value);
+
+            skipSpace(p, end);
+            if (p < end && *p == ',') {
+                ++p;
+            } else if (p < end && *p == '}') {
+                ++p;
+                break;
+            } else {
+                fail("expected ',' or '}'", begin, p);
+            }
+        }
+    }
+    skipSpace(p, end);
+    if (p != end) fail("unexpected text after the object", begin, p);
+}
+
+std::string_view JsonObject::operator[](std::string_view key) const {
+    // Later duplicates win, as they would when building a map
+    for (auto it = members.rbegin(); it != members.rend(); ++it) {
+        if (it->first == key) return it->second;
+    }
+    return std::string_view();
+}
+
+std::vector<int> parseIntArray(std::string_view text) {
+    const char* begin = text.data();
+    const char* p = begin;
+    const char* end = begin + text.size();
+
+    std::vector<int> array;
+    skipSpace(p, end);
+    if (p == end || *p != '[') fail("expected '['", begin, p);
+    ++p;
+    skipSpace(p, end);
+    if (p < end && *p == ']') {
+        ++p;
+    } else {
+        // One element per comma, so the vector is sized once instead of
+        // growing (and copying) about log2(n) times
+        array.reserve(std::count(p, end, ',') + 1);
+        for (;;) {
+            skipSpace(p, end);
+            int value;
+            auto result = std::from_chars(p, end, value);
+            if (result.ec == std::errc::result_out_of_range) fail("integer out of range", begin, p);
+            if (result.ec != std::errc()) fail("expected an integer", begin, p);
+            array.push_back(value);
+            p = result.ptr;
+
+            skipSpace(p, end);
+            if (p < end && *p == ',') {
+                ++p;
+            } else if (p < end && *p == ']') {
+                ++p;
+                break;
+            } else {
+                fail("expected ',' or ']'", begin, p);
+            }
+        }
+    }
+    skipSpace(p, end);
+    if (p != end) fail("unexpected text after the array", begin, p);
+    return array;
+}
@@ -0,0 +1,60 @@
+#ifndef JSON_H
+#define JSON_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <deque>
+#include <memory_resource>
+#include <utility>
+#include <charconv>
+#include <stdexcept>
+
+// Top-level members of a JSON object, parsed in one pass over the text
+// without copying it. Values are views into that text, which must outlive the
+// object: string values without their quotes, anything else (numbers,
+// literals, nested arrays and objects) exactly as written. Only strings
+// holding escape sequences are decoded, into storage owned by the object.
+// That storage and the member list come from 'memory', e.g. a RequestArena.
+class JsonObject {
+public:
+    JsonObject() {}
+
+    // Throws std::invalid_argument for text that is not a JSON object
+    explicit JsonObject(std::string_view text, std::pmr::memory_resource* memory = std::pmr::get_default_resource());
+
+    // Value of a member, or an empty view if there is none
+    std::string_view operator[](std::string_view key) const;
+
+    // Every member as a (name, value) pair, in the order written
+    typedef std::pmr::vector<std::pair<std::string_view, std::string_view>>::const_iterator const_iterator;
+    const_iterator begin() const { return members.begin(); }
+    const_iterator end() const { return members.end(); }
+
+private:
+    std::pmr::vector<std::pair<std::string_view, std::string_view>> members;
+    std::pmr::deque<std::pmr::string> decoded; // Unescaped strings; a deque never moves them
+};
+
+// Parse a request body such as {"algorithm":"quick","array":"[5,3,8]"}
+inline JsonObject parseJson(std::string_view text, std::pmr::memory_resource* memory = std::pmr::get_default_resource()) {
+    return JsonObject(text, memory);
+}
+
+// An integer written as the whole of 'text', e.g. "-42". Throws
+// std::invalid_argument when it is malformed or out of range for T.
+template <typename T>
+T parseNumber(std::string_view text) {
+    T value = 0;
+    const char* end = text.data() + text.size();
+    auto result = std::from_chars(text.data(), end, value);
+    if (result.ec != std::errc() || result.ptr != end || text.empty()) {
+        throw std::invalid_argument("Invalid integer: " + std::string(text.substr(0, 32)));
+    }
+    return value;
+}
+
+// Parse a JSON array of integers such as "[5, -3, 8]" straight into a vector
+std::vector<int> parseIntArray(std::string_view text);
+
+#endif // JSON_H
@@ -1,11 +1,56 @@
 #include <iostream>
+#include <cstdlib>
+#include <cstring>
 #include "server.h"
 
-int main() {
+int main(int argc, char* argv[]) {
     std::cout << "Starting Algorithm Visualizer Backend..." << std::endl;
-    
-    AlgoServer server(8080);
+
+    // Usage: algo_server [--port N] [--threads N] [--max-body-mb N] [--trace-store-mb N]
+    //                    [--session-store-mb N] [--session-limit-kb N] [--debug-trace-events N]
+    //                    [--pool-threads N] [--pool-queue N] [--max-estimated-ms N]
+    //                    [--result-cache-mb N] [--disk-cache-dir DIR] [--disk-cache-mb N]
+    //                    [--compression-level N] [--compress-min-bytes N]
+    ServerConfig config;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (std::strcmp(argv[i], "--port") == 0) {
+            config.port = std::atoi(argv[i + 1]);
+        } else if (std::strcmp(argv[i], "--threads") == 0) {
+            config.threads = std::atoi(argv[i + 1]);
+        } else if (std::strcmp(argv[i], "--max-body-mb") == 0) {
+            config.maxBodyBytes = static_cast<size_t>(std::atoi(argv[i + 1])) * 1024 * 1024;
+        } else if (std::strcmp(argv[i], "--trace-store-mb") == 0) {
+            config.traceStoreBytes = static_cast<size_t>(std::atoi(argv[i + 1])) * 1024 * 1024;
+        } else if (std::strcmp(argv[i], "--session-store-mb") == 0) {
+            config.sessionStoreBytes = static_cast<size_t>(std::atoi(argv[i + 1])) * 1024 * 1024;
+        } else if (std::strcmp(argv[i], "--session-limit-kb") == 0) {
+            config.sessionLimitBytes = static_cast<size_t>(std::atoi(argv[i + 1])) * 1024;
+        } else if (std::strcmp(argv[i], "--debug-trace-events") == 0) {
+            config.debugTraceEvents = static_cast<size_t>(std::atoi(argv[i + 1]));
+        } else if (std::strcmp(argv[i], "--pool-threads") == 0) {
+            config.poolThreads = std::atoi(argv[i + 1]);
+        } else if (std::strcmp(argv[i], "--pool-queue") == 0) {
+            config.poolQueueLimit = static_cast<size_t>(std::atoi(argv[i + 1]));
+        } else if (std::strcmp(argv[i], "--max-estimated-ms") == 0) {
+            config.maxEstimatedMs = std::atof(argv[i + 1]);
+        } else if (std::strcmp(argv[i], "--result-cache-mb") == 0) {
+            config.resultCacheBytes = static_cast<size_t>(std::atoi(argv[i + 1])) * 1024 * 1024;
+        } else if (std::strcmp(argv[i], "--disk-cache-dir") == 0) {
+            config.diskCacheDir = argv[i + 1];
+        } else if (std::strcmp(argv[i], "--disk-cache-mb") == 0) {
+            config.diskCacheBytes = static_cast<size_t>(std::atoi(argv[i + 1])) * 1024 * 1024;
+        } else if (std::strcmp(argv[i], "--compression-level") == 0) {
+            config.compressionLevel = std::atoi(argv[i + 1]);
+        } else if (std::strcmp(argv[i], "--compress-min-bytes") == 0) {
+            config.compressMinBytes = static_cast<size_t>(std::atoi(argv[i + 1]));
+        } else {
+            std::cerr << "Unknown option: " << argv[i] << std::endl;
+            return 1;
+        }
+    }
+
+    AlgoServer server(config);
     server.start();
-    
+
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,187 @@
+#include "metrics.h"
+#include <cstdio>
+#include <cmath>
+
+// The owning thread is the only writer, so an increment need not be atomic
+// as a whole; the relaxed store just keeps readers from seeing a torn value
+static void add(std::atomic<uint64_t>& counter, uint64_t n) {
+    counter.store(counter.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
+
+static void add(std::atomic<int64_t>& gauge, int64_t n) {
+    gauge.store(gauge.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
+
+static uint64_t read(const std::atomic<uint64_t>& counter) {
+    return counter.load(std::memory_order_relaxed);
+}
+
+size_t LatencyHistogram::bucketFor(uint64_t micros) {
+    if (micros < 16) return static_cast<size_t>(micros);
+    int msb = 4;
+    while (micros >> (msb + 1)) ++msb;
+    int shift = msb - 3;
+    size_t bucket = static_cast<size_t>(shift + 1) * 8 + ((micros >> shift) & 7);
+    return bucket < BUCKETS ? bucket : BUCKETS - 1;
+}
+
+uint64_t LatencyHistogram::bucketUpperBound(size_t bucket) {
+    if (bucket < 16) return bucket;
+    int shift = static_cast<int>(bucket / 8) - 1;
+    uint64_t lower = (8 + bucket % 8) << shift;
+    return lower + (uint64_t(1) << shift) - 1;
+}
+
+void LatencyHistogram::record(uint64_t micros) {
+    add(counts[bucketFor(micros)], 1);
+}
+
+void LatencyHistogram::addTo(std::vector<uint64_t>& totals) const {
+    totals.resize(BUCKETS);
+    for (size_t i = 0; i < BUCKETS; ++i) totals[i] += read(counts[i]);
+}
+
+ThreadMetrics::RouteMetrics& ThreadMetrics::begin(std::string_view route) {
+    // Lookups need no lock: this thread is the only one that inserts
+    auto it = routes.find(route);
+    if (it == routes.end()) {
+        std::lock_guard<std::mutex> lock(mutex);
+        it = routes.emplace(std::piecewise_construct, std::forward_as_tuple(route), std::forward_as_tuple()).first;
+    }
+    add(it->second.inFlight, 1);
+    return it->second;
+}
+
+SeriesMetrics& ThreadMetrics::series(RouteMetrics& route, std::string_view algorithm) {
+    auto it = route.algorithms.find(algorithm);
+    if (it != route.algorithms.end()) return *it->second;
+    std::lock_guard<std::mutex> lock(mutex);
+    return *route.algorithms.emplace(std::string(algorithm), new SeriesMetrics()).first->second;
+}
+
+void ThreadMetrics::finish(RouteMetrics& route, const RequestMetrics& request, int status, uint64_t requestBytes,
+                           uint64_t responseBytes, uint64_t micros) {
+    add(route.inFlight, -1);
+    SeriesMetrics& s = series(route, request.algorithm);
+    add(s.requests, 1);
+    if (status >= 400) add(s.errors, 1);
+    add(s.requestBytes, requestBytes);
+    add(s.responseBytes, responseBytes);
+    add(s.steps, request.steps);
+    add(s.latencySumMicros, micros);
+    s.latency.record(micros);
+}
+
+ThreadMetrics& MetricsRegistry::registerThread() {
+    std::lock_guard<std::mutex> lock(mutex);
+    threads.emplace_back(new ThreadMetrics());
+    return *threads.back();
+}
+
+// A series summed over all threads
+struct SeriesTotals {
+    uint64_t requests = 0;
+    uint64_t errors = 0;
+    uint64_t requestBytes = 0;
+    uint64_t responseBytes = 0;
+    uint64_t steps = 0;
+    uint64_t latencySumMicros = 0;
+    std::vector<uint64_t> latency;
+};
+
+// Label values are quoted; backslash, quote and newline are escaped
+static std::string labelValue(const std::string& value) {
+    std::string out = "\"";
+    for (char c : value) {
+        if (c == '\\' || c == '"') {
+            out += '\\';
+            out += c;
+        } else if (c == '\n') {
+            out += "\\n";
+        } else {
+            out += c;
+        }
+    }
+    return out + "\"";
+}
+
+// Upper bound of the bucket holding the q-quantile, in seconds
+static double quantileSeconds(const std::vector<uint64_t>& buckets, uint64_t count, double q) {
+    if (count == 0) return 0;
+    uint64_t rank = static_cast<uint64_t>(std::ceil(q * count));
+    if (rank == 0) rank = 1;
+    uint64_t seen = 0;
+    for (size_t i = 0; i < buckets.size(); ++i) {
+        seen += buckets[i];
+        if (seen >= rank) return LatencyHistogram::bucketUpperBound(i) / 1e6;
+    }
+    return LatencyHistogram::bucketUpperBound(buckets.size() - 1) / 1e6;
+}
+
+std::string MetricsRegistry::renderPrometheus() const {
+    std::map<std::pair<std::string, std::string>, SeriesTotals> totals;
+    std::map<std::string, int64_t> inFlight;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (const auto& thread : threads) {
+            std::lock_guard<std::mutex> threadLock(thread->mutex);
+            for (const auto& route : thread->routes) {
+                inFlight[route.first] += route.second.inFlight.load(std::memory_order_relaxed);
+                for (const auto& algorithm : route.second.algorithms) {
+                    const SeriesMetrics& series = *algorithm.second;
+                    SeriesTotals& sum = totals[std::make_pair(route.first, algorithm.first)];
+                    sum.requests += read(series.requests);
+                    sum.errors += read(series.errors);
+                    sum.requestBytes += read(series.requestBytes);
+                    sum.responseBytes += read(series.responseBytes);
+                    sum.steps += read(series.steps);
+                    sum.latencySumMicros += read(series.latencySumMicros);
+                    series.latency.addTo(sum.latency);
+                }
+            }
+        }
+    }
+
+    std::string out;
+    char line[512];
+    auto counter = [&](const char* name, const char* help, uint64_t SeriesTotals::*field) {
+        std::snprintf(line, sizeof(line), "# HELP %s %s\n# TYPE %s counter\n", name, help, name);
+        out += line;
+        for (const auto& entry : totals) {
+            out += name;
+            out += "{route=" + labelValue(entry.first.first) + ",algorithm=" + labelValue(entry.first.second) + "} ";
+            out += std::to_string(entry.second.*field) + "\n";
+        }
+    };
+    counter("algo_requests_total", "Requests served.", &SeriesTotals::requests);
+    counter("algo_request_errors_total", "Requests answered with a 4xx or 5xx status.", &SeriesTotals::errors);
+    counter("algo_request_bytes_total", "Request bytes received, head and body.", &SeriesTotals::requestBytes);
+    counter("algo_response_bytes_total", "Response bytes sent, head and body.", &SeriesTotals::responseBytes);
+    counter("algo_steps_generated_total", "Visualization frames generated.", &SeriesTotals::steps);
+
+    out += "# HELP algo_request_duration_seconds Time from a complete request until its response is queued, or fully written when streamed.\n"
+           "# TYPE algo_request_duration_seconds summary\n";
+    static const struct {
+        const char* label;
+        double value;
+    } quantiles[] = {{"0.5", 0.5}, {"0.99", 0.99}, {"0.999", 0.999}};
+    for (const auto& entry : totals) {
+        std::string labels = "route=" + labelValue(entry.first.first) + ",algorithm=" + labelValue(entry.first.second);
+        for (const auto& q : quantiles) {
+            std::snprintf(line, sizeof(line), "algo_request_duration_seconds{%s,quantile=\"%s\"} %.6f\n",
+                          labels.c_str(), q.label, quantileSeconds(entry.second.latency, entry.second.requests, q.value));
+            out += line;
+        }
+        std::snprintf(line, sizeof(line), "algo_request_duration_seconds_sum{%s} %.6f\n", labels.c_str(),
+                      entry.second.latencySumMicros / 1e6);
+        out += line;
+        out += "algo_request_duration_seconds_count{" + labels + "} " + std::to_string(entry.second.requests) + "\n";
+    }
+
+    out += "# HELP algo_requests_in_flight Requests being handled or streamed.\n"
+           "# TYPE algo_requests_in_flight gauge\n";
+    for (const auto& route : inFlight) {
+        out += "algo_requests_in_flight{route=" + labelValue(route.first) + "} " + std::to_string(route.second) + "\n";
+    }
+    return out;
+}
@@ -0,0 +1,95 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <string>
+#include <string_view>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <tuple>
+
+#include "phase_trace.h"
+
+// What a handler reports about the request it served, on top of what the
+// server measures itself
+struct RequestMetrics {
+    std::string algorithm; // Series label, e.g. "merge"; empty where none applies
+    size_t steps = 0;      // Frames generated
+    PhaseContext phases;   // Where to record the request's phases (see phase_trace.h)
+};
+
+// Latency histogram with HDR-style log-linear buckets: values below 16 have
+// a bucket each, and every power of two above is split into 8 linear
+// sub-buckets, so a recorded value is known to within 12.5% from 1
+// microsecond to days in a fixed set of counters.
+class LatencyHistogram {
+public:
+    static const size_t BUCKETS = 320;
+
+    // Only the owning thread records; any thread may read
+    void record(uint64_t micros);
+    void addTo(std::vector<uint64_t>& totals) const;
+
+    static size_t bucketFor(uint64_t micros);
+    static uint64_t bucketUpperBound(size_t bucket); // Highest value the bucket holds
+
+private:
+    std::atomic<uint64_t> counts[BUCKETS] = {};
+};
+
+// Counters of one route and algorithm on one thread
+struct SeriesMetrics {
+    std::atomic<uint64_t> requests{0};
+    std::atomic<uint64_t> errors{0}; // Responses with a 4xx or 5xx status
+    std::atomic<uint64_t> requestBytes{0};
+    std::atomic<uint64_t> responseBytes{0};
+    std::atomic<uint64_t> steps{0};
+    std::atomic<uint64_t> latencySumMicros{0};
+    LatencyHistogram latency;
+};
+
+// Metrics one event loop thread records. Only that thread writes them, so
+// updates are plain relaxed loads and stores with no locked instructions;
+// the mutex is taken only to add a series and by the scraper to read them.
+class ThreadMetrics {
+public:
+    struct RouteMetrics {
+        std::atomic<int64_t> inFlight{0};
+        std::map<std::string, std::unique_ptr<SeriesMetrics>, std::less<>> algorithms;
+    };
+
+    // Called by the owning thread when it starts handling a request for
+    // 'route', and when the response to it has been sent
+    RouteMetrics& begin(std::string_view route);
+    void finish(RouteMetrics& route, const RequestMetrics& request, int status, uint64_t requestBytes,
+                uint64_t responseBytes, uint64_t micros);
+
+private:
+    friend class MetricsRegistry;
+
+    SeriesMetrics& series(RouteMetrics& route, std::string_view algorithm);
+
+    mutable std::mutex mutex;
+    std::map<std::string, RouteMetrics, std::less<>> routes;
+};
+
+// Per-route, per-algorithm request metrics of the whole server, kept per
+// thread and summed when scraped
+class MetricsRegistry {
+public:
+    // Counters for a new event loop thread; they live as long as the registry
+    ThreadMetrics& registerThread();
+
+    // Everything in the Prometheus text exposition format
+    std::string renderPrometheus() const;
+
+private:
+    mutable std::mutex mutex;
+    std::vector<std::unique_ptr<ThreadMetrics>> threads;
+};
+
+#endif // METRICS_H
@@ -0,0 +1,73 @@
+#include "phase_trace.h"
+#include <algorithm>
+
+static int64_t micros(std::chrono::steady_clock::time_point t) {
+    return std::chrono::duration_cast<std::chrono::microseconds>(t.time_since_epoch()).count();
+}
+
+PhaseRing::PhaseRing(size_t capacity, int thread, const char* kind)
+    : events(std::max<size_t>(capacity, 1)), next(0), wrapped(false), thread(thread), kind(kind), requests(0) {}
+
+void PhaseRing::record(const char* name, uint64_t request, std::chrono::steady_clock::time_point start,
+                       std::chrono::steady_clock::time_point end, std::string_view args) {
+    // Only the reader contends for this lock, and only while dumping
+    std::lock_guard<std::mutex> lock(mutex);
+    PhaseEvent& event = events[next];
+    event.name = name;
+    event.request = request;
+    event.startMicros = micros(start);
+    event.durationMicros = micros(end) - micros(start);
+    event.args.assign(args.data(), args.size()); // Reuses the slot's capacity
+    if (++next == events.size()) {
+        next = 0;
+        wrapped = true;
+    }
+}
+
+PhaseTracer::PhaseTracer(size_t eventsPerThread) : eventsPerThread(eventsPerThread) {}
+
+PhaseRing* PhaseTracer::registerThread(const char* kind) {
+    if (!enabled()) return nullptr;
+    std::lock_guard<std::mutex> lock(mutex);
+    rings.emplace_back(new PhaseRing(eventsPerThread, static_cast<int>(rings.size()) + 1, kind));
+    return rings.back().get();
+}
+
+std::string PhaseTracer::renderChromeTrace() const {
+    std::string out = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    bool first = true;
+    auto separate = [&] {
+        if (!first) out += ',';
+        first = false;
+    };
+
+    std::lock_guard<std::mutex> lock(mutex);
+    for (const auto& ring : rings) {
+        std::lock_guard<std::mutex> ringLock(ring->mutex);
+        std::string thread = std::to_string(ring->thread);
+
+        separate();
+        out += "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" + thread +
+               ",\"args\":{\"name\":\"" + ring->kind + " " + thread + "\"}}";
+
+        // Oldest first
+        size_t count = ring->wrapped ? ring->events.size() : ring->next;
+        size_t begin = ring->wrapped ? ring->next : 0;
+        for (size_t i = 0; i < count; ++i) {
+            const PhaseEvent& event = ring->events[(begin + i) % ring->events.size()];
+            separate();
+            out += "{\"name\":\"";
+            out += event.name;
+            out += "\",\"cat\":\"request\",\"ph\":\"X\",\"pid\":1,\"tid\":" + thread;
+            out += ",\"ts\":" + std::to_string(event.startMicros) + ",\"dur\":" + std::to_string(event.durationMicros);
+            out += ",\"args\":{\"request\":" + std::to_string(event.request);
+            if (!event.args.empty()) {
+                out += ',';
+                out += event.args;
+            }
+            out += "}}";
+        }
+    }
+    out += "]}";
+    return out;
+}
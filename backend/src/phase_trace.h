@@ -0,0 +1,107 @@
+#ifndef PHASE_TRACE_H
+#define PHASE_TRACE_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+
+// One timed phase of a request: reading it, parsing it, running the
+// algorithm, writing the response. Becomes a complete ("ph":"X") event in
+// Chrome's trace_event format.
+struct PhaseEvent {
+    const char* name = "";  // A string literal
+    uint64_t request = 0;   // Id shared by the phases of one request
+    int64_t startMicros = 0;
+    int64_t durationMicros = 0;
+    std::string args;       // Members of the event's "args" object, e.g. "frames":12; may be empty
+};
+
+// The most recent phases recorded by one event loop or pool thread. Older
+// events are overwritten. The owning thread records; /api/debug/trace reads.
+class PhaseRing {
+public:
+    // 'kind' is a string literal naming the thread in the trace, e.g. "event loop"
+    PhaseRing(size_t capacity, int thread, const char* kind);
+
+    void record(const char* name, uint64_t request, std::chrono::steady_clock::time_point start,
+                std::chrono::steady_clock::time_point end, std::string_view args = std::string_view());
+
+    // Ids for this thread's requests, unique across threads
+    uint64_t nextRequestId() { return (++requests << 8) | static_cast<uint64_t>(thread & 0xff); }
+
+private:
+    friend class PhaseTracer;
+
+    std::mutex mutex;
+    std::vector<PhaseEvent> events;
+    size_t next;  // Slot the next event goes to
+    bool wrapped; // Every slot holds an event
+    int thread;
+    const char* kind;
+    uint64_t requests;
+};
+
+// Request phase tracing for the whole server, one ring per event loop and
+// pool thread. A request handed to the pool has its phases on two threads,
+// tied together by the request id in their "args".
+class PhaseTracer {
+public:
+    // 'eventsPerThread' of 0 turns tracing off
+    explicit PhaseTracer(size_t eventsPerThread);
+
+    bool enabled() const { return eventsPerThread > 0; }
+
+    // The ring for a new thread of the given kind (see PhaseRing), or
+    // nullptr when tracing is off
+    PhaseRing* registerThread(const char* kind);
+
+    // Every ring as a Chrome trace_event JSON document, for Perfetto or chrome://tracing
+    std::string renderChromeTrace() const;
+
+private:
+    size_t eventsPerThread;
+    mutable std::mutex mutex;
+    std::vector<std::unique_ptr<PhaseRing>> rings;
+};
+
+// Where the phases of one request go: its thread's ring, or none while
+// tracing is off
+struct PhaseContext {
+    PhaseRing* ring = nullptr;
+    uint64_t request = 0;
+};
+
+// Records the time from construction to end() or destruction as a phase of
+// a request. Without a ring it does nothing and never reads the clock, so
+// phases cost one branch each while tracing is off.
+class ScopedPhase {
+public:
+    ScopedPhase(const PhaseContext& context, const char* name) : context(context), name(name) {
+        if (context.ring) start = std::chrono::steady_clock::now();
+    }
+
+    ~ScopedPhase() { end(); }
+
+    // Close the phase early, attaching 'args' (see PhaseEvent)
+    void end(std::string_view args = std::string_view()) {
+        if (!context.ring) return;
+        context.ring->record(name, context.request, start, std::chrono::steady_clock::now(), args);
+        context.ring = nullptr;
+    }
+
+    ScopedPhase(const ScopedPhase&) = delete;
+    ScopedPhase& operator=(const ScopedPhase&) = delete;
+
+private:
+    PhaseContext context;
+    const char* name;
+    std::chrono::steady_clock::time_point start;
+};
+
+#endif // PHASE_TRACE_H
@@ -0,0 +1,200 @@
+#include "poller.h"
+#include <algorithm>
+
+#ifndef _WIN32
+#include <poll.h>
+#endif
+
+bool waitWritable(int fd, int timeoutMs) {
+    struct pollfd pfd = {};
+    pfd.fd = fd;
+    pfd.events = POLLOUT;
+#ifdef _WIN32
+    int n = WSAPoll(&pfd, 1, timeoutMs);
+#else
+    int n;
+    do {
+        n = poll(&pfd, 1, timeoutMs);
+    } while (n < 0 && errno == EINTR);
+#endif
+    return n > 0 && (pfd.revents & POLLOUT) != 0 && (pfd.revents & (POLLERR | POLLHUP)) == 0;
+}
+
+#ifdef ALGO_USE_EPOLL
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+
+#ifndef EPOLLEXCLUSIVE
+#define EPOLLEXCLUSIVE (1u << 28)
+#endif
+
+static unsigned toEpollEvents(unsigned interest) {
+    unsigned events = EPOLLRDHUP;
+    if (interest & Poller::Readable) events |= EPOLLIN;
+    if (interest & Poller::Writable) events |= EPOLLOUT;
+    return events;
+}
+
+Poller::Poller() {
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+    struct epoll_event ev = {};
+    ev.events = EPOLLIN;
+    ev.data.fd = wake_fd;
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, wake_fd, &ev);
+}
+
+Poller::~Poller() {
+    close(wake_fd);
+    close(epoll_fd);
+}
+
+bool Poller::add(int fd, unsigned interest, bool exclusive) {
+    struct epoll_event ev = {};
+    ev.events = toEpollEvents(interest);
+    if (exclusive) ev.events = (ev.events & ~EPOLLRDHUP) | EPOLLEXCLUSIVE;
+    ev.data.fd = fd;
+    return epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev) == 0;
+}
+
+bool Poller::modify(int fd, unsigned interest) {
+    struct epoll_event ev = {};
+    ev.events = toEpollEvents(interest);
+    ev.data.fd = fd;
+    return epoll_ctl(epoll_fd, EPOLL_CTL_MOD, fd, &ev) == 0;
+}
+
+void Poller::remove(int fd) {
+    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
+}
+
+int Poller::wait(std::vector<Event>& events, int timeoutMs) {
+    struct epoll_event raw[128];
+    int n = epoll_wait(epoll_fd, raw, 128, timeoutMs);
+    events.clear();
+    for (int i = 0; i < n; ++i) {
+        if (raw[i].data.fd == wake_fd) {
+            uint64_t value;
+            while (read(wake_fd, &value, sizeof(value)) > 0) {}
+            continue;
+        }
+
+        Event ev;
+        ev.fd = raw[i].data.fd;
+        ev.readable = (raw[i].events & EPOLLIN) != 0;
+        ev.writable = (raw[i].events & EPOLLOUT) != 0;
+        ev.hangup = (raw[i].events & (EPOLLHUP | EPOLLERR | EPOLLRDHUP)) != 0;
+        events.push_back(ev);
+    }
+    return static_cast<int>(events.size());
+}
+
+void Poller::wakeup() {
+    uint64_t one = 1;
+    ssize_t ignored = write(wake_fd, &one, sizeof(one));
+    (void)ignored;
+}
+
+#else // poll() / WSAPoll() fallback
+
+#ifdef _WIN32
+#define ALGO_POLL WSAPoll
+// Without a wakeup descriptor on Windows, waits are capped so wakeup() is seen promptly
+static const int MAX_WAIT_MS = 50;
+#else
+#define ALGO_POLL poll
+static const int MAX_WAIT_MS = -1;
+#endif
+
+static short toPollEvents(unsigned interest) {
+    short events = 0;
+    if (interest & Poller::Readable) events |= POLLIN;
+    if (interest & Poller::Writable) events |= POLLOUT;
+    return events;
+}
+
+Poller::Poller() : woken(false) {
+#ifndef _WIN32
+    if (pipe(wake_pipe) == 0) {
+        setNonBlocking(wake_pipe[0]);
+        setNonBlocking(wake_pipe[1]);
+        struct pollfd pfd = {};
+        pfd.fd = wake_pipe[0];
+        pfd.events = POLLIN;
+        fds.push_back(pfd);
+    }
+#endif
+}
+
+Poller::~Poller() {
+#ifndef _WIN32
+    close(wake_pipe[0]);
+    close(wake_pipe[1]);
+#endif
+}
+
+bool Poller::add(int fd, unsigned interest, bool) {
+    struct pollfd pfd = {};
+    pfd.fd = fd;
+    pfd.events = toPollEvents(interest);
+    fds.push_back(pfd);
+    return true;
+}
+
+bool Poller::modify(int fd, unsigned interest) {
+    for (auto& pfd : fds) {
+        if (static_cast<int>(pfd.fd) == fd) {
+            pfd.events = toPollEvents(interest);
+            return true;
+        }
+    }
+    return false;
+}
+
+void Poller::remove(int fd) {
+    fds.erase(std::remove_if(fds.begin(), fds.end(),
+                             [fd](const struct pollfd& pfd) { return static_cast<int>(pfd.fd) == fd; }),
+              fds.end());
+}
+
+int Poller::wait(std::vector<Event>& events, int timeoutMs) {
+    if (MAX_WAIT_MS >= 0 && (timeoutMs < 0 || timeoutMs > MAX_WAIT_MS)) {
+        timeoutMs = MAX_WAIT_MS;
+    }
+
+    events.clear();
+    if (woken.exchange(false)) timeoutMs = 0;
+
+    int n = ALGO_POLL(fds.data(), static_cast<unsigned long>(fds.size()), timeoutMs);
+    if (n <= 0) return 0;
+
+    for (const auto& pfd : fds) {
+        if (pfd.revents == 0) continue;
+#ifndef _WIN32
+        if (pfd.fd == wake_pipe[0]) {
+            char drain[64];
+            while (read(wake_pipe[0], drain, sizeof(drain)) > 0) {}
+            continue;
+        }
+#endif
+        Event ev;
+        ev.fd = static_cast<int>(pfd.fd);
+        ev.readable = (pfd.revents & POLLIN) != 0;
+        ev.writable = (pfd.revents & POLLOUT) != 0;
+        ev.hangup = (pfd.revents & (POLLHUP | POLLERR | POLLNVAL)) != 0;
+        events.push_back(ev);
+    }
+    return static_cast<int>(events.size());
+}
+
+void Poller::wakeup() {
+    woken = true;
+#ifndef _WIN32
+    char one = 1;
+    ssize_t ignored = write(wake_pipe[1], &one, 1);
+    (void)ignored;
+#endif
+}
+
+#endif
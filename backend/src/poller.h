@@ -0,0 +1,176 @@
+#ifndef POLLER_H
+#define POLLER_H
+
+#include <vector>
+#include <atomic>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/uio.h>
+#endif
+
+#if defined(__linux__)
+#define ALGO_USE_EPOLL 1
+#elif !defined(_WIN32)
+#include <poll.h>
+#endif
+
+// Small portable socket helpers shared by the event loop
+inline void closeSocket(int fd) {
+#ifdef _WIN32
+    closesocket(fd);
+#else
+    close(fd);
+#endif
+}
+
+inline bool setNonBlocking(int fd) {
+#ifdef _WIN32
+    u_long mode = 1;
+    return ioctlsocket(fd, FIONBIO, &mode) == 0;
+#else
+    int flags = fcntl(fd, F_GETFL, 0);
+    return flags >= 0 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0;
+#endif
+}
+
+inline void setNoDelay(int fd) {
+    int opt = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, (const char*)&opt, sizeof(opt));
+}
+
+// True when the last socket call failed only because it would have blocked
+inline bool socketWouldBlock() {
+#ifdef _WIN32
+    int err = WSAGetLastError();
+    return err == WSAEWOULDBLOCK;
+#else
+    return errno == EAGAIN || errno == EWOULDBLOCK;
+#endif
+}
+
+// send()/recv() wrappers; MSG_NOSIGNAL keeps a dropped peer from raising SIGPIPE
+inline long socketSend(int fd, const char* data, size_t length) {
+#ifdef _WIN32
+    return send(fd, data, static_cast<int>(length), 0);
+#elif defined(MSG_NOSIGNAL)
+    return send(fd, data, length, MSG_NOSIGNAL);
+#else
+    return send(fd, data, length, 0);
+#endif
+}
+
+// One buffer of a gathered send
+struct IoSlice {
+    const char* data;
+    size_t length;
+};
+
+// Most slices passed to one socketSendv() call; callers send the rest next time
+const size_t MAX_IO_SLICES = 64;
+
+// Send up to MAX_IO_SLICES buffers with a single system call (sendmsg() or
+// WSASend()), without first copying them together. Returns bytes sent or -1.
+inline long socketSendv(int fd, const IoSlice* slices, size_t count) {
+    if (count > MAX_IO_SLICES) count = MAX_IO_SLICES;
+#ifdef _WIN32
+    WSABUF buffers[MAX_IO_SLICES];
+    for (size_t i = 0; i < count; ++i) {
+        buffers[i].buf = const_cast<char*>(slices[i].data);
+        buffers[i].len = static_cast<ULONG>(slices[i].length);
+    }
+    DWORD sent = 0;
+    if (WSASend(fd, buffers, static_cast<DWORD>(count), &sent, 0, nullptr, nullptr) != 0) return -1;
+    return static_cast<long>(sent);
+#else
+    struct iovec buffers[MAX_IO_SLICES];
+    for (size_t i = 0; i < count; ++i) {
+        buffers[i].iov_base = const_cast<char*>(slices[i].data);
+        buffers[i].iov_len = slices[i].length;
+    }
+    struct msghdr message = {};
+    message.msg_iov = buffers;
+    message.msg_iovlen = count;
+#ifdef MSG_NOSIGNAL
+    return sendmsg(fd, &message, MSG_NOSIGNAL);
+#else
+    return sendmsg(fd, &message, 0);
+#endif
+#endif
+}
+
+inline long socketRecv(int fd, char* data, size_t length) {
+#ifdef _WIN32
+    return recv(fd, data, static_cast<int>(length), 0);
+#else
+    return recv(fd, data, length, 0);
+#endif
+}
+
+inline bool socketInterrupted() {
+#ifdef _WIN32
+    return false;
+#else
+    return errno == EINTR;
+#endif
+}
+
+// Block until 'fd' is writable or 'timeoutMs' elapses; false on timeout or error
+bool waitWritable(int fd, int timeoutMs);
+
+// Readiness notification for a set of non-blocking sockets.
+// Uses epoll on Linux and poll()/WSAPoll() everywhere else. Each worker
+// thread owns one Poller; only wakeup() may be called from other threads.
+class Poller {
+public:
+    enum Interest {
+        Readable = 1,
+        Writable = 2
+    };
+
+    struct Event {
+        int fd;
+        bool readable;
+        bool writable;
+        bool hangup;
+    };
+
+    Poller();
+    ~Poller();
+
+    Poller(const Poller&) = delete;
+    Poller& operator=(const Poller&) = delete;
+
+    // Register a socket. 'exclusive' avoids waking every worker for a shared listener.
+    bool add(int fd, unsigned interest, bool exclusive = false);
+    bool modify(int fd, unsigned interest);
+    void remove(int fd);
+
+    // Wait up to timeoutMs for events; returns the number of events written to 'events'
+    int wait(std::vector<Event>& events, int timeoutMs);
+
+    // Interrupt a blocked wait() from another thread
+    void wakeup();
+
+private:
+#ifdef ALGO_USE_EPOLL
+    int epoll_fd;
+    int wake_fd;
+#else
+    std::vector<struct pollfd> fds;
+#ifndef _WIN32
+    int wake_pipe[2];
+#endif
+    std::atomic<bool> woken;
+#endif
+};
+
+#endif // POLLER_H
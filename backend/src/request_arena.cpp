@@ -0,0 +1,4 @@
+#include "request_arena.h"
+
+RequestArena::RequestArena()
+    : buffer(new char[BUFFER_BYTES]), arena(buffer.get(), BUFFER_BYTES, std::pmr::new_delete_resource()) {}
@@ -0,0 +1,35 @@
+#ifndef REQUEST_ARENA_H
+#define REQUEST_ARENA_H
+
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+
+// Memory for the temporaries of one request: the members of its parsed JSON
+// body, decoded strings and other scratch that is dead once the handler has
+// returned. Each worker thread owns one arena. Allocating is a pointer bump
+// into a buffer the arena keeps between requests, and release() frees
+// everything at once, so per-request parsing does not touch the heap unless
+// a request outgrows that buffer. Nothing that outlives the request (the
+// response, session or trace data) may be allocated here.
+class RequestArena {
+public:
+    RequestArena();
+
+    RequestArena(const RequestArena&) = delete;
+    RequestArena& operator=(const RequestArena&) = delete;
+
+    std::pmr::memory_resource* resource() { return &arena; }
+
+    // Drop everything allocated since the last release. Memory the arena had
+    // to take from the heap beyond its own buffer is returned.
+    void release() { arena.release(); }
+
+private:
+    static const size_t BUFFER_BYTES = 64 * 1024;
+
+    std::unique_ptr<char[]> buffer;
+    std::pmr::monotonic_buffer_resource arena;
+};
+
+#endif // REQUEST_ARENA_H
@@ -0,0 +1,167 @@
+#include "result_cache.h"
+#include <cstdio>
+#include <cstring>
+#include <random>
+
+// Charged for every entry on top of its body: list node, index slot, strings
+static const size_t ENTRY_OVERHEAD_BYTES = 160;
+
+static uint64_t rotateLeft(uint64_t x, int bits) {
+    return (x << bits) | (x >> (64 - bits));
+}
+
+static void sipRounds(uint64_t* v, int rounds) {
+    for (int i = 0; i < rounds; ++i) {
+        v[0] += v[1];
+        v[1] = rotateLeft(v[1], 13) ^ v[0];
+        v[0] = rotateLeft(v[0], 32);
+        v[2] += v[3];
+        v[3] = rotateLeft(v[3], 16) ^ v[2];
+        v[0] += v[3];
+        v[3] = rotateLeft(v[3], 21) ^ v[0];
+        v[2] += v[1];
+        v[1] = rotateLeft(v[1], 17) ^ v[2];
+        v[2] = rotateLeft(v[2], 32);
+    }
+}
+
+std::string ResultKey::etag() const {
+    char text[40];
+    std::snprintf(text, sizeof(text), "\"r2-%016llx%016llx\"", (unsigned long long)high, (unsigned long long)low);
+    return text;
+}
+
+HashKey randomHashKey() {
+    std::random_device device;
+    HashKey key;
+    key.k0 = (uint64_t(device()) << 32) | device();
+    key.k1 = (uint64_t(device()) << 32) | device();
+    return key;
+}
+
+ResultHasher::ResultHasher(const HashKey& key) : length(0) {
+    // SipHash's initial state; 0xee in v1 selects the 128-bit output
+    v[0] = key.k0 ^ 0x736f6d6570736575ULL;
+    v[1] = key.k1 ^ 0x646f72616e646f6dULL ^ 0xee;
+    v[2] = key.k0 ^ 0x6c7967656e657261ULL;
+    v[3] = key.k1 ^ 0x7465646279746573ULL;
+}
+
+void ResultHasher::mix(uint64_t word) {
+    v[3] ^= word;
+    sipRounds(v, 2);
+    v[0] ^= word;
+    length += 8;
+}
+
+void ResultHasher::add(std::string_view piece) {
+    mix(piece.size());
+    size_t i = 0;
+    for (; i + 8 <= piece.size(); i += 8) {
+        uint64_t word;
+        std::memcpy(&word, piece.data() + i, 8);
+        mix(word);
+    }
+    if (i < piece.size()) {
+        uint64_t word = 0;
+        std::memcpy(&word, piece.data() + i, piece.size() - i);
+        mix(word);
+    }
+}
+
+ResultKey ResultHasher::finish() const {
+    // The message is whole words, so the last block is only its length
+    uint64_t s[4] = {v[0], v[1], v[2], v[3]};
+    uint64_t last = length << 56;
+    s[3] ^= last;
+    sipRounds(s, 2);
+    s[0] ^= last;
+    ResultKey key;
+    s[2] ^= 0xee;
+    sipRounds(s, 4);
+    key.high = s[0] ^ s[1] ^ s[2] ^ s[3];
+    s[1] ^= 0xdd;
+    sipRounds(s, 4);
+    key.low = s[0] ^ s[1] ^ s[2] ^ s[3];
+    return key;
+}
+
+ResultCache::ResultCache(size_t capacityBytes)
+    : shardCapacity(capacityBytes / SHARD_COUNT), hits(0), misses(0), evictions(0) {}
+
+std::shared_ptr<const CachedResult> ResultCache::find(const ResultKey& key) {
+    Shard& shard = shardFor(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto it = shard.index.find(key);
+    if (it == shard.index.end()) {
+        misses.fetch_add(1, std::memory_order_relaxed);
+        return nullptr;
+    }
+    hits.fetch_add(1, std::memory_order_relaxed);
+    shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+    return it->second->result;
+}
+
+void ResultCache::insert(const ResultKey& key, std::shared_ptr<const CachedResult> result) {
+    size_t bytes =
+        result->body.size() + result->contentType.size() + result->contentEncoding.size() + ENTRY_OVERHEAD_BYTES;
+    if (bytes > maxEntryBytes()) return;
+
+    Shard& shard = shardFor(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto it = shard.index.find(key);
+    if (it != shard.index.end()) {
+        shard.bytes -= it->second->bytes;
+        shard.lru.erase(it->second);
+    }
+    shard.lru.push_front(Entry{key, std::move(result), bytes});
+    shard.index[key] = shard.lru.begin();
+    shard.bytes += bytes;
+    evict(shard);
+}
+
+void ResultCache::evict(Shard& shard) {
+    // A result still being sent stays alive through its shared_ptr
+    while (shard.bytes > shardCapacity && shard.lru.size() > 1) {
+        shard.bytes -= shard.lru.back().bytes;
+        shard.index.erase(shard.lru.back().key);
+        shard.lru.pop_back();
+        evictions.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+std::string ResultCache::renderPrometheus() const {
+    size_t entries = 0;
+    size_t bytes = 0;
+    for (const auto& shard : shards) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        entries += shard.lru.size();
+        bytes += shard.bytes;
+    }
+
+    char text[1280];
+    std::snprintf(text, sizeof(text),
+                  "# HELP algo_result_cache_hits_total Algorithm requests answered from the result cache.\n"
+                  "# TYPE algo_result_cache_hits_total counter\n"
+                  "algo_result_cache_hits_total %llu\n"
+                  "# HELP algo_result_cache_misses_total Cacheable algorithm requests that had to run.\n"
+                  "# TYPE algo_result_cache_misses_total counter\n"
+                  "algo_result_cache_misses_total %llu\n"
+                  "# HELP algo_result_cache_evictions_total Results dropped to stay within the capacity.\n"
+                  "# TYPE algo_result_cache_evictions_total counter\n"
+                  "algo_result_cache_evictions_total %llu\n"
+                  "# HELP algo_result_cache_entries Results held.\n"
+                  "# TYPE algo_result_cache_entries gauge\n"
+                  "algo_result_cache_entries %zu\n"
+                  "# HELP algo_result_cache_bytes Memory charged to the results held.\n"
+                  "# TYPE algo_result_cache_bytes gauge\n"
+                  "algo_result_cache_bytes %zu\n"
+                  "# HELP algo_result_cache_capacity_bytes Memory the result cache may use.\n"
+                  "# TYPE algo_result_cache_capacity_bytes gauge\n"
+                  "algo_result_cache_capacity_bytes %zu\n",
+                  (unsigned long long)hits.load(std::memory_order_relaxed),
+                  (unsigned long long)misses.load(std::memory_order_relaxed),
+                  (unsigned long long)evictions.load(std::memory_order_relaxed), entries, bytes,
+                  shardCapacity * SHARD_COUNT);
+    return text;
+}
@@ -0,0 +1,120 @@
+#ifndef RESULT_CACHE_H
+#define RESULT_CACHE_H
+
+#include <string>
+#include <string_view>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <cstdint>
+#include <unordered_map>
+
+// 128-bit keyed hash of a normalized request. Everything a response
+// depends on goes into the key, so equal keys mean equal responses and the
+// key itself serves as the response's ETag. Clients cannot see the hash
+// key, so they cannot craft two requests whose keys collide.
+struct ResultKey {
+    uint64_t high = 0;
+    uint64_t low = 0;
+
+    bool operator==(const ResultKey& other) const { return high == other.high && low == other.low; }
+
+    // Quoted ETag value, e.g. "\"r2-0123456789abcdef0123456789abcdef\""
+    std::string etag() const;
+};
+
+// Secret key of the hash behind ResultKey
+struct HashKey {
+    uint64_t k0 = 0;
+    uint64_t k1 = 0;
+};
+
+// A key drawn from std::random_device
+HashKey randomHashKey();
+
+// Builds a ResultKey from any number of pieces with SipHash-2-4, in its
+// 128-bit variant. Each piece is length-prefixed and padded to whole words,
+// so ("ab", "c") and ("a", "bc") hash differently.
+class ResultHasher {
+public:
+    explicit ResultHasher(const HashKey& key);
+
+    void add(std::string_view piece);
+
+    ResultKey finish() const;
+
+private:
+    void mix(uint64_t word);
+
+    uint64_t v[4];
+    uint64_t length; // Bytes of words mixed in
+};
+
+// A response body as it was first sent, compressed if it was, with what the
+// run reported for /api/metrics
+struct CachedResult {
+    std::string contentType;
+    std::string contentEncoding; // As sent, e.g. "gzip"; empty for none
+    std::string body;
+    std::string algorithm;
+    size_t steps = 0;
+};
+
+// Responses of deterministic algorithm runs by ResultKey. Like
+// SessionStore, entries are spread over shards with their own locks, each
+// evicting its least recently used entries once they pass its part of the
+// capacity. A body larger than a quarter of a shard is not kept, so one
+// huge trace cannot flush every preset out of its shard.
+class ResultCache {
+public:
+    // 0 turns the cache off
+    explicit ResultCache(size_t capacityBytes);
+
+    bool enabled() const { return shardCapacity > 0; }
+
+    // Largest body insert() keeps
+    size_t maxEntryBytes() const { return shardCapacity / 4; }
+
+    // The result stored under 'key', or nullptr; counts a hit or a miss
+    std::shared_ptr<const CachedResult> find(const ResultKey& key);
+
+    // Store a result, replacing any under the same key; may evict others
+    void insert(const ResultKey& key, std::shared_ptr<const CachedResult> result);
+
+    // Hits, misses, entries and bytes in the Prometheus text format
+    std::string renderPrometheus() const;
+
+private:
+    struct KeyHash {
+        size_t operator()(const ResultKey& key) const { return static_cast<size_t>(key.low); }
+    };
+
+    struct Entry {
+        ResultKey key;
+        std::shared_ptr<const CachedResult> result;
+        size_t bytes;
+    };
+    typedef std::list<Entry> LruList;
+
+    struct Shard {
+        mutable std::mutex mutex;
+        LruList lru; // Most recently used first
+        std::unordered_map<ResultKey, LruList::iterator, KeyHash> index;
+        size_t bytes = 0;
+    };
+
+    static const size_t SHARD_COUNT = 16;
+
+    Shard& shardFor(const ResultKey& key) { return shards[key.high % SHARD_COUNT]; }
+    void evict(Shard& shard);
+
+    Shard shards[SHARD_COUNT];
+    size_t shardCapacity;
+
+    std::atomic<uint64_t> hits;
+    std::atomic<uint64_t> misses;
+    std::atomic<uint64_t> evictions;
+};
+
+#endif // RESULT_CACHE_H
@@ -6,20 +6,1061 @@
 #include <vector>
 #include <algorithm>
 #include <iomanip>
+#include <mutex>
+#include <cstdlib>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <stdexcept>
+#include <type_traits>
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <ctime>
+#include <charconv>
+#include <string_view>
 
 // Algorithm headers
 #include "algorithms/sorting.h"
 #include "algorithms/searching.h"
 #include "algorithms/graph.h"
+#include "algorithms/tracer.h"
 #include "data_structures/tree.h"
 #include "data_structures/heap.h"
+#include "alloc_stats.h"
+#include "generators.h"
+#include "json.h"
 
-// CORS headers for all responses
-const std::string CORS_HEADERS = "Access-Control-Allow-Origin: *\r\n"
-                                "Access-Control-Allow-Methods: GET, POST, OPTIONS\r\n"
-                                "Access-Control-Allow-Headers: Content-Type\r\n";
+// Bytes read from one connection per readiness event, so a large upload
+// cannot starve the other connections on the same thread
+const size_t READ_BUDGET = 1 << 20;
 
-AlgoServer::AlgoServer(int port) : port(port), running(false) {
+// Size of each recv() into the connection input buffer
+const size_t READ_CHUNK = 64 * 1024;
+
+// Pipelined requests are not processed while this much response data is still unsent
+const size_t MAX_PENDING_OUTPUT = 4 << 20;
+
+// Streamed responses are sent in chunks of about this size
+const size_t STREAM_CHUNK = 64 * 1024;
+
+// Large buffered bodies are built in parts of about this size
+const size_t BODY_PART_BYTES = 1 << 20;
+
+// How long a streamed response waits on a client that stopped reading
+const int STREAM_WRITE_TIMEOUT_MS = 30000;
+
+// Largest input /api/sort/race accepts
+const size_t MAX_RACE_ELEMENTS = 10000000;
+
+// Time budget of a whole /api/sort/race, shared by its sorts: default and
+// upper bound. The sorts run one after another on a pool thread, which the
+// race holds for up to the budget.
+const int DEFAULT_RACE_BUDGET_MS = 6000;
+const int MAX_RACE_BUDGET_MS = 15000;
+
+// Largest input a trace session may be recorded for
+const size_t MAX_TRACE_ELEMENTS = 1000000;
+
+// Largest input /api/sort and /api/search take, sent or generated
+const size_t MAX_INPUT_ELEMENTS = 10000000;
+
+// Largest graph /api/graph generates: nodes, and adjacency list entries expected
+const size_t MAX_GENERATED_NODES = 1000000;
+const size_t MAX_GENERATED_ENTRIES = 20000000;
+
+// Trace sessions: default keyframe spacing, largest single trace, and the
+// most frames (or, for snapshot frames, array values) one window may return
+const size_t DEFAULT_KEYFRAME_INTERVAL = 1024;
+const size_t MAX_TRACE_BYTES = 256 * 1024 * 1024;
+const size_t MAX_TRACE_WINDOW = 10000;
+const size_t MAX_TRACE_WINDOW_VALUES = 4000000;
+
+// Data structure sessions are named by this cookie or by an X-Session-Id header
+const char* const SESSION_COOKIE = "algo_session";
+
+// Approximate memory held by one BST node, including its shared_ptr control block
+const size_t BST_NODE_BYTES = sizeof(TreeNode) + 32;
+
+// Route label in metrics and phase traces for paths no handler serves
+const std::string UNMATCHED_ROUTE = "unmatched";
+
+// Response bytes waiting to be sent. Heads and bodies stay the separate
+// buffers they were built in and go out together through socketSendv(), so a
+// large body is never copied to sit behind its head; a shared body is sent
+// from the cache that holds it. Small pieces are added to the last buffer
+// instead, keeping pipelined replies to a few slices.
+class OutputQueue {
+public:
+    void push(std::string data) {
+        if (data.empty()) return;
+        bytes += data.size();
+        if (!buffers.empty() && !buffers.back().shared.data && data.size() <= COALESCE_BYTES &&
+            buffers.back().text.size() <= COALESCE_BYTES) {
+            buffers.back().text += data;
+        } else {
+            buffers.push_back(Buffer{std::move(data), SharedBody()});
+        }
+    }
+
+    void push(const SharedBody& shared) {
+        if (shared.length <= COALESCE_BYTES) {
+            push(std::string(shared.data, shared.length));
+            return;
+        }
+        bytes += shared.length;
+        buffers.push_back(Buffer{std::string(), shared});
+    }
+
+    bool empty() const { return bytes == 0; }
+    size_t pending() const { return bytes; }
+
+    void clear() {
+        buffers.clear();
+        frontOffset = 0;
+        bytes = 0;
+    }
+
+    // Send as much as the socket accepts right now. False on a socket error;
+    // otherwise the queue is empty or the socket buffer is full.
+    bool send(int fd) {
+        while (!empty()) {
+            IoSlice slices[MAX_IO_SLICES];
+            size_t count = 0;
+            for (; count < buffers.size() && count < MAX_IO_SLICES; ++count) {
+                size_t skip = count == 0 ? frontOffset : 0;
+                slices[count] = IoSlice{buffers[count].data() + skip, buffers[count].size() - skip};
+            }
+
+            long sent = socketSendv(fd, slices, count);
+            if (sent > 0) {
+                consume(static_cast<size_t>(sent));
+                continue;
+            }
+            if (sent < 0 && socketInterrupted()) continue;
+            return sent < 0 && socketWouldBlock();
+        }
+        return true;
+    }
+
+private:
+    static const size_t COALESCE_BYTES = 16 * 1024;
+
+    // A string of its own, or bytes shared with a cache
+    struct Buffer {
+        std::string text;
+        SharedBody shared;
+
+        const char* data() const { return shared.data ? shared.data : text.data(); }
+        size_t size() const { return shared.data ? shared.length : text.size(); }
+    };
+
+    void consume(size_t sent) {
+        bytes -= sent;
+        while (sent > 0) {
+            size_t left = buffers.front().size() - frontOffset;
+            if (sent < left) {
+                frontOffset += sent;
+                return;
+            }
+            sent -= left;
+            buffers.pop_front();
+            frontOffset = 0;
+        }
+    }
+
+    std::deque<Buffer> buffers;
+    size_t frontOffset = 0; // Bytes of the first buffer already sent
+    size_t bytes = 0;       // Unsent bytes in all buffers
+};
+
+struct Connection {
+    int fd;
+    std::string input;
+    size_t inputStart = 0; // Bytes of 'input' already consumed by the parser
+    HttpRequestParser parser;
+    OutputQueue output;
+    size_t requestBytes = 0; // Received bytes of the request being parsed, for metrics
+    std::chrono::steady_clock::time_point requestStarted; // When its first byte was parsed
+    PhaseContext writePhase; // Request whose buffered response is being written, when phase tracing
+    std::chrono::steady_clock::time_point writeStarted;
+    bool closeAfterWrite = false;
+    bool peerClosed = false;
+    bool onPool = false; // A request is on the worker pool, which may write to the socket until it is done
+    std::chrono::steady_clock::time_point lastActivity;
+
+    Connection(int fd, const ServerConfig& config)
+        : fd(fd), parser(config.maxHeaderBytes, config.maxBodyBytes), lastActivity(std::chrono::steady_clock::now()) {}
+
+    bool hasPendingOutput() const { return !output.empty(); }
+};
+
+// A request of a compute route, from the event loop that parsed it to a
+// pool thread and back. While the pool has it, the event loop does not watch
+// the connection, so the pool thread can stream the response to the socket
+// itself; a buffered response is left here for the event loop to queue.
+struct AlgoServer::PooledRequest {
+    int fd;
+    HttpRequest request;
+    RouteMap::const_iterator route;
+    RequestMetrics metrics;
+    ThreadMetrics::RouteMetrics* routeMetrics;
+    std::chrono::steady_clock::time_point started; // When the event loop took the complete request
+    bool keepAlive;
+    double estimatedMs = 0;   // Predicted run time, by which the pool orders it
+    bool cacheable = false;   // Its route is cached and a result cache is on
+    ResultKey cacheKey;       // See requestResultKey()
+    ContentEncoding encoding = ContentEncoding::Identity; // Negotiated from its Accept-Encoding
+
+    HttpResponse response;    // Unless streamed
+    int status = 0;
+    bool streamed = false;
+    bool streamAborted = false;
+    size_t streamedBytes = 0;
+};
+
+struct WorkerContext {
+    RequestArena arena; // Temporaries of the request being handled
+    ThreadMetrics& metrics;
+    PhaseRing* phases; // Null while phase tracing is off
+    Poller& poller;
+
+    // Requests the pool is done with, for this thread to finish
+    std::mutex poolMutex;
+    std::vector<std::shared_ptr<AlgoServer::PooledRequest>> poolDone;
+
+    WorkerContext(ThreadMetrics& metrics, PhaseRing* phases, Poller& poller)
+        : metrics(metrics), phases(phases), poller(poller) {}
+};
+
+template <typename Trace, typename Array = std::vector<int>>
+using SortFunction = void (*)(Array, Trace&);
+
+template <typename Tracer>
+using SearchFunction = int (*)(const std::vector<int>&, int, Tracer&);
+
+template <typename Tracer>
+using GraphFunction = void (*)(const AdjacencyList&, int, Tracer&);
+
+// Look up a sorting algorithm by name; nullptr if unknown
+template <typename Trace, typename Array = std::vector<int>>
+static SortFunction<Trace, Array> findSort(const std::string& name) {
+    if (name == "bubble") return &bubbleSort<Trace, Array>;
+    if (name == "insertion") return &insertionSort<Trace, Array>;
+    if (name == "selection") return &selectionSort<Trace, Array>;
+    if (name == "merge") return &mergeSort<Trace, Array>;
+    if (name == "quick") return &quickSort<Trace, Array>;
+    if (name == "heap") return &heapSort<Trace, Array>;
+    return nullptr;
+}
+
+// Look up a searching algorithm by name; nullptr if unknown
+template <typename Tracer>
+static SearchFunction<Tracer> findSearch(const std::string& name) {
+    if (name == "linear") return &linearSearch<Tracer>;
+    if (name == "binary") return &binarySearch<Tracer>;
+    return nullptr;
+}
+
+// MST algorithms ignore the start node
+template <typename Tracer>
+static void runKruskal(const AdjacencyList& graph, int, Tracer& tracer) {
+    kruskalMST(graph, tracer);
+}
+
+template <typename Tracer>
+static void runPrim(const AdjacencyList& graph, int, Tracer& tracer) {
+    primMST(graph, tracer);
+}
+
+// Look up a graph algorithm by name; nullptr if unknown
+template <typename Tracer>
+static GraphFunction<Tracer> findGraphAlgorithm(const std::string& name) {
+    if (name == "bfs") return &breadthFirstSearch<Tracer>;
+    if (name == "dfs") return &depthFirstSearch<Tracer>;
+    if (name == "dijkstra") return &dijkstraAlgorithm<Tracer>;
+    if (name == "kruskal") return &runKruskal<Tracer>;
+    if (name == "prim") return &runPrim<Tracer>;
+    return nullptr;
+}
+
+// Parse an adjacency list "[[[to,weight],...],...]": one list per node, each
+// edge a [to, weight] pair (weight defaults to 1). The edges are collected in
+// the request arena first, so that every node's list is allocated once at its
+// final size.
+static AdjacencyList parseGraph(std::string_view graphStr, std::pmr::memory_resource* arena) {
+    struct ParsedEdge {
+        int node;
+        int target;
+        int weight;
+    };
+    std::pmr::vector<ParsedEdge> edges(arena);
+    std::pmr::vector<int> edge(arena);
+    int nodes = 0;
+    int depth = 0;
+    for (size_t i = 0; i < graphStr.size(); ++i) {
+        char c = graphStr[i];
+        if (c == '[') {
+            depth++;
+            if (depth == 2) nodes++;
+            if (depth == 3) edge.clear();
+        } else if (c == ']') {
+            if (depth == 3) {
+                if (edge.empty()) throw std::invalid_argument("Empty edge in graph");
+                edges.push_back({nodes - 1, edge[0], edge.size() > 1 ? edge[1] : 1});
+            }
+            depth--;
+        } else if (depth == 3 && (std::isdigit(static_cast<unsigned char>(c)) || c == '-')) {
+            int value;
+            auto result = std::from_chars(graphStr.data() + i, graphStr.data() + graphStr.size(), value);
+            if (result.ec != std::errc()) throw std::invalid_argument("Invalid number in graph");
+            edge.push_back(value);
+            i = result.ptr - graphStr.data() - 1;
+        }
+    }
+
+    for (const auto& e : edges) {
+        if (e.target < 0 || e.target >= nodes) {
+            throw std::invalid_argument("Edge target out of range: " + std::to_string(e.target));
+        }
+    }
+
+    std::pmr::vector<size_t> degree(nodes, 0, arena);
+    for (const auto& e : edges) degree[e.node]++;
+    AdjacencyList graph(nodes);
+    for (int u = 0; u < nodes; ++u) graph[u].reserve(degree[u]);
+    for (const auto& e : edges) graph[e.node].push_back({e.target, e.weight});
+    return graph;
+}
+
+// Result of one algorithm in a /api/sort/race run
+struct RaceResult {
+    std::string algorithm;
+    bool completed = false;
+    std::string error;     // Set when the run failed for a reason other than its budget
+    CountingTracer counts; // Operations performed, up to completion or the cutoff
+    double budgetMs = 0;   // This sort's share of the race's budget
+    double wallMs = 0;
+    double cpuMs = 0;
+    int64_t peakBytes = 0; // Memory the sort allocated, its working copy of the input included
+};
+
+// CPU time consumed so far by the calling thread, in milliseconds
+static double threadCpuMs() {
+#ifdef _WIN32
+    FILETIME creation, exit, kernel, user;
+    if (!GetThreadTimes(GetCurrentThread(), &creation, &exit, &kernel, &user)) return 0;
+    ULARGE_INTEGER k, u;
+    k.LowPart = kernel.dwLowDateTime;
+    k.HighPart = kernel.dwHighDateTime;
+    u.LowPart = user.dwLowDateTime;
+    u.HighPart = user.dwHighDateTime;
+    return static_cast<double>(k.QuadPart + u.QuadPart) / 10000.0;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+#endif
+}
+
+// Runs every named sort on 'input' without producing frames, all of them
+// within 'budgetMs'. They run one after another on the calling pool thread,
+// which the request already holds, rather than on threads of their own that
+// would compete with the pool. Each is cut off at an equal share of the time
+// left, so what a sort that finishes early leaves over goes to the ones
+// after it. Each sorts a copy allocated from a CountingResource of its own,
+// which its scratch space also comes from.
+static std::vector<RaceResult> runSortRace(const std::vector<int>& input, const std::vector<std::string>& algorithms,
+                                           int budgetMs) {
+    std::vector<RaceResult> results(algorithms.size());
+    auto raceEnd = std::chrono::steady_clock::now() + std::chrono::milliseconds(budgetMs);
+    for (size_t i = 0; i < algorithms.size(); ++i) {
+        RaceResult& result = results[i];
+        result.algorithm = algorithms[i];
+        auto sort = findSort<BudgetTracer, std::pmr::vector<int>>(algorithms[i]);
+
+        CountingResource memory;
+        double cpuStart = threadCpuMs();
+        auto start = std::chrono::steady_clock::now();
+        auto share = std::max(raceEnd - start, std::chrono::steady_clock::duration::zero()) /
+                     static_cast<int>(algorithms.size() - i);
+        result.budgetMs = std::chrono::duration<double, std::milli>(share).count();
+        BudgetTracer tracer(start + share);
+        try {
+            sort(std::pmr::vector<int>(input.begin(), input.end(), &memory), tracer);
+            result.completed = true;
+        } catch (const TraceBudgetExceeded&) {
+            // Cut off; the counts so far are still reported
+        } catch (const std::exception& e) {
+            result.error = e.what();
+        }
+        result.wallMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        result.cpuMs = threadCpuMs() - cpuStart;
+        result.counts = tracer;
+        result.peakBytes = memory.stats().peakBytes;
+    }
+    return results;
+}
+
+// Array generator spec of a "generate" field (see ArraySpec), e.g.
+// {"distribution":"nearly-sorted","size":1000000,"seed":42,"swaps":100}
+static ArraySpec parseArraySpec(std::string_view specStr, std::pmr::memory_resource* arena) {
+    JsonObject spec = parseJson(specStr, arena);
+    ArraySpec parsed;
+    if (!spec["distribution"].empty()) parsed.distribution = std::string(spec["distribution"]);
+    if (!spec["size"].empty()) parsed.size = parseNumber<size_t>(spec["size"]);
+    if (!spec["seed"].empty()) parsed.seed = parseNumber<uint64_t>(spec["seed"]);
+    if (!spec["swaps"].empty()) parsed.swaps = parseNumber<size_t>(spec["swaps"]);
+    if (!spec["unique"].empty()) parsed.unique = parseNumber<size_t>(spec["unique"]);
+    // Both cost time or memory apart from the size, so neither may exceed it
+    if (parsed.swaps > parsed.size) {
+        throw std::invalid_argument("\"swaps\" may not exceed \"size\"");
+    }
+    if (parsed.unique > std::max<size_t>(parsed.size, 1)) {
+        throw std::invalid_argument("\"unique\" may not exceed \"size\"");
+    }
+    return parsed;
+}
+
+// Graph generator spec of a "generate" field (see GraphSpec), e.g.
+// {"model":"rmat","nodes":100000,"degree":8,"seed":7}
+static GraphSpec parseGraphSpec(std::string_view specStr, std::pmr::memory_resource* arena) {
+    JsonObject spec = parseJson(specStr, arena);
+    GraphSpec parsed;
+    if (!spec["model"].empty()) parsed.model = std::string(spec["model"]);
+    if (!spec["nodes"].empty()) parsed.nodes = parseNumber<size_t>(spec["nodes"]);
+    if (!spec["degree"].empty()) parsed.degree = parseNumber<double>(spec["degree"]);
+    if (!spec["rows"].empty()) parsed.rows = parseNumber<size_t>(spec["rows"]);
+    if (!spec["maxWeight"].empty()) parsed.maxWeight = parseNumber<int>(spec["maxWeight"]);
+    if (!spec["seed"].empty()) parsed.seed = parseNumber<uint64_t>(spec["seed"]);
+    return parsed;
+}
+
+// Input array of a request: the "array" field, or generated from the seeded
+// spec in "generate" without a JSON array ever being written or parsed
+static std::vector<int> requestArray(const JsonObject& params, size_t maxElements, std::pmr::memory_resource* arena) {
+    std::vector<int> array;
+    if (!params["generate"].empty()) {
+        ArraySpec spec = parseArraySpec(params["generate"], arena);
+        if (spec.size > maxElements) {
+            throw std::invalid_argument("Input is limited to " + std::to_string(maxElements) + " elements");
+        }
+        array = generateArray(spec);
+    } else {
+        array = parseIntArray(params["array"]);
+    }
+    if (array.size() > maxElements) {
+        throw std::invalid_argument("Input is limited to " + std::to_string(maxElements) + " elements");
+    }
+    return array;
+}
+
+// Input graph of a request: the adjacency lists in "graph", or generated
+// from the seeded spec in "generate"
+static AdjacencyList requestGraph(const JsonObject& params, std::pmr::memory_resource* arena) {
+    if (params["generate"].empty()) {
+        return parseGraph(params["graph"], arena);
+    }
+    GraphSpec spec = parseGraphSpec(params["generate"], arena);
+    if (spec.nodes > MAX_GENERATED_NODES || expectedGraphEntries(spec) > MAX_GENERATED_ENTRIES) {
+        throw std::invalid_argument("Generated graphs are limited to " + std::to_string(MAX_GENERATED_NODES) +
+                                    " nodes and " + std::to_string(MAX_GENERATED_ENTRIES / 2) + " edges");
+    }
+    return generateGraph(spec);
+}
+
+// Extract the quoted names from an array string such as ["merge", "quick"]
+static std::vector<std::string> parseNameList(std::string_view listStr) {
+    std::vector<std::string> names;
+    size_t pos = 0;
+    while ((pos = listStr.find('"', pos)) != std::string::npos) {
+        size_t end = listStr.find('"', pos + 1);
+        if (end == std::string::npos) break;
+        names.emplace_back(listStr.substr(pos + 1, end - pos - 1));
+        pos = end + 1;
+    }
+    return names;
+}
+
+// Sorts a /api/sort/race request runs: its "algorithms", or all of them
+static std::vector<std::string> raceAlgorithms(const JsonObject& params) {
+    std::vector<std::string> algorithms = parseNameList(params["algorithms"]);
+    if (algorithms.empty()) {
+        algorithms = {"bubble", "insertion", "selection", "merge", "quick", "heap"};
+    }
+    return algorithms;
+}
+
+// Time budget of a whole /api/sort/race request
+static int raceBudgetMs(const JsonObject& params) {
+    int budgetMs = params["budgetMs"].empty() ? DEFAULT_RACE_BUDGET_MS : parseNumber<int>(params["budgetMs"]);
+    return std::max(1, std::min(budgetMs, MAX_RACE_BUDGET_MS));
+}
+
+// Memory a data structure session holds, as charged against its limit
+static size_t sessionBytes(const DataStructureSession& session) {
+    return bstNodeCount(session.bstRoot) * BST_NODE_BYTES + session.heap.capacity() * sizeof(int);
+}
+
+// Join collected frames into a JSON array
+static std::string stepsToJson(const std::vector<std::string>& steps) {
+    std::ostringstream stepsJson;
+    stepsJson << "[";
+    for (size_t i = 0; i < steps.size(); ++i) {
+        if (i > 0) stepsJson << ",";
+        stepsJson << steps[i];
+    }
+    stepsJson << "]";
+    return stepsJson.str();
+}
+
+// Clients opt into streamed frames with "Accept: application/x-ndjson";
+// HTTP/1.0 has no chunked coding, so it always gets the buffered form
+static bool wantsStream(const HttpRequest& request) {
+    return request.version != "HTTP/1.0" &&
+           request.header("accept").find("application/x-ndjson") != std::string::npos;
+}
+
+// Media type of binary traces (see binary_trace.h)
+const char* const BINARY_TRACE_TYPE = "application/x-algo-trace";
+
+// Clients opt into binary traces with "Accept: application/x-algo-trace";
+// everyone else, and requests binary cannot encode, get JSON
+static bool wantsBinaryTrace(const HttpRequest& request) {
+    return request.header("accept").find(BINARY_TRACE_TYPE) != std::string::npos;
+}
+
+// Key of a request to a cached route: the route, the representation and
+// content coding the client asked for and every member of the body, sorted
+// by name. Array and object values have the whitespace between their
+// tokens removed; strings, at the top level or inside them, are hashed
+// byte for byte.
+// Requests differing only in member order or spacing share a key, and with
+// it their response and its ETag.
+static ResultKey requestResultKey(const HashKey& hashKey, const std::string& route, const HttpRequest& request,
+                                  ContentEncoding encoding, const JsonObject& params,
+                                  std::pmr::memory_resource* arena) {
+    std::pmr::vector<std::pair<std::string_view, std::string_view>> members(params.begin(), params.end(), arena);
+    std::stable_sort(members.begin(), members.end(),
+                     [](const auto& a, const auto& b) { return a.first < b.first; });
+
+    ResultHasher hasher(hashKey);
+    hasher.add(route);
+    hasher.add(wantsBinaryTrace(request) ? "binary" : "text");
+    hasher.add(wantsStream(request) ? "ndjson" : "json");
+    hasher.add(contentEncodingName(encoding));
+    std::pmr::string compact(arena);
+    for (const auto& member : members) {
+        std::string_view value = member.second;
+        if (value.empty() || (value[0] != '[' && value[0] != '{')) {
+            hasher.add(member.first);
+            hasher.add(value);
+            continue;
+        }
+        compact.clear();
+        bool inString = false;
+        bool escaped = false;
+        for (char c : value) {
+            if (inString) {
+                if (escaped) escaped = false;
+                else if (c == '\\') escaped = true;
+                else if (c == '"') inString = false;
+            } else if (c == '"') {
+                inString = true;
+            } else if (c == ' ' || c == '\t' || c == '\n' || c == '\r') {
+                continue;
+            }
+            compact += c;
+        }
+        hasher.add(member.first);
+        hasher.add(compact);
+    }
+    return hasher.finish();
+}
+
+// Whether an If-None-Match header lists 'etag', weak or strong, or is "*"
+static bool etagMatches(const std::string& ifNoneMatch, const std::string& etag) {
+    return ifNoneMatch == "*" || ifNoneMatch.find(etag) != std::string::npos;
+}
+
+// Label the request's metrics with the algorithm it runs. Only names that
+// were found to be valid are passed, so the label values stay bounded.
+static void tagAlgorithm(const HttpRequest& request, const std::string& algorithm) {
+    if (request.metrics) request.metrics->algorithm = algorithm;
+}
+
+// Where a handler records the phases of its request (see phase_trace.h)
+static PhaseContext requestPhases(const HttpRequest& request) {
+    return request.metrics ? request.metrics->phases : PhaseContext();
+}
+
+// "args" members for the algorithm phase of a traced run. Whatever part of
+// the phase is not rendering or sinking frames was the algorithm itself.
+static std::string frameTimesArgs(const FrameTimes& times, const char* sinkName) {
+    auto us = [](std::chrono::steady_clock::duration d) {
+        return std::to_string(std::chrono::duration_cast<std::chrono::microseconds>(d).count());
+    };
+    return "\"frames\":" + std::to_string(times.frames) + ",\"render_us\":" + us(times.render) + ",\"" + sinkName +
+           "\":" + us(times.sink);
+}
+
+// Step sink that writes every frame as one NDJSON line as soon as it is produced
+class NdjsonStepWriter {
+public:
+    explicit NdjsonStepWriter(ResponseStream& out) : out(out), count(0) {}
+
+    void push_back(const std::string& step) {
+        out.write(step);
+        out.write("\n", 1);
+        ++count;
+    }
+
+    size_t size() const { return count; }
+
+    // Trailing summary line; 'extraFields' starts with a comma when present
+    void finish(const std::string& extraFields) {
+        out.write("{\"done\":true,\"steps\":" + std::to_string(count) + extraFields + "}\n");
+    }
+
+private:
+    ResponseStream& out;
+    size_t count;
+};
+
+// Append to the body parts of a response. Parts are filled to about
+// BODY_PART_BYTES and never regrown, so a large body is built without
+// reallocating and is sent from where it was built.
+static void appendBodyPart(std::vector<std::string>& parts, const char* data, size_t length) {
+    if (parts.empty() || parts.back().size() + length > parts.back().capacity()) {
+        parts.emplace_back();
+        parts.back().reserve(std::max(BODY_PART_BYTES, length));
+    }
+    parts.back().append(data, length);
+}
+
+// Step sink that appends every frame to a JSON array in the body parts of a
+// response (see appendBodyPart)
+class JsonArrayStepWriter {
+public:
+    explicit JsonArrayStepWriter(std::vector<std::string>& parts) : parts(parts), count(0) {
+        append("[", 1);
+    }
+
+    void push_back(const std::string& step) {
+        if (count++ > 0) append(",", 1);
+        append(step.data(), step.size());
+    }
+
+    size_t size() const { return count; }
+
+    // Close the array followed by 'tail'
+    void finish(const std::string& tail) {
+        append("]", 1);
+        append(tail.data(), tail.size());
+    }
+
+private:
+    void append(const char* data, size_t length) { appendBodyPart(parts, data, length); }
+
+    std::vector<std::string>& parts;
+    size_t count;
+};
+
+// Step sink that appends binary trace records back to back in the body
+// parts of a response
+class BinaryStepWriter {
+public:
+    explicit BinaryStepWriter(std::vector<std::string>& parts) : parts(parts), count(0) {}
+
+    void push_back(const std::string& step) {
+        appendBodyPart(parts, step.data(), step.size());
+        ++count;
+    }
+
+    size_t size() const { return count; }
+
+    void finish(const std::string& tail) { appendBodyPart(parts, tail.data(), tail.size()); }
+
+private:
+    std::vector<std::string>& parts;
+    size_t count;
+};
+
+// Frame format of the "trace" and "resolution" request fields (see
+// TraceOptions), in the binary encoding if 'binary' and it can express them
+static TraceOptions requestTraceOptions(const JsonObject& params, bool allowResolution, bool binary) {
+    TraceOptions options;
+    std::string_view format = params["trace"];
+    if (format == "delta") {
+        options.delta = true;
+    } else if (!format.empty() && format != "snapshot") {
+        throw std::invalid_argument("Unknown trace format: " + std::string(format));
+    }
+
+    if (!params["resolution"].empty()) {
+        if (!allowResolution) throw std::invalid_argument("resolution is not supported here");
+        long long resolution = parseNumber<long long>(params["resolution"]);
+        if (resolution <= 0) throw std::invalid_argument("resolution must be positive");
+        if (options.delta) throw std::invalid_argument("resolution applies to snapshot traces only");
+        options.resolution = static_cast<size_t>(resolution);
+    }
+    options.binary = binary && options.resolution == 0;
+    return options;
+}
+
+// Elements of a request's input, counted rather than parsed: the values in
+// "array", or the size of its "generate" spec (see requestArray)
+static size_t requestArraySize(const JsonObject& params, std::pmr::memory_resource* arena) {
+    if (!params["generate"].empty()) {
+        return parseArraySpec(params["generate"], arena).size;
+    }
+    std::string_view array = params["array"];
+    if (array.find_first_of("0123456789") == std::string_view::npos) return 0;
+    return std::count(array.begin(), array.end(), ',') + 1;
+}
+
+// Order of a request's input, for estimateSortCost(): the distribution of
+// its "generate" spec, or whether the values in its "array" mostly rise or
+// fall from one to the next, scanned rather than parsed into a vector
+static InputShape requestInputShape(const JsonObject& params, std::pmr::memory_resource* arena) {
+    InputShape shape;
+    if (!params["generate"].empty()) {
+        ArraySpec spec = parseArraySpec(params["generate"], arena);
+        if (spec.distribution == "sorted") {
+            shape.order = InputOrder::Sorted;
+        } else if (spec.distribution == "reversed") {
+            shape.order = InputOrder::Reversed;
+        } else if (spec.distribution == "organ-pipe") {
+            shape.order = InputOrder::OrganPipe;
+        } else if (spec.distribution == "nearly-sorted") {
+            // Defaults as in generateArray()
+            shape.order = InputOrder::NearlySorted;
+            shape.swaps = spec.swaps > 0 ? spec.swaps : std::max<size_t>(1, spec.size / 100);
+        } else if (spec.distribution == "few-unique") {
+            shape.order = InputOrder::FewUnique;
+            shape.unique = spec.unique > 0 ? spec.unique : 10;
+        }
+        return shape;
+    }
+
+    std::string_view array = params["array"];
+    const char* end = array.data() + array.size();
+    size_t values = 0, rises = 0, falls = 0;
+    long long previous = 0;
+    for (const char* p = array.data(); p < end;) {
+        if (!std::isdigit(static_cast<unsigned char>(*p)) && *p != '-') {
+            ++p;
+            continue;
+        }
+        long long value;
+        auto result = std::from_chars(p, end, value);
+        if (result.ec != std::errc()) break;
+        if (values++ > 0) {
+            if (value > previous) ++rises;
+            if (value < previous) ++falls;
+        }
+        previous = value;
+        p = result.ptr;
+    }
+    if (values < 2) return shape;
+    if (rises == 0 && falls == 0) {
+        shape.order = InputOrder::FewUnique;
+        shape.unique = 1;
+    } else if (falls == 0) {
+        shape.order = InputOrder::Sorted;
+    } else if (rises * 100 <= falls) {
+        shape.order = InputOrder::Reversed;
+    } else if (falls * 100 <= rises) {
+        shape.order = InputOrder::NearlySorted;
+        shape.swaps = falls;
+    }
+    return shape;
+}
+
+// Nodes and adjacency list entries of a "graph", counted rather than parsed
+// (see parseGraph)
+static void countGraph(std::string_view graphStr, size_t& nodes, size_t& edges) {
+    nodes = 0;
+    edges = 0;
+    int depth = 0;
+    for (char c : graphStr) {
+        if (c == '[') {
+            depth++;
+            if (depth == 2) nodes++;
+            if (depth == 3) edges++;
+        } else if (c == ']') {
+            depth--;
+        }
+    }
+}
+
+// Predicted cost of a request to one of the algorithm routes (see
+// cost_model.h), from its algorithm and the size and, for sorts, order of
+// its input. The input is scanned, not parsed, so the event loop can afford
+// this before it hands the request to the pool. With 'described', as for /api/estimate,
+// "size", or "nodes" and "edges", may stand in for the input. False when
+// the request names no algorithm the route knows, for its handler to report.
+// 'binary' is whether the client asked for binary traces.
+static bool estimateRequest(const std::string& route, const JsonObject& params, bool described, bool binary,
+                            std::pmr::memory_resource* arena, CostEstimate& cost) {
+    std::string algorithm(params["algorithm"]);
+    if (route == "/api/graph") {
+        size_t nodes, edges;
+        if (described && !params["nodes"].empty()) {
+            nodes = parseNumber<size_t>(params["nodes"]);
+            edges = params["edges"].empty() ? 0 : parseNumber<size_t>(params["edges"]);
+        } else if (!params["generate"].empty()) {
+            GraphSpec spec = parseGraphSpec(params["generate"], arena);
+            nodes = spec.nodes;
+            edges = expectedGraphEntries(spec);
+        } else {
+            countGraph(params["graph"], nodes, edges);
+        }
+        return estimateGraphCost(algorithm, nodes, edges, requestTraceOptions(params, false, binary), cost);
+    }
+
+    size_t size = described && !params["size"].empty() ? parseNumber<size_t>(params["size"])
+                                                        : requestArraySize(params, arena);
+    InputShape shape = route == "/api/search" ? InputShape() : requestInputShape(params, arena);
+    bool known = false;
+    if (route == "/api/sort") {
+        known = estimateSortCost(algorithm, size, shape, requestTraceOptions(params, true, binary), cost);
+    } else if (route == "/api/search") {
+        known = estimateSearchCost(algorithm, size, requestTraceOptions(params, true, binary), cost);
+    } else if (route == "/api/trace") {
+        // Recorded as operations about the size of delta frames
+        TraceOptions recorded;
+        recorded.delta = true;
+        known = estimateSortCost(algorithm, size, shape, recorded, cost);
+    } else if (route == "/api/sort/race") {
+        // Each sort only counts its frames, and the race stops at its time
+        // budget
+        known = true;
+        for (const auto& name : raceAlgorithms(params)) {
+            CostEstimate sort;
+            if (!estimateSortCost(name, size, shape, TraceOptions(), sort)) return false;
+            cost.frames += sort.frames;
+            cost.millis += sort.frames * COST_NANOS_PER_COUNTED_FRAME / 1e6;
+        }
+        cost.millis = std::min(cost.millis, static_cast<double>(raceBudgetMs(params)));
+    }
+
+    // A generated input is built before the algorithm runs, swaps included
+    if (known && !params["generate"].empty()) {
+        ArraySpec spec = parseArraySpec(params["generate"], arena);
+        cost.millis += (spec.size + spec.swaps) * COST_NANOS_PER_GENERATED_VALUE / 1e6;
+    }
+    return known;
+}
+
+// Runs an algorithm under the tracer for the requested frame format and wraps
+// the frames in a response: a binary trace when the options call for one,
+// NDJSON streamed while the frames are produced when the client accepts it,
+// otherwise a single JSON document. 'run' is called with the tracer and
+// returns extra summary fields (starting with a comma, or empty); 'header'
+// is the binary trace header, or holds the fields that precede delta frames.
+template <typename Run>
+static HttpResponse tracedResponse(const HttpRequest& request, const TraceOptions& options,
+                                   const std::string& header, Run run) {
+    // Sends the frames to 'steps' through the tracer the options call for.
+    // With phase tracing on, the run is an "algorithm" phase that also tells
+    // how long went into rendering frames and into the sink, 'sinkName'.
+    PhaseContext phases = requestPhases(request);
+    auto produce = [options, run, phases](auto& steps, const char* sinkName) {
+        typedef std::decay_t<decltype(steps)> StepSink;
+        FrameTimes times;
+        ScopedPhase phase(phases, "algorithm");
+        auto timedRun = [&](auto& tracer) {
+            if (phases.ring) tracer.setFrameTimes(&times);
+            std::string extraFields = run(tracer);
+            if (phases.ring) phase.end(frameTimesArgs(times, sinkName));
+            return extraFields;
+        };
+        if (options.binary) {
+            BinaryTracer<StepSink> tracer(steps);
+            return timedRun(tracer);
+        }
+        if (options.delta) {
+            DeltaTracer<StepSink> tracer(steps);
+            return timedRun(tracer);
+        }
+        if (options.resolution > 0) {
+            BucketTracer<StepSink> tracer(steps, options.resolution);
+            return timedRun(tracer);
+        }
+        JsonTracer<StepSink> tracer(steps);
+        return timedRun(tracer);
+    };
+
+    HttpResponse response;
+    if (options.binary) {
+        // A few bytes per frame: buffered, where NDJSON would be streamed
+        response.contentType = BINARY_TRACE_TYPE;
+        response.body = header;
+        BinaryStepWriter steps(response.bodyParts);
+        std::string extraFields = produce(steps, "concat_us");
+        steps.finish(binaryTraceEnd(steps.size(), extraFields));
+        if (request.metrics) request.metrics->steps = steps.size();
+        return response;
+    }
+
+    if (wantsStream(request)) {
+        response.contentType = "application/x-ndjson";
+        RequestMetrics* metrics = request.metrics;
+        response.producer = [options, header, produce, metrics](ResponseStream& out) {
+            if (options.delta) {
+                out.write("{\"format\":\"delta\"," + header + "}\n");
+            }
+            NdjsonStepWriter steps(out);
+            steps.finish(produce(steps, "write_us"));
+            if (metrics) metrics->steps = steps.size();
+        };
+        return response;
+    }
+
+    response.body = options.delta ? "{\"format\":\"delta\"," + header + ",\"ops\":" : "{\"steps\":";
+    JsonArrayStepWriter steps(response.bodyParts);
+    std::string extraFields = produce(steps, "concat_us");
+    steps.finish(extraFields + "}");
+    if (request.metrics) request.metrics->steps = steps.size();
+    return response;
+}
+
+// Thrown out of a producer when the client can no longer be written to
+struct StreamAborted {};
+
+// Sends a produced body in chunked transfer coding. Small writes are
+// collected into chunks of about STREAM_CHUNK bytes; a write that fills the
+// chunk goes out as part of it straight from the caller's buffer. When the
+// socket buffer is full the producer waits for the client, so memory stays
+// bounded by one chunk.
+class SocketChunkStream : public ResponseStream {
+public:
+    explicit SocketChunkStream(int fd) : fd(fd), sent(0) {
+        buffer.reserve(STREAM_CHUNK);
+    }
+
+    // Bytes written to the socket so far, chunk framing included
+    size_t bytesSent() const { return sent; }
+
+    void write(const char* data, size_t length) override {
+        if (buffer.size() + length < STREAM_CHUNK) {
+            buffer.append(data, length);
+        } else {
+            sendChunk(data, length);
+        }
+    }
+
+    void flush() override {
+        if (!buffer.empty()) sendChunk(nullptr, 0);
+    }
+
+    // Send the last chunk and the terminating zero-length chunk
+    void finish() {
+        flush();
+        IoSlice last = {"0\r\n\r\n", 5};
+        sendAll(&last, 1);
+    }
+
+private:
+    // One chunk holding the buffered bytes followed by 'data'
+    void sendChunk(const char* data, size_t length) {
+        char size[24];
+        int n = std::snprintf(size, sizeof(size), "%zx\r\n", buffer.size() + length);
+        IoSlice slices[] = {
+            {size, static_cast<size_t>(n)}, {buffer.data(), buffer.size()}, {data, length}, {"\r\n", 2}};
+        sendAll(slices, 4);
+        buffer.clear();
+    }
+
+    void sendAll(IoSlice* slices, size_t count) {
+        while (count > 0) {
+            long written = socketSendv(fd, slices, count);
+            if (written > 0) {
+                // Drop the slices that went out and trim a partly sent one
+                size_t done = static_cast<size_t>(written);
+                sent += done;
+                while (count > 0 && done >= slices->length) {
+                    done -= slices->length;
+                    ++slices;
+                    --count;
+                }
+                if (count > 0) {
+                    slices->data += done;
+                    slices->length -= done;
+                }
+                continue;
+            }
+            if (written < 0 && socketInterrupted()) continue;
+            if (written < 0 && socketWouldBlock() && waitWritable(fd, STREAM_WRITE_TIMEOUT_MS)) continue;
+            throw StreamAborted();
+        }
+    }
+
+    int fd;
+    std::string buffer;
+    size_t sent;
+};
+
+// Sends everything in 'queued', which ends with the response head, then the
+// body as the response's producer writes it, waiting on the client whenever
+// its socket buffer is full. False if the client went away or the producer
+// failed mid-body. 'bodyBytes' is set to the bytes of the body sent, chunk
+// framing included.
+static bool streamResponse(int fd, OutputQueue& queued, const HttpResponse& response, size_t& bodyBytes) {
+    SocketChunkStream stream(fd);
+    bool complete = true;
+    try {
+        while (!queued.empty()) {
+            if (!queued.send(fd)) throw StreamAborted();
+            if (!queued.empty() && !waitWritable(fd, STREAM_WRITE_TIMEOUT_MS)) throw StreamAborted();
+        }
+
+        response.producer(stream);
+        stream.finish();
+    } catch (...) {
+        complete = false;
+    }
+    bodyBytes = stream.bytesSent();
+    return complete;
+}
+
+// A streamed body copied for the result cache as it is sent; the copy is
+// dropped once it would pass 'limit' bytes
+struct CapturedBody {
+    std::string data;
+    size_t limit = 0;
+    bool overflowed = false;
+};
+
+// Passes a produced body on to 'out' while copying it into a CapturedBody
+class CapturingStream : public ResponseStream {
+public:
+    CapturingStream(ResponseStream& out, CapturedBody& copy) : out(out), copy(copy) {}
+
+    void write(const char* data, size_t length) override {
+        out.write(data, length);
+        if (copy.overflowed) return;
+        if (copy.data.size() + length > copy.limit) {
+            copy.overflowed = true;
+            std::string().swap(copy.data);
+            return;
+        }
+        copy.data.append(data, length);
+    }
+
+    void flush() override { out.flush(); }
+
+private:
+    ResponseStream& out;
+    CapturedBody& copy;
+};
+
+AlgoServer::AlgoServer(const ServerConfig& config)
+    : config(config), running(false), traces(config.traceStoreBytes),
+      sessions(config.sessionStoreBytes, config.sessionLimitBytes), phaseTracer(config.debugTraceEvents),
+      pool(config.poolThreads, config.poolQueueLimit, phaseTracer), results(config.resultCacheBytes),
+      diskResults(config.diskCacheDir, config.diskCacheBytes) {
 #ifdef _WIN32
     // Initialize Winsock
     WSADATA wsaData;
@@ -30,255 +1071,726 @@ AlgoServer::AlgoServer(int port) : port(port), running(false) {
     }
 #endif
 
-    // Create socket
-    if ((server_fd = socket(AF_INET, SOCK_STREAM, 0)) == 0) {
-        std::cerr << "Socket creation failed" << std::endl;
-        return;
+    // Create socket
+    if ((server_fd = socket(AF_INET, SOCK_STREAM, 0)) < 0) {
+        std::cerr << "Socket creation failed" << std::endl;
+        return;
+    }
+
+    // Set socket options
+    int opt = 1;
+#ifdef _WIN32
+    if (setsockopt(server_fd, SOL_SOCKET, SO_REUSEADDR, (const char*)&opt, sizeof(opt)) < 0) {
+#else
+    if (setsockopt(server_fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt)) < 0) {
+#endif
+        std::cerr << "Setsockopt failed" << std::endl;
+        return;
+    }
+
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = INADDR_ANY;
+    address.sin_port = htons(config.port);
+
+    // Bind socket
+    if (bind(server_fd, (struct sockaddr*)&address, sizeof(address)) < 0) {
+        std::cerr << "Bind failed" << std::endl;
+        return;
+    }
+
+    // Listen
+    if (listen(server_fd, SOMAXCONN) < 0) {
+        std::cerr << "Listen failed" << std::endl;
+        return;
+    }
+
+    // Every event loop thread accepts from the same non-blocking listener
+    setNonBlocking(server_fd);
+
+    // Initialize routes
+    initRoutes();
+}
+
+AlgoServer::~AlgoServer() {
+    stop();
+    closeSocket(server_fd);
+#ifdef _WIN32
+    WSACleanup();
+#endif
+}
+
+void AlgoServer::start() {
+    int threadCount = config.threads;
+    if (threadCount <= 0) {
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    running = true;
+    pool.start();
+    std::cout << "Server started on port " << config.port
+              << " with " << threadCount << " worker thread(s) and " << pool.size() << " algorithm thread(s)"
+              << std::endl;
+
+    for (int i = 0; i < threadCount; ++i) {
+        pollers.push_back(std::unique_ptr<Poller>(new Poller()));
+    }
+    for (int i = 0; i < threadCount; ++i) {
+        Poller* poller = pollers[i].get();
+        workers.emplace_back([this, poller]() { workerLoop(*poller); });
+    }
+
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    workers.clear();
+    pollers.clear();
+    pool.stop();
+}
+
+void AlgoServer::stop() {
+    // Requests already on the pool are finished first, so their event loops
+    // are still there to take them back
+    pool.stop();
+    running = false;
+    for (auto& poller : pollers) {
+        poller->wakeup();
+    }
+}
+
+void AlgoServer::workerLoop(Poller& poller) {
+    std::map<int, std::unique_ptr<Connection>> connections;
+    std::vector<Poller::Event> events;
+    WorkerContext worker(metrics.registerThread(), phaseTracer.registerThread("event loop"), poller);
+    std::vector<std::shared_ptr<PooledRequest>> poolDone;
+    auto lastSweep = std::chrono::steady_clock::now();
+
+    poller.add(server_fd, Poller::Readable, true);
+
+    auto closeConnection = [&](int fd) {
+        poller.remove(fd);
+        closeSocket(fd);
+        connections.erase(fd);
+    };
+
+    // Read, handle and write whatever the connection is ready for
+    auto serve = [&](Connection& conn, bool readable) {
+        bool keep = true;
+        if (readable) {
+            keep = readFromConnection(conn);
+        }
+        // Keep answering pipelined requests while the socket accepts the output
+        while (keep) {
+            bool progressed = processInput(conn, worker);
+            keep = flushConnection(conn);
+            if (conn.onPool || conn.hasPendingOutput()) break;
+            // A request held back until the output drained can go now
+            if (!progressed && conn.parser.status() != HttpRequestParser::Complete) break;
+        }
+
+        // The pool owns the socket until it hands the request back
+        if (conn.onPool) {
+            poller.remove(conn.fd);
+            return;
+        }
+
+        if (!keep) {
+            closeConnection(conn.fd);
+            return;
+        }
+
+        // Wait for writability only while a response is still queued
+        poller.modify(conn.fd, conn.hasPendingOutput() ? Poller::Writable : Poller::Readable);
+    };
+
+    while (running) {
+        poller.wait(events, 1000);
+        auto now = std::chrono::steady_clock::now();
+
+        for (const auto& event : events) {
+            if (event.fd == server_fd) {
+                acceptConnections(poller, connections);
+                continue;
+            }
+
+            auto it = connections.find(event.fd);
+            if (it == connections.end() || it->second->onPool) continue;
+            Connection& conn = *it->second;
+            conn.lastActivity = now;
+            serve(conn, event.readable || event.hangup);
+        }
+
+        // Requests the pool has finished: queue their responses and watch
+        // their connections again
+        {
+            std::lock_guard<std::mutex> lock(worker.poolMutex);
+            poolDone.swap(worker.poolDone);
+        }
+        for (auto& pooled : poolDone) {
+            Connection& conn = *connections[pooled->fd];
+            finishPooled(conn, worker, *pooled);
+            conn.lastActivity = now;
+            poller.add(conn.fd, Poller::Readable);
+            serve(conn, false);
+        }
+        poolDone.clear();
+
+        // Drop keep-alive connections that have been idle for too long
+        if (now - lastSweep >= std::chrono::seconds(1)) {
+            lastSweep = now;
+            auto idleLimit = std::chrono::seconds(config.idleTimeoutSec);
+            std::vector<int> idle;
+            for (const auto& entry : connections) {
+                const Connection& conn = *entry.second;
+                if (!conn.onPool && !conn.hasPendingOutput() && now - conn.lastActivity > idleLimit) {
+                    idle.push_back(entry.first);
+                }
+            }
+            for (int fd : idle) {
+                closeConnection(fd);
+            }
+        }
+    }
+
+    poller.remove(server_fd);
+    for (auto& entry : connections) {
+        poller.remove(entry.first);
+        closeSocket(entry.first);
+    }
+}
+
+void AlgoServer::acceptConnections(Poller& poller, std::map<int, std::unique_ptr<Connection>>& connections) {
+    while (running) {
+        int new_socket = static_cast<int>(accept(server_fd, nullptr, nullptr));
+        if (new_socket < 0) {
+            if (!socketWouldBlock() && !socketInterrupted()) {
+                std::cerr << "Accept failed" << std::endl;
+            }
+            return;
+        }
+
+        setNonBlocking(new_socket);
+        setNoDelay(new_socket);
+        if (!poller.add(new_socket, Poller::Readable)) {
+            closeSocket(new_socket);
+            continue;
+        }
+        connections[new_socket] = std::unique_ptr<Connection>(new Connection(new_socket, config));
+    }
+}
+
+bool AlgoServer::readFromConnection(Connection& conn) {
+    size_t budget = READ_BUDGET;
+    while (budget > 0 && conn.parser.status() == HttpRequestParser::NeedMore) {
+        long valread;
+        size_t wanted = conn.parser.bodyBytesWanted();
+        if (wanted > 0 && conn.inputStart == conn.input.size()) {
+            // Content-Length bodies are received straight into the request body
+            std::string& body = conn.parser.request().body;
+            size_t filled = body.size();
+            size_t chunk = std::min(wanted, budget);
+            body.resize(filled + chunk);
+            valread = socketRecv(conn.fd, &body[filled], chunk);
+            body.resize(filled + static_cast<size_t>(std::max(valread, 0L)));
+            if (valread > 0) {
+                conn.parser.bodyAppended(static_cast<size_t>(valread));
+                conn.requestBytes += static_cast<size_t>(valread);
+            }
+        } else {
+            size_t filled = conn.input.size();
+            conn.input.resize(filled + READ_CHUNK);
+            valread = socketRecv(conn.fd, &conn.input[filled], READ_CHUNK);
+            conn.input.resize(filled + static_cast<size_t>(std::max(valread, 0L)));
+            if (valread > 0) advanceParser(conn);
+        }
+
+        if (valread > 0) {
+            budget -= std::min(budget, static_cast<size_t>(valread));
+            continue;
+        }
+        if (valread == 0) {
+            conn.peerClosed = true;
+            return true;
+        }
+        if (socketInterrupted()) continue;
+        return socketWouldBlock();
+    }
+    return true;
+}
+
+void AlgoServer::advanceParser(Connection& conn) {
+    if (conn.inputStart < conn.input.size() && conn.parser.status() == HttpRequestParser::NeedMore) {
+        size_t used = conn.parser.feed(conn.input.data() + conn.inputStart, conn.input.size() - conn.inputStart);
+        if (conn.requestBytes == 0 && used > 0) conn.requestStarted = std::chrono::steady_clock::now();
+        conn.inputStart += used;
+        conn.requestBytes += used;
+    }
+
+    // Tell clients waiting on "Expect: 100-continue" to send the body
+    if (conn.parser.takeContinueRequest() && conn.parser.status() == HttpRequestParser::NeedMore) {
+        conn.output.push("HTTP/1.1 100 Continue\r\n\r\n");
+    }
+
+    // Reclaim consumed input without shifting bytes on every request
+    if (conn.inputStart == conn.input.size()) {
+        conn.input.clear();
+        conn.inputStart = 0;
+    } else if (conn.inputStart >= READ_CHUNK) {
+        conn.input.erase(0, conn.inputStart);
+        conn.inputStart = 0;
+    }
+}
+
+bool AlgoServer::processInput(Connection& conn, WorkerContext& worker) {
+    // Handle every complete request in the buffer, in order, so pipelined
+    // requests are answered in sequence on the same socket
+    bool progressed = false;
+    while (!conn.closeAfterWrite && !conn.onPool && conn.output.pending() < MAX_PENDING_OUTPUT) {
+        advanceParser(conn);
+
+        if (conn.parser.status() == HttpRequestParser::Failed) {
+            queueResponse(conn, errorResponse(conn.parser.errorMessage(), conn.parser.errorStatus()), false);
+            return true;
+        }
+        if (conn.parser.status() != HttpRequestParser::Complete) break;
+
+        // A pool thread may stream its response straight to the socket, so
+        // a request for the pool waits until the responses before it are sent
+        if (conn.hasPendingOutput() && runsOnPool(conn.parser.request(), findRoute(conn.parser.request().path))) {
+            break;
+        }
+
+        handleAndQueue(conn, worker);
+        conn.parser.reset();
+        progressed = true;
     }
 
-    // Set socket options
-    int opt = 1;
-#ifdef _WIN32
-    if (setsockopt(server_fd, SOL_SOCKET, SO_REUSEADDR, (const char*)&opt, sizeof(opt)) < 0) {
-#else
-    if (setsockopt(server_fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt)) < 0) {
-#endif
-        std::cerr << "Setsockopt failed" << std::endl;
-        return;
+    // A peer that closed its side gets the responses already queued, nothing more
+    if (conn.peerClosed) {
+        conn.closeAfterWrite = true;
     }
+    return progressed;
+}
 
-    address.sin_family = AF_INET;
-    address.sin_addr.s_addr = INADDR_ANY;
-    address.sin_port = htons(port);
+// Start the phases of a request that has just been read, when phase tracing
+static PhaseContext startPhases(WorkerContext& worker, const Connection& conn,
+                                std::chrono::steady_clock::time_point started) {
+    PhaseContext phases;
+    if (worker.phases) {
+        phases.ring = worker.phases;
+        phases.request = worker.phases->nextRequestId();
+        phases.ring->record("read", phases.request, conn.requestStarted, started);
+    }
+    return phases;
+}
 
-    // Bind socket
-    if (bind(server_fd, (struct sockaddr*)&address, sizeof(address)) < 0) {
-        std::cerr << "Bind failed" << std::endl;
+void AlgoServer::handleAndQueue(Connection& conn, WorkerContext& worker) {
+    HttpRequest& request = conn.parser.request();
+    RouteMap::const_iterator route = findRoute(request.path);
+    if (runsOnPool(request, route)) {
+        submitToPool(conn, worker, route);
         return;
     }
 
-    // Listen
-    if (listen(server_fd, 10) < 0) {
-        std::cerr << "Listen failed" << std::endl;
-        return;
+    RequestMetrics requestMetrics;
+    request.arena = worker.arena.resource();
+    request.metrics = &requestMetrics;
+
+    auto started = std::chrono::steady_clock::now();
+    auto& routeMetrics = worker.metrics.begin(routeLabel(route));
+    PhaseContext& phases = requestMetrics.phases;
+    phases = startPhases(worker, conn, started);
+
+    ScopedPhase handling(phases, "handle");
+    HttpResponse response = handleRequest(request, route);
+    encodeResponse(response, responseEncoding(request));
+    handling.end();
+
+    // Streamed responses run their algorithm here, while they are sent
+    ScopedPhase responding(phases, "respond");
+    int status = response.status;
+    size_t responseBytes = queueResponse(conn, std::move(response), request.keepAlive() && !conn.peerClosed);
+    responding.end();
+
+    finishRequest(conn, worker, route, routeMetrics, requestMetrics, started, status, responseBytes);
+    worker.arena.release();
+}
+
+void AlgoServer::finishRequest(Connection& conn, WorkerContext& worker, RouteMap::const_iterator route,
+                               ThreadMetrics::RouteMetrics& routeMetrics, const RequestMetrics& requestMetrics,
+                               std::chrono::steady_clock::time_point started, int status, size_t responseBytes) {
+    auto finished = std::chrono::steady_clock::now();
+    auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(finished - started);
+    worker.metrics.finish(routeMetrics, requestMetrics, status, conn.requestBytes, responseBytes, elapsed.count());
+
+    const PhaseContext& phases = requestMetrics.phases;
+    if (phases.ring) {
+        phases.ring->record("request", phases.request, conn.requestStarted, finished,
+                            "\"route\":\"" + escapeJson(routeLabel(route)) + "\",\"algorithm\":\"" +
+                                escapeJson(requestMetrics.algorithm) + "\",\"status\":" + std::to_string(status) +
+                                ",\"request_bytes\":" + std::to_string(conn.requestBytes) +
+                                ",\"response_bytes\":" + std::to_string(responseBytes));
+        // The rest of a buffered response is written as the socket takes it
+        if (conn.hasPendingOutput()) {
+            conn.writePhase = phases;
+            conn.writeStarted = finished;
+        }
     }
 
-    // Initialize routes
-    initRoutes();
+    conn.requestBytes = 0;
 }
 
-AlgoServer::~AlgoServer() {
-#ifdef _WIN32
-    closesocket(server_fd);
-    WSACleanup();
-#else
-    close(server_fd);
-#endif
+bool AlgoServer::runsOnPool(const HttpRequest& request, RouteMap::const_iterator route) const {
+    return route != routeHandlers.end() && route->second.compute && request.method == "POST";
 }
 
-void AlgoServer::start() {
-    running = true;
-    std::cout << "Server started on port " << port << std::endl;
+void AlgoServer::submitToPool(Connection& conn, WorkerContext& worker, RouteMap::const_iterator route) {
+    auto pooled = std::make_shared<PooledRequest>();
+    pooled->fd = conn.fd;
+    pooled->request = std::move(conn.parser.request());
+    pooled->route = route;
+    pooled->started = std::chrono::steady_clock::now();
+    pooled->routeMetrics = &worker.metrics.begin(routeLabel(route));
+    pooled->metrics.phases = startPhases(worker, conn, pooled->started);
+    pooled->keepAlive = pooled->request.keepAlive() && !conn.peerClosed;
+    pooled->encoding = responseEncoding(pooled->request);
 
-    while (running) {
-        int addrlen = sizeof(address);
-#ifdef _WIN32
-        int new_socket = accept(server_fd, (struct sockaddr*)&address, &addrlen);
-#else
-        int new_socket = accept(server_fd, (struct sockaddr*)&address, (socklen_t*)&addrlen);
-#endif
-        if (new_socket < 0) {
-            std::cerr << "Accept failed" << std::endl;
-            continue;
+    // Key the request for the result cache, and predict what it will cost,
+    // to queue it by its expected run time and to turn it away if that is
+    // over the limit. A body that cannot be parsed or estimated is queued as
+    // if cheap; its handler reports what is wrong.
+    CostEstimate cost;
+    bool estimated = false;
+    try {
+        JsonObject params = parseJson(pooled->request.body, worker.arena.resource());
+        if (route->second.cached && (results.enabled() || diskResults.enabled())) {
+            pooled->cacheKey = requestResultKey(diskResults.resultHashKey(), route->first, pooled->request,
+                                                pooled->encoding, params, worker.arena.resource());
+            pooled->cacheable = true;
         }
+        estimated = estimateRequest(routeLabel(route), params, false, wantsBinaryTrace(pooled->request),
+                                    worker.arena.resource(), cost);
+    } catch (const std::exception&) {
+    }
+    worker.arena.release();
+    pooled->estimatedMs = cost.millis;
 
-        // Read HTTP request
-        char buffer[30000] = {0};
-#ifdef _WIN32
-        int valread = recv(new_socket, buffer, 30000, 0);
-#else
-        int valread = read(new_socket, buffer, 30000);
-#endif
-        if (valread <= 0) {
-            std::cerr << "Read failed" << std::endl;
-#ifdef _WIN32
-            closesocket(new_socket);
-#else
-            close(new_socket);
-#endif
-            continue;
-        }
+    if (pooled->cacheable && answerFromCache(conn, worker, *pooled)) {
+        return;
+    }
 
-        // Parse HTTP request
-        std::string request(buffer);
-        size_t method_end = request.find(' ');
-        if (method_end == std::string::npos) {
-#ifdef _WIN32
-            closesocket(new_socket);
-#else
-            close(new_socket);
-#endif
-            continue;
-        }
+    if (estimated && config.maxEstimatedMs > 0 && cost.millis > config.maxEstimatedMs) {
+        std::ostringstream message;
+        message << std::fixed << std::setprecision(0) << "Request is estimated to take " << cost.millis
+                << " ms, over this server's limit of " << config.maxEstimatedMs
+                << " ms; send a smaller input or ask for \"trace\":\"delta\"";
+        size_t responseBytes = queueResponse(conn, errorResponse(message.str(), 413), pooled->keepAlive);
+        finishRequest(conn, worker, route, *pooled->routeMetrics, pooled->metrics, pooled->started, 413, responseBytes);
+        return;
+    }
 
-        std::string method = request.substr(0, method_end);
-        size_t path_end = request.find(' ', method_end + 1);
-        if (path_end == std::string::npos) {
-#ifdef _WIN32
-            closesocket(new_socket);
-#else
-            close(new_socket);
-#endif
-            continue;
+    WorkerContext* owner = &worker;
+    bool queued = pool.submit([this, pooled, owner](PoolThread& thread) {
+        runPooled(*pooled, thread);
+        {
+            std::lock_guard<std::mutex> lock(owner->poolMutex);
+            owner->poolDone.push_back(pooled);
         }
+        owner->poller.wakeup();
+    }, std::chrono::microseconds(static_cast<long long>(cost.millis * 1000)));
+    if (queued) {
+        conn.onPool = true;
+        return;
+    }
 
-        std::string path = request.substr(method_end + 1, path_end - method_end - 1);
-        
-        // Extract request body
-        std::string body;
-        size_t body_start = request.find("\r\n\r\n");
-        if (body_start != std::string::npos) {
-            body = request.substr(body_start + 4);
-        }
+    // Shed the request rather than queue it behind more work than the pool
+    // can get through
+    HttpResponse response = errorResponse("Server is busy, retry later", 503);
+    response.headers.push_back({"Retry-After", std::to_string(config.retryAfterSec)});
+    size_t responseBytes = queueResponse(conn, std::move(response), pooled->keepAlive);
+    finishRequest(conn, worker, route, *pooled->routeMetrics, pooled->metrics, pooled->started, 503, responseBytes);
+}
 
-        // Handle OPTIONS preflight request for CORS
-        if (method == "OPTIONS") {
-            std::string response = "HTTP/1.1 200 OK\r\n" + CORS_HEADERS + "Content-Length: 0\r\n\r\n";
-#ifdef _WIN32
-            send(new_socket, response.c_str(), response.length(), 0);
-            closesocket(new_socket);
-#else
-            write(new_socket, response.c_str(), response.length());
-            close(new_socket);
-#endif
-            continue;
+bool AlgoServer::answerFromCache(Connection& conn, WorkerContext& worker, PooledRequest& pooled) {
+    std::string etag = pooled.cacheKey.etag();
+    HttpResponse response;
+    if (etagMatches(pooled.request.header("if-none-match"), etag)) {
+        // Identical requests get identical responses, so the client's copy
+        // is current whether or not the cache still holds it
+        response.status = 304;
+        response.contentType.clear();
+    } else if (auto hit = results.enabled() ? results.find(pooled.cacheKey) : nullptr) {
+        response.contentType = hit->contentType;
+        response.sharedBody = SharedBody{hit, hit->body.data(), hit->body.size()};
+        if (!hit->contentEncoding.empty()) response.headers.push_back({"Content-Encoding", hit->contentEncoding});
+        pooled.metrics.algorithm = hit->algorithm;
+        pooled.metrics.steps = hit->steps;
+    } else {
+        // Sent from the mapped segment, which stays mapped until it is
+        CachedResult stored;
+        if (!diskResults.enabled() || !diskResults.find(pooled.cacheKey, stored, response.sharedBody)) {
+            return false;
         }
+        response.contentType = stored.contentType;
+        if (!stored.contentEncoding.empty()) response.headers.push_back({"Content-Encoding", stored.contentEncoding});
+        pooled.metrics.algorithm = stored.algorithm;
+        pooled.metrics.steps = stored.steps;
+    }
+    // Stored compressed or not as when first sent, under a key of its own
+    // per content coding, so a hit needs no recompressing
+    if (config.compressionLevel > 0) response.headers.push_back({"Vary", "Accept-Encoding"});
+    response.headers.push_back({"ETag", etag});
 
-        // Find appropriate handler
-        std::string response;
-        bool handled = false;
+    int status = response.status;
+    size_t responseBytes = queueResponse(conn, std::move(response), pooled.keepAlive);
+    finishRequest(conn, worker, pooled.route, *pooled.routeMetrics, pooled.metrics, pooled.started, status,
+                  responseBytes);
+    return true;
+}
 
-        for (const auto& handler : routeHandlers) {
-            if (path.find(handler.first) == 0) {
-                response = handler.second(method, path, body);
-                handled = true;
-                break;
-            }
+void AlgoServer::storeResult(const ResultKey& key, std::shared_ptr<CachedResult> result) {
+    if (diskResults.enabled()) diskResults.insert(key, *result);
+    if (results.enabled()) results.insert(key, std::move(result));
+}
+
+void AlgoServer::runPooled(PooledRequest& pooled, PoolThread& thread) {
+    HttpRequest& request = pooled.request;
+    request.arena = thread.arena.resource();
+    request.metrics = &pooled.metrics;
+
+    // Phases from here on are this thread's to record, in its own ring,
+    // under the id the event loop gave the request; finishPooled() hands
+    // them back to the event loop
+    PhaseContext& phases = pooled.metrics.phases;
+    if (phases.ring) phases.ring = thread.phases;
+    if (phases.ring) {
+        char args[48];
+        std::snprintf(args, sizeof(args), "\"estimated_ms\":%.3f", pooled.estimatedMs);
+        phases.ring->record("queue", phases.request, pooled.started, std::chrono::steady_clock::now(), args);
+    }
+
+    ScopedPhase handling(phases, "handle");
+    HttpResponse response;
+    try {
+        response = handleRequest(request, pooled.route);
+    } catch (const std::exception& e) {
+        response = errorResponse(std::string("Error: ") + e.what(), 500);
+    }
+    handling.end();
+    pooled.status = response.status;
+    const char* encoding = encodeResponse(response, pooled.encoding);
+
+    // A successful run of a cached route is kept for the next identical
+    // request, and its ETag stays good for every later one
+    bool caching = pooled.cacheable && response.status == 200;
+    size_t keptBytes = std::max(results.enabled() ? results.maxEntryBytes() : 0,
+                                diskResults.enabled() ? diskResults.maxEntryBytes() : 0);
+    auto result = std::make_shared<CachedResult>();
+    if (caching) {
+        response.headers.push_back({"ETag", pooled.cacheKey.etag()});
+        result->contentType = response.contentType;
+        result->contentEncoding = encoding;
+    }
+
+    if (!response.producer) {
+        if (caching && response.bodySize() <= keptBytes) {
+            result->body.reserve(response.bodySize());
+            result->body += response.body;
+            for (const auto& part : response.bodyParts) result->body += part;
+            result->algorithm = pooled.metrics.algorithm;
+            result->steps = pooled.metrics.steps;
+            storeResult(pooled.cacheKey, std::move(result));
         }
+        pooled.response = std::move(response);
+        return;
+    }
+
+    CapturedBody captured;
+    if (caching) {
+        captured.limit = keptBytes;
+        response.producer = [produce = std::move(response.producer), &captured](ResponseStream& out) {
+            CapturingStream copying(out, captured);
+            produce(copying);
+        };
+    }
+
+    // Nothing else is queued for the socket (see processInput), so the
+    // frames go out from here while the algorithm produces them
+    ScopedPhase responding(phases, "respond");
+    std::string head = serializeResponseHead(response, 0, true, pooled.keepAlive, config.idleTimeoutSec);
+    pooled.streamedBytes = head.size();
+    OutputQueue queued;
+    queued.push(std::move(head));
+    size_t bodyBytes;
+    pooled.streamed = true;
+    pooled.streamAborted = !streamResponse(pooled.fd, queued, response, bodyBytes);
+    pooled.streamedBytes += bodyBytes;
+
+    if (caching && !pooled.streamAborted && !captured.overflowed) {
+        result->body = std::move(captured.data);
+        result->algorithm = pooled.metrics.algorithm;
+        result->steps = pooled.metrics.steps;
+        storeResult(pooled.cacheKey, std::move(result));
+    }
+}
 
-        if (!handled) {
-            // Default 404 response
-            response = "HTTP/1.1 404 Not Found\r\n" + CORS_HEADERS + 
-                      "Content-Type: application/json\r\n"
-                      "Content-Length: 27\r\n"
-                      "\r\n"
-                      "{\"error\":\"Route not found\"}";
+void AlgoServer::finishPooled(Connection& conn, WorkerContext& worker, PooledRequest& pooled) {
+    conn.onPool = false;
+    if (pooled.metrics.phases.ring) pooled.metrics.phases.ring = worker.phases;
+    size_t responseBytes;
+    if (pooled.streamed) {
+        responseBytes = pooled.streamedBytes;
+        if (pooled.streamAborted) {
+            conn.peerClosed = true;
+        }
+        if (pooled.streamAborted || !pooled.keepAlive) {
+            conn.closeAfterWrite = true;
         }
+    } else {
+        responseBytes = queueResponse(conn, std::move(pooled.response), pooled.keepAlive);
+    }
+    finishRequest(conn, worker, pooled.route, *pooled.routeMetrics, pooled.metrics, pooled.started, pooled.status,
+                  responseBytes);
+}
 
-        // Send response
-#ifdef _WIN32
-        send(new_socket, response.c_str(), response.length(), 0);
-        closesocket(new_socket);
-#else
-        write(new_socket, response.c_str(), response.length());
-        close(new_socket);
-#endif
+ContentEncoding AlgoServer::responseEncoding(const HttpRequest& request) const {
+    if (config.compressionLevel <= 0) return ContentEncoding::Identity;
+    return negotiateEncoding(request.header("accept-encoding"));
+}
+
+bool AlgoServer::compressible(size_t bodySize) const {
+    return config.compressionLevel > 0 && bodySize >= config.compressMinBytes;
+}
+
+const char* AlgoServer::encodeResponse(HttpResponse& response, ContentEncoding encoding) {
+    if (response.status == 304 || (!response.producer && !compressible(response.bodySize()))) return "";
+    response.headers.push_back({"Vary", "Accept-Encoding"});
+    if (encoding == ContentEncoding::Identity) return "";
+    int level = std::min(config.compressionLevel, 9);
+
+    // The header is only set once the compressor has opened; if it cannot,
+    // the body goes out uncompressed
+    const char* name = contentEncodingName(encoding);
+    if (response.producer) {
+        // Opened here, before the head is sent, and compressing block by
+        // block as the frames are produced
+        auto compressor = std::make_shared<StreamCompressor>(encoding, level);
+        if (!compressor->opened()) return "";
+        response.producer = [produce = std::move(response.producer), compressor, this](ResponseStream& out) {
+            CompressingStream compressing(out, *compressor, compression);
+            produce(compressing);
+            compressing.finish();
+        };
+    } else {
+        std::string compressed;
+        if (!compressBody(response, encoding, level, compressed)) return "";
+        compression.add(response.bodySize(), compressed.size());
+        response.body = std::move(compressed);
+        response.bodyParts.clear();
+        response.sharedBody = SharedBody();
     }
+    response.headers.push_back({"Content-Encoding", name});
+    return name;
 }
 
-void AlgoServer::stop() {
-    running = false;
+size_t AlgoServer::queueResponse(Connection& conn, HttpResponse response, bool keepAlive) {
+    if (response.producer) {
+        return sendStreamed(conn, response, keepAlive);
+    }
+
+    // The body is moved, not copied, into the queue behind its head
+    size_t bodySize = response.bodySize();
+    std::string head = serializeResponseHead(response, bodySize, false, keepAlive, config.idleTimeoutSec);
+    size_t bytes = head.size() + bodySize;
+    conn.output.push(std::move(head));
+    conn.output.push(std::move(response.body));
+    for (auto& part : response.bodyParts) {
+        conn.output.push(std::move(part));
+    }
+    if (response.sharedBody.length > 0) {
+        conn.output.push(response.sharedBody);
+    }
+    if (!keepAlive) {
+        conn.closeAfterWrite = true;
+    }
+    return bytes;
 }
 
-std::string AlgoServer::jsonResponse(const std::string& data, int statusCode) {
-    std::string statusText = (statusCode == 200) ? "OK" : "Bad Request";
-    
-    return "HTTP/1.1 " + std::to_string(statusCode) + " " + statusText + "\r\n" +
-           CORS_HEADERS +
-           "Content-Type: application/json\r\n"
-           "Content-Length: " + std::to_string(data.length()) + "\r\n"
-           "\r\n" + data;
+size_t AlgoServer::sendStreamed(Connection& conn, const HttpResponse& response, bool keepAlive) {
+    // Earlier pipelined responses go out first, then the head, then chunks as they are produced
+    std::string head = serializeResponseHead(response, 0, true, keepAlive, config.idleTimeoutSec);
+    size_t headBytes = head.size();
+    conn.output.push(std::move(head));
+
+    size_t bodyBytes;
+    if (!streamResponse(conn.fd, conn.output, response, bodyBytes)) {
+        // The client went away or the producer failed mid-body; the only
+        // honest signal left is to drop the connection without a final chunk
+        conn.output.clear();
+        conn.peerClosed = true;
+        keepAlive = false;
+    }
+
+    if (!keepAlive) {
+        conn.closeAfterWrite = true;
+    }
+    return headBytes + bodyBytes;
 }
 
-std::string AlgoServer::errorResponse(const std::string& message, int statusCode) {
-    std::string error = "{\"error\":\"" + escapeJson(message) + "\"}";
-    return jsonResponse(error, statusCode);
+bool AlgoServer::flushConnection(Connection& conn) {
+    if (!conn.output.send(conn.fd)) return false;
+    if (conn.writePhase.ring && !conn.hasPendingOutput()) {
+        conn.writePhase.ring->record("write", conn.writePhase.request, conn.writeStarted,
+                                     std::chrono::steady_clock::now());
+        conn.writePhase = PhaseContext();
+    }
+    return conn.hasPendingOutput() || !conn.closeAfterWrite;
 }
 
-std::map<std::string, std::string> AlgoServer::parseJson(const std::string& jsonStr) {
-    std::map<std::string, std::string> result;
-    
-    size_t pos = 0;
-    while(pos < jsonStr.size()) {
-        // Find key start (after quote)
-        size_t keyStart = jsonStr.find('"', pos);
-        if (keyStart == std::string::npos) break;
-        keyStart++;
-        
-        // Find key end (before quote)
-        size_t keyEnd = jsonStr.find('"', keyStart);
-        if (keyEnd == std::string::npos) break;
-        
-        std::string key = jsonStr.substr(keyStart, keyEnd - keyStart);
-        
-        // Find value start (after colon and whitespace)
-        size_t valueStart = jsonStr.find(':', keyEnd) + 1;
-        while (valueStart < jsonStr.size() && std::isspace(jsonStr[valueStart])) {
-            valueStart++;
-        }
-        
-        if (valueStart >= jsonStr.size()) break;
-        
-        std::string value;
-        if (jsonStr[valueStart] == '"') {
-            // String value
-            valueStart++;
-            size_t valueEnd = jsonStr.find('"', valueStart);
-            if (valueEnd == std::string::npos) break;
-            value = jsonStr.substr(valueStart, valueEnd - valueStart);
-            pos = valueEnd + 1;
-        } else if (jsonStr[valueStart] == '[') {
-            // Array value - find the matching closing bracket
-            int bracketCount = 1;
-            size_t valueEnd = valueStart + 1;
-            
-            while (valueEnd < jsonStr.size() && bracketCount > 0) {
-                if (jsonStr[valueEnd] == '[') bracketCount++;
-                else if (jsonStr[valueEnd] == ']') bracketCount--;
-                valueEnd++;
-            }
-            
-            value = jsonStr.substr(valueStart, valueEnd - valueStart);
-            pos = valueEnd;
-        } else if (jsonStr[valueStart] == '{') {
-            // Object value - find the matching closing brace
-            int braceCount = 1;
-            size_t valueEnd = valueStart + 1;
-            
-            while (valueEnd < jsonStr.size() && braceCount > 0) {
-                if (jsonStr[valueEnd] == '{') braceCount++;
-                else if (jsonStr[valueEnd] == '}') braceCount--;
-                valueEnd++;
-            }
-            
-            value = jsonStr.substr(valueStart, valueEnd - valueStart);
-            pos = valueEnd;
-        } else {
-            // Number or other value - find next comma or closing brace
-            size_t valueEnd = jsonStr.find_first_of(",}", valueStart);
-            if (valueEnd == std::string::npos) break;
-            value = jsonStr.substr(valueStart, valueEnd - valueStart);
-            // Trim whitespace
-            while (!value.empty() && std::isspace(value.back())) {
-                value.pop_back();
-            }
-            pos = valueEnd;
+AlgoServer::RouteMap::const_iterator AlgoServer::findRoute(const std::string& path) const {
+    auto exact = routeHandlers.find(path);
+    if (exact != routeHandlers.end()) {
+        return exact;
+    }
+    auto best = routeHandlers.end();
+    for (auto it = routeHandlers.begin(); it != routeHandlers.end(); ++it) {
+        if ((best == routeHandlers.end() || it->first.size() > best->first.size()) &&
+            path.compare(0, it->first.size(), it->first) == 0) {
+            best = it;
         }
-        
-        result[key] = value;
     }
-    
-    return result;
+    return best;
+}
+
+const std::string& AlgoServer::routeLabel(RouteMap::const_iterator route) const {
+    return route != routeHandlers.end() ? route->first : UNMATCHED_ROUTE;
+}
+
+HttpResponse AlgoServer::handleRequest(const HttpRequest& request, RouteMap::const_iterator route) {
+    // Handle OPTIONS preflight request for CORS
+    if (request.method == "OPTIONS") {
+        HttpResponse response;
+        response.contentType.clear();
+        return response;
+    }
+
+    if (route != routeHandlers.end()) {
+        return route->second.handler(request);
+    }
+
+    // Default 404 response
+    return errorResponse("Route not found", 404);
+}
+
+HttpResponse AlgoServer::jsonResponse(const std::string& data, int statusCode) {
+    HttpResponse response;
+    response.status = statusCode;
+    response.body = data;
+    return response;
+}
+
+HttpResponse AlgoServer::errorResponse(const std::string& message, int statusCode) {
+    std::string error = "{\"error\":\"" + escapeJson(message) + "\"}";
+    return jsonResponse(error, statusCode);
 }
 
 std::string AlgoServer::escapeJson(const std::string& s) {
@@ -293,229 +1805,446 @@ std::string AlgoServer::escapeJson(const std::string& s) {
     return o.str();
 }
 
-void AlgoServer::registerHandler(const std::string& route, HandlerFunction handler) {
-    routeHandlers[route] = handler;
+void AlgoServer::registerHandler(const std::string& route, HandlerFunction handler, bool compute, bool cached) {
+    routeHandlers[route] = Route{handler, compute, cached};
 }
 
 void AlgoServer::initRoutes() {
     // Sorting algorithms
-    registerHandler("/api/sort", [this](const std::string& method, const std::string& path, const std::string& body) -> std::string {
-        if (method != "POST") {
+    registerHandler("/api/sort", [this](const HttpRequest& request) -> HttpResponse {
+        if (request.method != "POST") {
             return errorResponse("Method not allowed", 405);
         }
         
         try {
-            auto params = parseJson(body);
-            std::string algorithm = params["algorithm"];
-            std::string arrayStr = params["array"];
+            ScopedPhase parsing(requestPhases(request), "parse");
+            auto params = parseJson(request.body, request.arena);
+            std::string algorithm(params["algorithm"]);
+            std::vector<int> array = requestArray(params, MAX_INPUT_ELEMENTS, request.arena);
+            parsing.end();
             
-            // Parse array
-            std::vector<int> array;
-            size_t pos = 0;
-            while ((pos = arrayStr.find_first_of("0123456789", pos)) != std::string::npos) {
-                size_t endPos = arrayStr.find_first_not_of("0123456789", pos);
-                if (endPos == std::string::npos) endPos = arrayStr.length();
-                array.push_back(std::stoi(arrayStr.substr(pos, endPos - pos)));
-                pos = endPos;
+            // "trace":"delta" sends the initial array plus one small operation per
+            // frame instead of a full array snapshot per frame; "resolution":R
+            // down-samples each snapshot frame to R min/max buckets
+            TraceOptions options = requestTraceOptions(params, true, wantsBinaryTrace(request));
+            if (!findSort<NullTracer>(algorithm)) {
+                return errorResponse("Unknown sorting algorithm: " + algorithm, 400);
             }
+            tagAlgorithm(request, algorithm);
+            std::string header = options.binary  ? binaryArrayTraceHeader(array)
+                                 : options.delta ? "\"initial\":" + valuesToJson(array)
+                                                 : "";
             
             // Perform sorting and track steps
-            std::vector<std::string> steps;
-            if (algorithm == "bubble") {
-                steps = bubbleSort(array);
-            } else if (algorithm == "insertion") {
-                steps = insertionSort(array);
-            } else if (algorithm == "selection") {
-                steps = selectionSort(array);
-            } else if (algorithm == "merge") {
-                steps = mergeSort(array);
-            } else if (algorithm == "quick") {
-                steps = quickSort(array);
-            } else if (algorithm == "heap") {
-                steps = heapSort(array);
-            } else {
-                return errorResponse("Unknown sorting algorithm: " + algorithm, 400);
+            return tracedResponse(request, options, header, [algorithm, array = std::move(array)](auto& tracer) {
+                findSort<std::decay_t<decltype(tracer)>>(algorithm)(array, tracer);
+                return std::string();
+            });
+        } catch (const std::exception& e) {
+            return errorResponse(std::string("Error: ") + e.what(), 400);
+        }
+    }, true, true);
+    
+    // Stats-only run of several sorts on one large input: no frames, just
+    // operation counts, timings and memory per algorithm
+    registerHandler("/api/sort/race", [this](const HttpRequest& request) -> HttpResponse {
+        if (request.method != "POST") {
+            return errorResponse("Method not allowed", 405);
+        }
+        
+        try {
+            ScopedPhase parsing(requestPhases(request), "parse");
+            auto params = parseJson(request.body, request.arena);
+            
+            std::vector<int> input = requestArray(params, MAX_RACE_ELEMENTS, request.arena);
+            parsing.end();
+            
+            std::vector<std::string> algorithms = raceAlgorithms(params);
+            for (const auto& algorithm : algorithms) {
+                if (!findSort<NullTracer>(algorithm)) {
+                    return errorResponse("Unknown sorting algorithm: " + algorithm, 400);
+                }
+            }
+            
+            int budgetMs = raceBudgetMs(params);
+            
+            std::vector<RaceResult> results = runSortRace(input, algorithms, budgetMs);
+            
+            std::ostringstream json;
+            json << "{\"size\":" << input.size() << ",\"budgetMs\":" << budgetMs << ",\"results\":[";
+            for (size_t i = 0; i < results.size(); ++i) {
+                const RaceResult& r = results[i];
+                if (i > 0) json << ",";
+                json << "{\"algorithm\":\"" << r.algorithm << "\""
+                     << ",\"completed\":" << (r.completed ? "true" : "false")
+                     << ",\"comparisons\":" << r.counts.comparisons
+                     << ",\"swaps\":" << r.counts.swaps
+                     << ",\"writes\":" << r.counts.writes
+                     << ",\"steps\":" << r.counts.steps
+                     << std::fixed << std::setprecision(3)
+                     << ",\"budgetMs\":" << r.budgetMs
+                     << ",\"wallMs\":" << r.wallMs
+                     << ",\"cpuMs\":" << r.cpuMs
+                     << ",\"peakBytes\":" << r.peakBytes;
+                if (!r.error.empty()) {
+                    json << ",\"error\":\"" << escapeJson(r.error) << "\"";
+                }
+                json << "}";
+            }
+            json << "]}";
+            return jsonResponse(json.str(), 200);
+        } catch (const std::exception& e) {
+            return errorResponse(std::string("Error: ") + e.what(), 400);
+        }
+    }, true);
+    
+    // Trace sessions: POST records a sort once and returns an id; GET
+    // /api/trace/{id}?from=F&count=C then returns any window of its frames,
+    // rebuilt from the nearest keyframe, so a client can seek anywhere
+    // without downloading the frames before it
+    registerHandler("/api/trace", [this](const HttpRequest& request) -> HttpResponse {
+        try {
+            if (request.path == "/api/trace" || request.path == "/api/trace/") {
+                if (request.method != "POST") {
+                    return errorResponse("Method not allowed", 405);
+                }
+                
+                ScopedPhase parsing(requestPhases(request), "parse");
+                auto params = parseJson(request.body, request.arena);
+                std::string algorithm(params["algorithm"]);
+                std::vector<int> array = requestArray(params, MAX_TRACE_ELEMENTS, request.arena);
+                parsing.end();
+                auto sort = findSort<SortTrace>(algorithm);
+                if (!sort) {
+                    return errorResponse("Unknown sorting algorithm: " + algorithm, 400);
+                }
+                tagAlgorithm(request, algorithm);
+                
+                // Keyframes are at least one array length apart, so they never take
+                // more memory than the operations between them
+                size_t interval = params["keyframeInterval"].empty() ? DEFAULT_KEYFRAME_INTERVAL
+                                                                     : parseNumber<size_t>(params["keyframeInterval"]);
+                interval = std::max(interval, std::max<size_t>(array.size(), 1));
+                
+                size_t maxBytes = std::min(MAX_TRACE_BYTES, traces.capacity());
+                auto trace = std::make_shared<SortTrace>(array, interval, maxBytes);
+                try {
+                    ScopedPhase recording(requestPhases(request), "algorithm");
+                    sort(array, *trace);
+                } catch (const SortTrace::TooLarge&) {
+                    return errorResponse("Trace exceeds " + std::to_string(maxBytes >> 20) + " MB", 413);
+                }
+                
+                size_t total = trace->size();
+                if (request.metrics) request.metrics->steps = total;
+                std::string id = traces.add(trace);
+                return jsonResponse("{\"id\":\"" + id + "\",\"total\":" + std::to_string(total) +
+                                    ",\"keyframeInterval\":" + std::to_string(interval) +
+                                    ",\"size\":" + std::to_string(array.size()) + "}", 200);
+            }
+            
+            std::string id = request.path.substr(std::string("/api/trace/").size());
+            if (request.method == "DELETE") {
+                if (!traces.remove(id)) {
+                    return errorResponse("Unknown trace: " + id, 404);
+                }
+                HttpResponse response;
+                response.status = 204;
+                response.contentType.clear();
+                return response;
             }
+            if (request.method != "GET") {
+                return errorResponse("Method not allowed", 405);
+            }
+            
+            auto trace = traces.find(id);
+            if (!trace) {
+                return errorResponse("Unknown or expired trace: " + id, 404);
+            }
+            
+            std::string fromParam = request.queryParam("from");
+            std::string countParam = request.queryParam("count");
+            std::string format = request.queryParam("format");
+            size_t from = fromParam.empty() ? 0 : parseNumber<size_t>(fromParam);
+            size_t count = countParam.empty() ? 1000 : parseNumber<size_t>(countParam);
+            if (from > trace->size()) {
+                return errorResponse("from is past the end of the trace (" + std::to_string(trace->size()) + " frames)", 400);
+            }
+            count = std::min({count, MAX_TRACE_WINDOW, trace->size() - from});
             
-            // Convert steps to JSON array
-            std::ostringstream stepsJson;
-            stepsJson << "[";
-            for (size_t i = 0; i < steps.size(); ++i) {
-                if (i > 0) stepsJson << ",";
-                stepsJson << steps[i];
-            }
-            stepsJson << "]";
+            std::vector<int> state = trace->stateBefore(from);
+            std::string response = "{\"id\":\"" + id + "\",\"from\":" + std::to_string(from) +
+                                   ",\"total\":" + std::to_string(trace->size());
             
-            std::string response = "{\"steps\":" + stepsJson.str() + "}";
+            if (format == "snapshot") {
+                // Full frames, as /api/sort returns them, optionally down-sampled
+                // to 'resolution' buckets
+                std::string resolutionParam = request.queryParam("resolution");
+                size_t resolution = resolutionParam.empty() ? 0 : parseNumber<size_t>(resolutionParam);
+                size_t frameValues = resolution > 0 ? std::min(resolution, state.size()) : state.size();
+                count = std::min(count, std::max<size_t>(MAX_TRACE_WINDOW_VALUES / std::max<size_t>(frameValues, 1), 1));
+                
+                std::unique_ptr<ArrayBuckets> buckets;
+                if (resolution > 0) buckets.reset(new ArrayBuckets(state, resolution));
+                std::vector<std::string> steps;
+                steps.reserve(count);
+                int h1, h2;
+                for (size_t i = from; i < from + count; ++i) {
+                    trace->apply(i, state, h1, h2);
+                    if (buckets) {
+                        buckets->update(state, h1);
+                        buckets->update(state, h2);
+                        steps.push_back(buckets->toJson(h1, h2));
+                    } else {
+                        steps.push_back(arrayToJson(state, h1, h2));
+                    }
+                }
+                response += ",\"count\":" + std::to_string(count) + ",\"steps\":" + stepsToJson(steps) + "}";
+            } else if (format.empty() || format == "delta") {
+                // The array before the window plus its delta operations
+                std::string ops = "[";
+                for (size_t i = from; i < from + count; ++i) {
+                    if (i > from) ops += ",";
+                    ops += trace->opToJson(i);
+                }
+                ops += "]";
+                response += ",\"count\":" + std::to_string(count) + ",\"format\":\"delta\",\"initial\":" +
+                            valuesToJson(state) + ",\"ops\":" + ops + "}";
+            } else {
+                return errorResponse("Unknown trace format: " + format, 400);
+            }
             return jsonResponse(response, 200);
         } catch (const std::exception& e) {
             return errorResponse(std::string("Error: ") + e.what(), 400);
         }
-    });
+    }, true);
     
     // Searching algorithms
-    registerHandler("/api/search", [this](const std::string& method, const std::string& path, const std::string& body) -> std::string {
-        if (method != "POST") {
+    registerHandler("/api/search", [this](const HttpRequest& request) -> HttpResponse {
+        if (request.method != "POST") {
             return errorResponse("Method not allowed", 405);
         }
         
         try {
-            auto params = parseJson(body);
-            std::string algorithm = params["algorithm"];
-            std::string arrayStr = params["array"];
-            int target = std::stoi(params["target"]);
+            ScopedPhase parsing(requestPhases(request), "parse");
+            auto params = parseJson(request.body, request.arena);
+            std::string algorithm(params["algorithm"]);
+            std::vector<int> array = requestArray(params, MAX_INPUT_ELEMENTS, request.arena);
+            int target = parseNumber<int>(params["target"]);
+            parsing.end();
             
-            // Parse array
-            std::vector<int> array;
-            size_t pos = 0;
-            while ((pos = arrayStr.find_first_of("0123456789", pos)) != std::string::npos) {
-                size_t endPos = arrayStr.find_first_not_of("0123456789", pos);
-                if (endPos == std::string::npos) endPos = arrayStr.length();
-                array.push_back(std::stoi(arrayStr.substr(pos, endPos - pos)));
-                pos = endPos;
+            // Binary search requires sorted array
+            if (algorithm == "binary") {
+                std::sort(array.begin(), array.end());
             }
             
-            // Perform search and track steps
-            std::vector<std::string> steps;
-            int result = -1;
-            
-            if (algorithm == "linear") {
-                result = linearSearch(array, target, steps);
-            } else if (algorithm == "binary") {
-                // Binary search requires sorted array
-                std::sort(array.begin(), array.end());
-                result = binarySearch(array, target, steps);
-            } else {
+            TraceOptions options = requestTraceOptions(params, true, wantsBinaryTrace(request));
+            if (!findSearch<NullTracer>(algorithm)) {
                 return errorResponse("Unknown searching algorithm: " + algorithm, 400);
             }
+            tagAlgorithm(request, algorithm);
+            std::string header = options.binary  ? binaryArrayTraceHeader(array)
+                                 : options.delta ? "\"initial\":" + valuesToJson(array)
+                                                 : "";
             
-            // Convert steps to JSON array
-            std::ostringstream stepsJson;
-            stepsJson << "[";
-            for (size_t i = 0; i < steps.size(); ++i) {
-                if (i > 0) stepsJson << ",";
-                stepsJson << steps[i];
-            }
-            stepsJson << "]";
-            
-            std::string response = "{\"steps\":" + stepsJson.str() + 
-                                  ",\"result\":" + std::to_string(result) + "}";
-            return jsonResponse(response, 200);
+            // Perform search and track steps
+            return tracedResponse(request, options, header,
+                                  [algorithm, array = std::move(array), target](auto& tracer) {
+                int result = findSearch<std::decay_t<decltype(tracer)>>(algorithm)(array, target, tracer);
+                return ",\"result\":" + std::to_string(result);
+            });
         } catch (const std::exception& e) {
             return errorResponse(std::string("Error: ") + e.what(), 400);
         }
-    });
+    }, true, true);
     
     // Graph algorithms
-    registerHandler("/api/graph", [this](const std::string& method, const std::string& path, const std::string& body) -> std::string {
-        if (method != "POST") {
+    registerHandler("/api/graph", [this](const HttpRequest& request) -> HttpResponse {
+        if (request.method != "POST") {
             return errorResponse("Method not allowed", 405);
         }
         
         try {
-            auto params = parseJson(body);
-            std::string algorithm = params["algorithm"];
-            std::string graphData = params["graph"];
+            ScopedPhase parsing(requestPhases(request), "parse");
+            auto params = parseJson(request.body, request.arena);
+            std::string algorithm(params["algorithm"]);
             
             // Additional parameters based on algorithm
             int startNode = 0;
             int endNode = 0;
             
-            if (params.find("startNode") != params.end()) {
-                startNode = std::stoi(params["startNode"]);
+            if (!params["startNode"].empty()) {
+                startNode = parseNumber<int>(params["startNode"]);
             }
             
-            if (params.find("endNode") != params.end()) {
-                endNode = std::stoi(params["endNode"]);
+            if (!params["endNode"].empty()) {
+                endNode = parseNumber<int>(params["endNode"]);
             }
+            (void)endNode;
             
-            // Parse graph from adjacency list format
-            std::vector<std::vector<std::pair<int, int>>> graph;
-            // ... parsing logic for graph
+            // Parse graph from adjacency list format, or generate it
+            AdjacencyList graph = requestGraph(params, request.arena);
+            parsing.end();
+            if (graph.empty() || startNode < 0 || startNode >= static_cast<int>(graph.size())) {
+                return errorResponse("Graph must be non-empty and startNode must be a valid node", 400);
+            }
             
-            // Run algorithm and get visualization steps
-            std::vector<std::string> steps;
-            if (algorithm == "bfs") {
-                steps = breadthFirstSearch(graph, startNode);
-            } else if (algorithm == "dfs") {
-                steps = depthFirstSearch(graph, startNode);
-            } else if (algorithm == "dijkstra") {
-                steps = dijkstraAlgorithm(graph, startNode);
-            } else if (algorithm == "kruskal") {
-                steps = kruskalMST(graph);
-            } else if (algorithm == "prim") {
-                steps = primMST(graph);
-            } else {
+            TraceOptions options = requestTraceOptions(params, false, wantsBinaryTrace(request));
+            if (!findGraphAlgorithm<NullTracer>(algorithm)) {
                 return errorResponse("Unknown graph algorithm: " + algorithm, 400);
             }
+            tagAlgorithm(request, algorithm);
+            std::string header =
+                options.binary  ? binaryGraphTraceHeader(graph)
+                : options.delta ? "\"nodes\":" + std::to_string(graph.size()) + ",\"edges\":" + graphEdgesToJson(graph)
+                                : "";
+            
+            // Run algorithm and get visualization steps
+            return tracedResponse(request, options, header,
+                                  [algorithm, graph = std::move(graph), startNode](auto& tracer) {
+                findGraphAlgorithm<std::decay_t<decltype(tracer)>>(algorithm)(graph, startNode, tracer);
+                return std::string();
+            });
+        } catch (const std::exception& e) {
+            return errorResponse(std::string("Error: ") + e.what(), 400);
+        }
+    }, true, true);
+    
+    // Predicted frames, bytes and milliseconds of a request to /api/sort,
+    // /api/search, /api/graph, /api/trace or /api/sort/race, without running
+    // it. The body is the one that route takes, or names the input's size in
+    // "size" (or "nodes" and "edges") instead of sending it; "route" picks
+    // the route, by default the one serving the algorithm, and
+    // "encoding":"binary" estimates binary traces.
+    registerHandler("/api/estimate", [this](const HttpRequest& request) -> HttpResponse {
+        if (request.method != "POST") {
+            return errorResponse("Method not allowed", 405);
+        }
+        
+        try {
+            auto params = parseJson(request.body, request.arena);
+            std::string algorithm(params["algorithm"]);
+            std::string route(params["route"]);
+            if (route.empty()) {
+                if (findSort<NullTracer>(algorithm)) {
+                    route = "/api/sort";
+                } else if (findSearch<NullTracer>(algorithm)) {
+                    route = "/api/search";
+                } else if (findGraphAlgorithm<NullTracer>(algorithm)) {
+                    route = "/api/graph";
+                }
+            }
             
-            // Convert steps to JSON array
-            std::ostringstream stepsJson;
-            stepsJson << "[";
-            for (size_t i = 0; i < steps.size(); ++i) {
-                if (i > 0) stepsJson << ",";
-                stepsJson << steps[i];
-            }
-            stepsJson << "]";
+            CostEstimate cost;
+            bool binary = params["encoding"] == "binary";
+            if (!estimateRequest(route, params, true, binary, request.arena, cost)) {
+                return errorResponse("Unknown algorithm or route: " + algorithm + " " + route, 400);
+            }
+            tagAlgorithm(request, algorithm);
             
-            std::string response = "{\"steps\":" + stepsJson.str() + "}";
-            return jsonResponse(response, 200);
+            std::ostringstream json;
+            json << "{\"route\":\"" << escapeJson(route) << "\",\"algorithm\":\"" << escapeJson(algorithm) << "\""
+                 << std::fixed << std::setprecision(0)
+                 << ",\"frames\":" << cost.frames
+                 << ",\"bytes\":" << cost.bytes
+                 << std::setprecision(3)
+                 << ",\"ms\":" << cost.millis;
+            if (config.maxEstimatedMs > 0) {
+                json << ",\"limitMs\":" << config.maxEstimatedMs
+                     << ",\"refused\":" << (cost.millis > config.maxEstimatedMs ? "true" : "false");
+            }
+            json << "}";
+            return jsonResponse(json.str(), 200);
         } catch (const std::exception& e) {
             return errorResponse(std::string("Error: ") + e.what(), 400);
         }
     });
     
     // Data structure operations (Tree, Heap, etc.)
-    registerHandler("/api/data-structure", [this](const std::string& method, const std::string& path, const std::string& body) -> std::string {
-        if (method != "POST") {
+    registerHandler("/api/data-structure", [this](const HttpRequest& request) -> HttpResponse {
+        if (request.method != "POST") {
             return errorResponse("Method not allowed", 405);
         }
         
         try {
-            auto params = parseJson(body);
-            std::string structure = params["structure"];
-            std::string operation = params["operation"];
-            
+            auto params = parseJson(request.body, request.arena);
+            std::string structure(params["structure"]);
+            std::string operation(params["operation"]);
+
+            // Find the caller's session, or start a new one if it has none
+            // or it was evicted
+            std::string sessionId = request.header("x-session-id");
+            if (sessionId.empty()) sessionId = request.cookie(SESSION_COOKIE);
+            std::shared_ptr<DataStructureSession> session;
+            if (!sessionId.empty()) session = sessions.find(sessionId);
+            bool created = !session;
+            if (created) sessionId = sessions.create(session);
+
+            std::lock_guard<std::mutex> lock(session->mutex);
+            size_t limit = sessions.sessionLimit();
+            std::vector<std::string> steps;
+
             // Handle different data structures
             if (structure == "bst") {
                 // Binary Search Tree operations
                 if (operation == "insert") {
-                    int value = std::stoi(params["value"]);
-                    std::vector<std::string> steps = bstInsert(value);
-                    
-                    // Convert steps to JSON
-                    std::ostringstream stepsJson;
-                    stepsJson << "[";
-                    for (size_t i = 0; i < steps.size(); ++i) {
-                        if (i > 0) stepsJson << ",";
-                        stepsJson << steps[i];
+                    if (sessionBytes(*session) + BST_NODE_BYTES > limit) {
+                        return errorResponse("Session memory limit reached", 413);
                     }
-                    stepsJson << "]";
-                    
-                    std::string response = "{\"steps\":" + stepsJson.str() + "}";
-                    return jsonResponse(response, 200);
+                    steps = bstInsert(session->bstRoot, parseNumber<int>(params["value"]));
                 } else if (operation == "delete") {
-                    // Similar implementation for delete
+                    steps = bstDelete(session->bstRoot, parseNumber<int>(params["value"]));
                 } else if (operation == "search") {
-                    // Similar implementation for search
+                    steps = bstSearch(session->bstRoot, parseNumber<int>(params["value"]));
+                } else if (operation == "clear") {
+                    steps = bstClear(session->bstRoot);
                 }
             } else if (structure == "heap") {
                 // Heap operations
+                if (operation == "insert") {
+                    if (sessionBytes(*session) + sizeof(int) > limit) {
+                        return errorResponse("Session memory limit reached", 413);
+                    }
+                    steps = heapInsert(session->heap, parseNumber<int>(params["value"]));
+                } else if (operation == "extract") {
+                    steps = heapExtractMax(session->heap);
+                } else if (operation == "create") {
+                    std::vector<int> array = parseIntArray(params["array"]);
+                    if (bstNodeCount(session->bstRoot) * BST_NODE_BYTES + array.size() * sizeof(int) > limit) {
+                        return errorResponse("Session memory limit reached", 413);
+                    }
+                    steps = createHeap(session->heap, array);
+                } else if (operation == "clear") {
+                    steps = clearHeap(session->heap);
+                }
             } else if (structure == "trie") {
                 // Trie operations
             } else if (structure == "avl") {
                 // AVL Tree operations
             }
-            
-            return errorResponse("Unknown operation or data structure", 400);
+
+            if (steps.empty()) {
+                return errorResponse("Unknown operation or data structure", 400);
+            }
+            tagAlgorithm(request, structure);
+            if (request.metrics) request.metrics->steps = steps.size();
+            sessions.resize(sessionId, sessionBytes(*session));
+
+            HttpResponse response = jsonResponse(
+                "{\"session\":\"" + sessionId + "\",\"steps\":" + stepsToJson(steps) + "}", 200);
+            if (created) {
+                response.headers.push_back(
+                    {"Set-Cookie", std::string(SESSION_COOKIE) + "=" + sessionId + "; Path=/; HttpOnly; SameSite=Lax"});
+            }
+            return response;
         } catch (const std::exception& e) {
             return errorResponse(std::string("Error: ") + e.what(), 400);
         }
     });
     
     // Get available algorithms
-    registerHandler("/api/algorithms", [this](const std::string& method, const std::string& path, const std::string& body) -> std::string {
-        if (method != "GET") {
+    registerHandler("/api/algorithms", [this](const HttpRequest& request) -> HttpResponse {
+        if (request.method != "GET") {
             return errorResponse("Method not allowed", 405);
         }
         
@@ -528,4 +2257,30 @@ void AlgoServer::initRoutes() {
         
         return jsonResponse(algorithms, 200);
     });
+
+    // Request counts, latency quantiles and sizes per route and algorithm,
+    // in the Prometheus text format
+    registerHandler("/api/metrics", [this](const HttpRequest& request) -> HttpResponse {
+        if (request.method != "GET") {
+            return errorResponse("Method not allowed", 405);
+        }
+
+        HttpResponse response;
+        response.contentType = "text/plain; version=0.0.4; charset=utf-8";
+        response.body = metrics.renderPrometheus() + pool.renderPrometheus() + results.renderPrometheus() +
+                        diskResults.renderPrometheus() + compression.renderPrometheus();
+        return response;
+    });
+
+    // The most recent request phases of every event loop thread, as Chrome
+    // trace_event JSON to open in Perfetto. Only with --debug-trace-events.
+    registerHandler("/api/debug/trace", [this](const HttpRequest& request) -> HttpResponse {
+        if (!phaseTracer.enabled()) {
+            return errorResponse("Phase tracing is off; start the server with --debug-trace-events N", 404);
+        }
+        if (request.method != "GET") {
+            return errorResponse("Method not allowed", 405);
+        }
+        return jsonResponse(phaseTracer.renderChromeTrace(), 200);
+    });
 }
\ No newline at end of file
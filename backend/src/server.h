@@ -4,6 +4,11 @@
 #include <string>
 #include <functional>
 #include <map>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <atomic>
+#include <chrono>
 
 #ifdef _WIN32
 #include <winsock2.h>
@@ -16,37 +21,170 @@
 #include <arpa/inet.h>
 #endif
 
+#include "poller.h"
+#include "http.h"
+#include "trace_store.h"
+#include "session_store.h"
+#include "request_arena.h"
+#include "metrics.h"
+#include "phase_trace.h"
+#include "worker_pool.h"
+#include "result_cache.h"
+#include "disk_cache.h"
+#include "compression.h"
+
+// Runtime configuration for AlgoServer
+struct ServerConfig {
+    int port = 8080;
+    int threads = 0;         // Number of event loop threads, 0 = one per CPU core
+    int idleTimeoutSec = 5;  // Keep-alive connections idle this long are closed
+    size_t maxHeaderBytes = 64 * 1024;       // Request line plus headers
+    size_t maxBodyBytes = 64 * 1024 * 1024;  // Decoded request body
+    size_t traceStoreBytes = 512 * 1024 * 1024; // Recorded traces kept for /api/trace
+    size_t sessionStoreBytes = 64 * 1024 * 1024; // All /api/data-structure sessions
+    size_t sessionLimitBytes = 64 * 1024;        // A single /api/data-structure session
+    size_t debugTraceEvents = 0; // Request phases kept per thread for /api/debug/trace, 0 = tracing off
+    int poolThreads = 0;         // Threads running algorithm requests, 0 = one per CPU core
+    size_t poolQueueLimit = 64;  // Algorithm requests that may wait for a pool thread; more get 503
+    int retryAfterSec = 1;       // Retry-After of those 503 responses
+    double maxEstimatedMs = 0;   // Refuse algorithm requests predicted to run longer, with 413; 0 = no limit
+    size_t resultCacheBytes = 256 * 1024 * 1024; // Responses kept for repeated algorithm requests, 0 = no cache
+    std::string diskCacheDir;                     // Where those responses persist across restarts, empty = nowhere
+    size_t diskCacheBytes = 1024ull * 1024 * 1024; // Disk the persisted responses may use, preallocated segments counted in full
+    int compressionLevel = 6;       // gzip/deflate level of responses to clients accepting it, 0 = never compress
+    size_t compressMinBytes = 1024; // Buffered bodies smaller than this are sent uncompressed
+};
+
+// Per-socket state owned by one event loop thread
+struct Connection;
+
+// State of one event loop thread shared by every request it handles
+struct WorkerContext;
+
 class AlgoServer {
 private:
     int server_fd;
     struct sockaddr_in address;
-    int port;
-    bool running;
+    ServerConfig config;
+    std::atomic<bool> running;
+
+    // One poller per event loop thread
+    std::vector<std::unique_ptr<Poller>> pollers;
+    std::vector<std::thread> workers;
 
     // Response handler type
-    typedef std::function<std::string(const std::string&, const std::string&, const std::string&)> HandlerFunction;
-    
+    typedef std::function<HttpResponse(const HttpRequest&)> HandlerFunction;
+
+    // A route's handler, whether its POST requests run an algorithm and so
+    // are handled on the worker pool rather than the event loop thread, and
+    // whether their responses depend on nothing but the request and so are
+    // kept in the result cache
+    struct Route {
+        HandlerFunction handler;
+        bool compute;
+        bool cached;
+    };
+
     // Algorithm handlers
-    std::map<std::string, HandlerFunction> routeHandlers;
-    
+    typedef std::map<std::string, Route> RouteMap;
+    RouteMap routeHandlers;
+
+    // Trace sessions served by /api/trace
+    TraceStore traces;
+
+    // Per-client trees and heaps edited through /api/data-structure
+    SessionStore sessions;
+
+    // Request counts, latencies and sizes served by /api/metrics
+    MetricsRegistry metrics;
+
+    // Request phase timings served by /api/debug/trace
+    PhaseTracer phaseTracer;
+
+    // Runs the requests of compute routes
+    WorkerPool pool;
+
+    // Responses of cached routes by the content of their requests, in
+    // memory and, behind that, on disk
+    ResultCache results;
+    DiskCache diskResults;
+
+    // Bodies compressed for clients that accept it, served by /api/metrics
+    CompressionStats compression;
+
+    // A request being handled on the pool
+    struct PooledRequest;
+    friend struct WorkerContext;
+
     // Initialize API routes
     void initRoutes();
-    
+
+    // Event loop
+    void workerLoop(Poller& poller);
+    void acceptConnections(Poller& poller, std::map<int, std::unique_ptr<Connection>>& connections);
+    bool readFromConnection(Connection& conn);
+    bool flushConnection(Connection& conn);
+    void advanceParser(Connection& conn);
+    bool processInput(Connection& conn, WorkerContext& worker);
+    void handleAndQueue(Connection& conn, WorkerContext& worker);
+
+    // Requests of compute routes: handed to the pool, or answered with 503
+    // when its queue is full; the pool hands them back to finishPooled()
+    bool runsOnPool(const HttpRequest& request, RouteMap::const_iterator route) const;
+    void submitToPool(Connection& conn, WorkerContext& worker, RouteMap::const_iterator route);
+    bool answerFromCache(Connection& conn, WorkerContext& worker, PooledRequest& pooled);
+    void storeResult(const ResultKey& key, std::shared_ptr<CachedResult> result);
+    void runPooled(PooledRequest& pooled, PoolThread& thread);
+    void finishPooled(Connection& conn, WorkerContext& worker, PooledRequest& pooled);
+
+    // Record a request whose response has been queued or sent
+    void finishRequest(Connection& conn, WorkerContext& worker, RouteMap::const_iterator route,
+                       ThreadMetrics::RouteMetrics& routeMetrics, const RequestMetrics& requestMetrics,
+                       std::chrono::steady_clock::time_point started, int status, size_t responseBytes);
+
+    // The content coding to give a request's response, per its Accept-Encoding
+    ContentEncoding responseEncoding(const HttpRequest& request) const;
+
+    // Apply 'encoding' to a response that is large enough to be worth it,
+    // or streamed; returns the Content-Encoding it was given, or "" if none
+    const char* encodeResponse(HttpResponse& response, ContentEncoding encoding);
+
+    // Whether a body of 'bodySize' bytes is compressed for clients that accept it
+    bool compressible(size_t bodySize) const;
+
+    // Both return the bytes of the response, head and body
+    size_t queueResponse(Connection& conn, HttpResponse response, bool keepAlive);
+    size_t sendStreamed(Connection& conn, const HttpResponse& response, bool keepAlive);
+
+    // The registered route serving 'path': an exact match, else the longest
+    // route that is a prefix of it; routeHandlers.end() if there is none
+    RouteMap::const_iterator findRoute(const std::string& path) const;
+
+    // Metrics and phase trace label of a route
+    const std::string& routeLabel(RouteMap::const_iterator route) const;
+
+    // Route a complete request to its handler
+    HttpResponse handleRequest(const HttpRequest& request, RouteMap::const_iterator route);
+
     // Utility methods
-    std::string jsonResponse(const std::string& data, int statusCode = 200);
-    std::string errorResponse(const std::string& message, int statusCode = 400);
-    std::map<std::string, std::string> parseJson(const std::string& jsonStr);
+    HttpResponse jsonResponse(const std::string& data, int statusCode = 200);
+    HttpResponse errorResponse(const std::string& message, int statusCode = 400);
     std::string escapeJson(const std::string& s);
 
 public:
-    AlgoServer(int port = 8080);
+    AlgoServer(const ServerConfig& config = ServerConfig());
     ~AlgoServer();
-    
+
+    // Runs the event loop threads; blocks until stop() is called
     void start();
     void stop();
-    
-    // Register a handler for a specific route
-    void registerHandler(const std::string& route, HandlerFunction handler);
+
+    // Register a handler for a specific route; 'compute' runs its POST
+    // requests on the worker pool, and 'cached' keeps their 200 responses in
+    // the result cache, which only suits handlers whose response is a pure
+    // function of the request body
+    void registerHandler(const std::string& route, HandlerFunction handler, bool compute = false,
+                         bool cached = false);
 };
 
-#endif // SERVER_H
\ No newline at end of file
+#endif // SERVER_H
@@ -0,0 +1,78 @@
+#include "session_store.h"
+#include <cstdio>
+#include <functional>
+#include <random>
+
+// Charged for every session on top of its data, so that many empty sessions
+// are evicted too
+static const size_t SESSION_OVERHEAD_BYTES = 256;
+
+SessionStore::SessionStore(size_t capacityBytes, size_t sessionLimitBytes)
+    : shardCapacity(capacityBytes / SHARD_COUNT), sessionLimitBytes(sessionLimitBytes) {}
+
+SessionStore::Shard& SessionStore::shardFor(const std::string& id) {
+    return shards[std::hash<std::string>()(id) % SHARD_COUNT];
+}
+
+std::shared_ptr<DataStructureSession> SessionStore::find(const std::string& id) {
+    Shard& shard = shardFor(id);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto it = shard.index.find(id);
+    if (it == shard.index.end()) return nullptr;
+    shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+    return it->second->session;
+}
+
+std::string SessionStore::create(std::shared_ptr<DataStructureSession>& session) {
+    static thread_local std::mt19937_64 rng(std::random_device{}());
+    session = std::make_shared<DataStructureSession>();
+
+    for (;;) {
+        char buf[17];
+        std::snprintf(buf, sizeof(buf), "%016llx", static_cast<unsigned long long>(rng()));
+        std::string id = buf;
+
+        Shard& shard = shardFor(id);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        if (shard.index.count(id)) continue;
+
+        shard.lru.push_front(Entry{id, session, SESSION_OVERHEAD_BYTES});
+        shard.index[id] = shard.lru.begin();
+        shard.bytes += SESSION_OVERHEAD_BYTES;
+        evict(shard);
+        return id;
+    }
+}
+
+void SessionStore::resize(const std::string& id, size_t bytes) {
+    Shard& shard = shardFor(id);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto it = shard.index.find(id);
+    if (it == shard.index.end()) return;
+
+    bytes += SESSION_OVERHEAD_BYTES;
+    shard.bytes = shard.bytes - it->second->bytes + bytes;
+    it->second->bytes = bytes;
+    evict(shard);
+}
+
+bool SessionStore::remove(const std::string& id) {
+    Shard& shard = shardFor(id);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto it = shard.index.find(id);
+    if (it == shard.index.end()) return false;
+    shard.bytes -= it->second->bytes;
+    shard.lru.erase(it->second);
+    shard.index.erase(it);
+    return true;
+}
+
+void SessionStore::evict(Shard& shard) {
+    // Evict from the cold end, but never the most recently used session. A
+    // session still in use stays alive until its request finishes.
+    while (shard.bytes > shardCapacity && shard.lru.size() > 1) {
+        shard.bytes -= shard.lru.back().bytes;
+        shard.index.erase(shard.lru.back().id);
+        shard.lru.pop_back();
+    }
+}
@@ -0,0 +1,68 @@
+#ifndef SESSION_STORE_H
+#define SESSION_STORE_H
+
+#include <string>
+#include <vector>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+struct TreeNode; // data_structures/tree.h
+
+// The data structures one client edits through /api/data-structure
+struct DataStructureSession {
+    std::mutex mutex; // Held while an operation runs on this session
+    std::shared_ptr<TreeNode> bstRoot;
+    std::vector<int> heap;
+};
+
+// Data structure sessions by id. Sessions are spread over shards that each
+// have their own lock, so requests for different sessions rarely contend.
+// Each shard evicts least recently used sessions once the memory they hold
+// passes its part of the capacity.
+class SessionStore {
+public:
+    // 'sessionLimitBytes' is how much a single session may hold; callers
+    // check it before growing a session
+    SessionStore(size_t capacityBytes, size_t sessionLimitBytes);
+
+    // The session with this id, or nullptr if unknown or evicted
+    std::shared_ptr<DataStructureSession> find(const std::string& id);
+
+    // Store a new empty session and return its id
+    std::string create(std::shared_ptr<DataStructureSession>& session);
+
+    // Record how many bytes a session holds now; may evict other sessions
+    void resize(const std::string& id, size_t bytes);
+
+    bool remove(const std::string& id);
+
+    size_t sessionLimit() const { return sessionLimitBytes; }
+
+private:
+    struct Entry {
+        std::string id;
+        std::shared_ptr<DataStructureSession> session;
+        size_t bytes;
+    };
+    typedef std::list<Entry> LruList;
+
+    struct Shard {
+        std::mutex mutex;
+        LruList lru; // Most recently used first
+        std::unordered_map<std::string, LruList::iterator> index;
+        size_t bytes = 0;
+    };
+
+    static const size_t SHARD_COUNT = 16;
+
+    Shard& shardFor(const std::string& id);
+    void evict(Shard& shard);
+
+    Shard shards[SHARD_COUNT];
+    size_t shardCapacity;
+    size_t sessionLimitBytes;
+};
+
+#endif // SESSION_STORE_H
@@ -0,0 +1,112 @@
+#include "trace_store.h"
+#include <algorithm>
+#include <cstdio>
+
+SortTrace::SortTrace(std::vector<int> initial, size_t keyframeInterval, size_t maxBytes)
+    : initial(std::move(initial)), interval(std::max<size_t>(keyframeInterval, 1)), maxBytes(maxBytes) {
+    bytes = this->initial.size() * sizeof(int);
+}
+
+void SortTrace::highlight(const std::vector<int>& arr, int i, int j) {
+    record(arr, 'h', i, j);
+}
+
+void SortTrace::compare(const std::vector<int>& arr, int i, int j) {
+    record(arr, 'c', i, j);
+}
+
+void SortTrace::swap(const std::vector<int>& arr, int i, int j) {
+    record(arr, 's', i, j);
+}
+
+void SortTrace::write(const std::vector<int>& arr, int i) {
+    record(arr, 'w', i, arr[i]);
+}
+
+void SortTrace::record(const std::vector<int>& arr, char kind, int a, int b) {
+    bytes += sizeof(Op);
+    if (ops.size() % interval == interval - 1) bytes += arr.size() * sizeof(int);
+    if (bytes > maxBytes) throw TooLarge();
+
+    ops.push_back(Op{kind, a, b});
+    // 'arr' already reflects this frame, so it is the state before the next one
+    if (ops.size() % interval == 0) keyframes.push_back(arr);
+}
+
+std::vector<int> SortTrace::stateBefore(size_t index) const {
+    size_t k = index / interval;
+    std::vector<int> state = k == 0 ? initial : keyframes[k - 1];
+    int h1, h2;
+    for (size_t i = k * interval; i < index; ++i) {
+        apply(i, state, h1, h2);
+    }
+    return state;
+}
+
+void SortTrace::apply(size_t index, std::vector<int>& state, int& highlight1, int& highlight2) const {
+    const Op& o = ops[index];
+    highlight1 = o.a;
+    highlight2 = o.b;
+    if (o.kind == 's') {
+        std::swap(state[o.a], state[o.b]);
+    } else if (o.kind == 'w') {
+        state[o.a] = o.b;
+        highlight2 = -1;
+    }
+}
+
+std::string SortTrace::opToJson(size_t index) const {
+    const Op& o = ops[index];
+    char buf[48];
+    if (o.kind == 'h' && o.a < 0 && o.b < 0) {
+        return "[\"h\"]";
+    } else if (o.kind == 'h' && o.b < 0) {
+        std::snprintf(buf, sizeof(buf), "[\"h\",%d]", o.a);
+    } else {
+        std::snprintf(buf, sizeof(buf), "[\"%c\",%d,%d]", o.kind, o.a, o.b);
+    }
+    return buf;
+}
+
+TraceStore::TraceStore(size_t capacityBytes) : capacityBytes(capacityBytes), bytes(0), rng(std::random_device()()) {}
+
+std::string TraceStore::add(std::shared_ptr<const SortTrace> trace) {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    std::string id;
+    do {
+        char buf[17];
+        std::snprintf(buf, sizeof(buf), "%016llx", static_cast<unsigned long long>(rng()));
+        id = buf;
+    } while (index.count(id));
+
+    bytes += trace->memoryBytes();
+    lru.emplace_front(id, std::move(trace));
+    index[id] = lru.begin();
+
+    // Evict from the cold end, but never the trace just added
+    while (bytes > capacityBytes && lru.size() > 1) {
+        bytes -= lru.back().second->memoryBytes();
+        index.erase(lru.back().first);
+        lru.pop_back();
+    }
+    return id;
+}
+
+std::shared_ptr<const SortTrace> TraceStore::find(const std::string& id) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = index.find(id);
+    if (it == index.end()) return nullptr;
+    lru.splice(lru.begin(), lru, it->second);
+    return it->second->second;
+}
+
+bool TraceStore::remove(const std::string& id) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = index.find(id);
+    if (it == index.end()) return false;
+    bytes -= it->second->second->memoryBytes();
+    lru.erase(it->second);
+    index.erase(it);
+    return true;
+}
@@ -0,0 +1,93 @@
+#ifndef TRACE_STORE_H
+#define TRACE_STORE_H
+
+#include <string>
+#include <vector>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <unordered_map>
+
+// A recorded sorting trace that can be read back from any frame without
+// replaying it from the start. It is filled by passing it to a sort as the
+// Tracer (see tracer.h); every frame is kept as a compact operation, and
+// every 'keyframeInterval' frames the whole array is kept as a keyframe.
+// Reading frame f then costs at most one keyframe copy plus
+// keyframeInterval operations.
+class SortTrace {
+public:
+    // 'h' highlight a/b, 'c' compare a and b, 's' swap a and b, 'w' arr[a] = b.
+    // Unused positions are -1.
+    struct Op {
+        char kind;
+        int a;
+        int b;
+    };
+
+    // Thrown while recording once the trace would exceed 'maxBytes'
+    struct TooLarge {};
+
+    SortTrace(std::vector<int> initial, size_t keyframeInterval, size_t maxBytes);
+
+    // Tracer interface for the sorts in sorting.h
+    void highlight(const std::vector<int>& arr, int i = -1, int j = -1);
+    void compare(const std::vector<int>& arr, int i, int j);
+    void swap(const std::vector<int>& arr, int i, int j);
+    void write(const std::vector<int>& arr, int i);
+
+    size_t size() const { return ops.size(); }
+    size_t keyframeInterval() const { return interval; }
+    size_t elementCount() const { return initial.size(); }
+    size_t memoryBytes() const { return bytes; }
+
+    // The array just before frame 'index' is applied; index may equal size()
+    std::vector<int> stateBefore(size_t index) const;
+
+    const Op& op(size_t index) const { return ops[index]; }
+
+    // Frame 'index' as a delta operation, e.g. ["s",3,4] (see DeltaTracer)
+    std::string opToJson(size_t index) const;
+
+    // Apply frame 'index' to 'state' and return the positions it highlights
+    void apply(size_t index, std::vector<int>& state, int& highlight1, int& highlight2) const;
+
+private:
+    void record(const std::vector<int>& arr, char kind, int a, int b);
+
+    std::vector<int> initial;
+    std::vector<Op> ops;
+    std::vector<std::vector<int>> keyframes; // keyframes[k] is stateBefore((k + 1) * interval)
+    size_t interval;
+    size_t maxBytes;
+    size_t bytes;
+};
+
+// Recorded traces by id, evicted least recently used first once their total
+// size passes the capacity
+class TraceStore {
+public:
+    explicit TraceStore(size_t capacityBytes);
+
+    // Store a trace and return its new id
+    std::string add(std::shared_ptr<const SortTrace> trace);
+
+    // The trace with this id, or nullptr if unknown or evicted
+    std::shared_ptr<const SortTrace> find(const std::string& id);
+
+    bool remove(const std::string& id);
+
+    size_t capacity() const { return capacityBytes; }
+
+private:
+    typedef std::list<std::pair<std::string, std::shared_ptr<const SortTrace>>> LruList;
+
+    std::mutex mutex;
+    LruList lru; // Most recently used first
+    std::unordered_map<std::string, LruList::iterator> index;
+    size_t capacityBytes;
+    size_t bytes;
+    std::mt19937_64 rng;
+};
+
+#endif // TRACE_STORE_H
@@ -0,0 +1,110 @@
+#include "worker_pool.h"
+#include <algorithm>
+#include <cstdio>
+
+WorkerPool::WorkerPool(size_t threads, size_t queueLimit, PhaseTracer& phaseTracer)
+    : threadCount(threads > 0 ? threads : std::max(1u, std::thread::hardware_concurrency())),
+      queueLimit(queueLimit), phaseTracer(phaseTracer), submitted(0), stopping(false), busy(0), completed(0), rejected(0), waitMicros(0) {}
+
+WorkerPool::~WorkerPool() {
+    stop();
+}
+
+void WorkerPool::start() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!threads.empty()) return;
+    stopping = false;
+    for (size_t i = 0; i < threadCount; ++i) {
+        threads.emplace_back([this] { run(); });
+    }
+}
+
+void WorkerPool::stop() {
+    std::vector<std::thread> joining;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+        queue.clear();
+        joining.swap(threads);
+    }
+    ready.notify_all();
+    for (auto& thread : joining) thread.join();
+}
+
+bool WorkerPool::submit(Job job, std::chrono::microseconds expected) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (stopping || queue.size() >= queueLimit) {
+            rejected.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        auto now = std::chrono::steady_clock::now();
+        queue.push_back(Queued{std::move(job), now, now + expected, submitted++});
+        std::push_heap(queue.begin(), queue.end());
+    }
+    ready.notify_one();
+    return true;
+}
+
+void WorkerPool::run() {
+    PoolThread thread;
+    thread.phases = phaseTracer.registerThread("pool thread");
+    for (;;) {
+        Queued next;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            ready.wait(lock, [this] { return stopping || !queue.empty(); });
+            if (stopping) return;
+            std::pop_heap(queue.begin(), queue.end());
+            next = std::move(queue.back());
+            queue.pop_back();
+            busy.fetch_add(1, std::memory_order_relaxed);
+        }
+        auto waited = std::chrono::steady_clock::now() - next.since;
+        waitMicros.fetch_add(std::chrono::duration_cast<std::chrono::microseconds>(waited).count(),
+                             std::memory_order_relaxed);
+
+        next.job(thread);
+        thread.arena.release();
+
+        busy.fetch_sub(1, std::memory_order_relaxed);
+        completed.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+std::string WorkerPool::renderPrometheus() const {
+    size_t depth;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        depth = queue.size();
+    }
+
+    char text[1536];
+    std::snprintf(text, sizeof(text),
+                  "# HELP algo_pool_threads Threads running algorithm requests.\n"
+                  "# TYPE algo_pool_threads gauge\n"
+                  "algo_pool_threads %zu\n"
+                  "# HELP algo_pool_busy_threads Pool threads running a request.\n"
+                  "# TYPE algo_pool_busy_threads gauge\n"
+                  "algo_pool_busy_threads %zu\n"
+                  "# HELP algo_pool_queue_depth Algorithm requests waiting for a pool thread.\n"
+                  "# TYPE algo_pool_queue_depth gauge\n"
+                  "algo_pool_queue_depth %zu\n"
+                  "# HELP algo_pool_queue_limit Most requests that may wait before more are refused.\n"
+                  "# TYPE algo_pool_queue_limit gauge\n"
+                  "algo_pool_queue_limit %zu\n"
+                  "# HELP algo_pool_completed_total Algorithm requests run by the pool.\n"
+                  "# TYPE algo_pool_completed_total counter\n"
+                  "algo_pool_completed_total %llu\n"
+                  "# HELP algo_pool_rejected_total Algorithm requests refused with 503 because the queue was full.\n"
+                  "# TYPE algo_pool_rejected_total counter\n"
+                  "algo_pool_rejected_total %llu\n"
+                  "# HELP algo_pool_queue_wait_seconds_total Time run requests spent waiting for a pool thread.\n"
+                  "# TYPE algo_pool_queue_wait_seconds_total counter\n"
+                  "algo_pool_queue_wait_seconds_total %.6f\n",
+                  threadCount, busy.load(std::memory_order_relaxed), depth, queueLimit,
+                  (unsigned long long)completed.load(std::memory_order_relaxed),
+                  (unsigned long long)rejected.load(std::memory_order_relaxed),
+                  waitMicros.load(std::memory_order_relaxed) / 1e6);
+    return text;
+}
@@ -0,0 +1,95 @@
+#ifndef WORKER_POOL_H
+#define WORKER_POOL_H
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+
+#include "request_arena.h"
+#include "phase_trace.h"
+
+// What a job gets of the pool thread it runs on
+struct PoolThread {
+    RequestArena arena;          // For the request's temporaries; released once the job returns
+    PhaseRing* phases = nullptr; // This thread's phase ring; null while phase tracing is off
+};
+
+// Threads that run algorithm requests off the event loop threads, so a
+// long sort holds up only the request that asked for it. Jobs wait in one
+// queue of bounded length; submit() refuses a job once the queue is full, so
+// an overloaded server can answer at once that it is busy instead of letting
+// queueing delay grow without bound. Running jobs are never interrupted.
+//
+// The queue is ordered shortest expected job first, with aging: a job is
+// due at its arrival time plus its expected run time, and the earliest due
+// job runs next. Cheap requests therefore overtake an expensive one that is
+// waiting, but only those arriving within its own expected run time of it,
+// so no job starves. Jobs with no estimate are due on arrival, first come
+// first served.
+class WorkerPool {
+public:
+    // Runs on a pool thread, with that thread's arena and phase ring
+    typedef std::function<void(PoolThread&)> Job;
+
+    // 'threads' of 0 means one per CPU core; each registers a ring with 'phaseTracer'
+    WorkerPool(size_t threads, size_t queueLimit, PhaseTracer& phaseTracer);
+    ~WorkerPool();
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    void start();
+
+    size_t size() const { return threadCount; }
+
+    // Wait for the running jobs, drop the queued ones and join the threads
+    void stop();
+
+    // Queue a job expected to take 'expected' to run; false, and counted as
+    // rejected, when the queue is full
+    bool submit(Job job, std::chrono::microseconds expected = std::chrono::microseconds(0));
+
+    // Queue depth, busy threads, completed and rejected jobs in the
+    // Prometheus text format
+    std::string renderPrometheus() const;
+
+private:
+    struct Queued {
+        Job job;
+        std::chrono::steady_clock::time_point since;
+        std::chrono::steady_clock::time_point due; // Arrival plus expected run time
+        uint64_t sequence;                         // Arrival order among jobs due at once
+
+        // Ordering of the heap, which keeps the earliest due job on top
+        bool operator<(const Queued& other) const {
+            return due != other.due ? due > other.due : sequence > other.sequence;
+        }
+    };
+
+    void run();
+
+    size_t threadCount;
+    size_t queueLimit;
+    PhaseTracer& phaseTracer;
+
+    mutable std::mutex mutex;
+    std::condition_variable ready;
+    std::vector<Queued> queue; // A heap (see Queued::operator<)
+    uint64_t submitted;
+    std::vector<std::thread> threads;
+    bool stopping;
+
+    std::atomic<size_t> busy;
+    std::atomic<uint64_t> completed;
+    std::atomic<uint64_t> rejected;
+    std::atomic<uint64_t> waitMicros; // Time completed jobs spent queued
+};
+
+#endif // WORKER_POOL_H
@@ -0,0 +1,27 @@
+#ifndef TESTS_CHECK_H
+#define TESTS_CHECK_H
+
+#include <iostream>
+
+// Just enough of a test harness for the tests here: CHECK reports a failed
+// condition with its line and carries on, and a test's main returns
+// checkResult(), which fails the ctest run if any check did.
+inline int& checkFailures() {
+    static int failures = 0;
+    return failures;
+}
+
+#define CHECK(condition)                                                                     \
+    do {                                                                                     \
+        if (!(condition)) {                                                                  \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": check failed: " #condition "\n"; \
+            ++checkFailures();                                                               \
+        }                                                                                    \
+    } while (0)
+
+inline int checkResult() {
+    if (checkFailures() > 0) std::cerr << checkFailures() << " check(s) failed\n";
+    return checkFailures() > 0 ? 1 : 0;
+}
+
+#endif // TESTS_CHECK_H
@@ -0,0 +1,134 @@
+#include "disk_cache.h"
+#include "check.h"
+
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <string>
+
+namespace fs = std::filesystem;
+
+static const size_t CAPACITY_BYTES = 16 * 1024 * 1024;
+
+static ResultKey keyOf(const DiskCache& cache, const std::string& request) {
+    ResultHasher hasher(cache.resultHashKey());
+    hasher.add(request);
+    return hasher.finish();
+}
+
+static CachedResult resultWith(const std::string& body) {
+    CachedResult result;
+    result.contentType = "application/json";
+    result.algorithm = "quick";
+    result.body = body;
+    result.steps = 42;
+    return result;
+}
+
+static bool holds(DiskCache& cache, const ResultKey& key, const std::string& body) {
+    CachedResult result;
+    SharedBody shared;
+    if (!cache.find(key, result, shared)) return false;
+    CHECK(result.contentType == "application/json");
+    CHECK(result.algorithm == "quick");
+    CHECK(result.steps == 42);
+    CHECK(std::string(shared.data, shared.length) == body);
+    return std::string(shared.data, shared.length) == body;
+}
+
+// Flips a byte in the middle of the first occurrence of 'text' in the
+// segment files of 'directory'; false if there is none
+static bool corrupt(const fs::path& directory, const std::string& text) {
+    for (const auto& entry : fs::directory_iterator(directory)) {
+        if (entry.path().filename().string().rfind("segment-", 0) != 0) continue;
+        std::fstream file(entry.path(), std::ios::in | std::ios::out | std::ios::binary);
+        std::string bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        size_t at = bytes.find(text);
+        if (at == std::string::npos) continue;
+        at += text.size() / 2;
+        file.clear();
+        file.seekp(static_cast<std::streamoff>(at));
+        file.put(static_cast<char>(bytes[at] ^ 0x20));
+        return static_cast<bool>(file);
+    }
+    return false;
+}
+
+// Results outlive the process that stored them, under the same keys
+static void testResultsSurviveARestart(const fs::path& directory) {
+    std::string intactBody = "{\"steps\":[\"intact record\"]}";
+    std::string otherBody = "{\"steps\":[\"another record\"]}";
+    ResultKey intact, other;
+    {
+        DiskCache cache(directory.string(), CAPACITY_BYTES);
+        CHECK(cache.enabled());
+        intact = keyOf(cache, "intact");
+        other = keyOf(cache, "other");
+        cache.insert(intact, resultWith(intactBody));
+        cache.insert(other, resultWith(otherBody));
+        CHECK(holds(cache, intact, intactBody));
+    }
+    DiskCache cache(directory.string(), CAPACITY_BYTES);
+    CHECK(cache.enabled());
+    CHECK(keyOf(cache, "intact") == intact);
+    CHECK(holds(cache, intact, intactBody));
+    CHECK(holds(cache, other, otherBody));
+}
+
+// A record whose bytes changed on disk fails its CRC when the cache is
+// loaded, and is a miss from then on, while the records around it still hit
+static void testRestartRejectsACorruptedRecord(const fs::path& directory) {
+    std::string goodBody = "{\"steps\":[\"good record\"]}";
+    std::string badBody = "{\"steps\":[\"record to corrupt\"]}";
+    ResultKey good, bad;
+    {
+        DiskCache cache(directory.string(), CAPACITY_BYTES);
+        good = keyOf(cache, "good");
+        bad = keyOf(cache, "bad");
+        cache.insert(good, resultWith(goodBody));
+        cache.insert(bad, resultWith(badBody));
+        CHECK(holds(cache, bad, badBody));
+    }
+    CHECK(corrupt(directory, "record to corrupt"));
+    {
+        DiskCache cache(directory.string(), CAPACITY_BYTES);
+        CHECK(cache.enabled());
+        CachedResult result;
+        SharedBody body;
+        CHECK(!cache.find(bad, result, body));
+        CHECK(holds(cache, good, goodBody));
+
+        // Its key can be stored again
+        cache.insert(bad, resultWith(badBody));
+        CHECK(holds(cache, bad, badBody));
+    }
+    // The rejected record stays out once the index has been rewritten
+    DiskCache cache(directory.string(), CAPACITY_BYTES);
+    CHECK(holds(cache, bad, badBody));
+    CHECK(holds(cache, good, goodBody));
+}
+
+// A lost key file makes every stored key unreachable, rather than serving a
+// result under a key hashed with a different secret
+static void testNewHashKeyWithoutKeyFile(const fs::path& directory) {
+    ResultKey key;
+    {
+        DiskCache cache(directory.string(), CAPACITY_BYTES);
+        key = keyOf(cache, "keyed");
+        cache.insert(key, resultWith("{}"));
+    }
+    fs::remove(directory / "key.bin");
+    DiskCache cache(directory.string(), CAPACITY_BYTES);
+    CHECK(!(keyOf(cache, "keyed") == key));
+}
+
+int main() {
+    fs::path root = fs::temp_directory_path() / ("disk_cache_test_" + std::to_string(std::random_device()()));
+    testResultsSurviveARestart(root / "restart");
+    testRestartRejectsACorruptedRecord(root / "corrupt");
+    testNewHashKeyWithoutKeyFile(root / "rekey");
+    std::error_code ec;
+    fs::remove_all(root, ec);
+    return checkResult();
+}
@@ -0,0 +1,84 @@
+#include "generators.h"
+#include "check.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+
+#ifdef __linux__
+#include <sys/resource.h>
+#endif
+
+// Peak resident memory of the process so far, in bytes; 0 where unknown
+static uint64_t peakResidentBytes() {
+#ifdef __linux__
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0) return static_cast<uint64_t>(usage.ru_maxrss) * 1024;
+#endif
+    return 0;
+}
+
+static size_t entries(const GeneratedGraph& graph) {
+    size_t count = 0;
+    for (const auto& neighbours : graph) count += neighbours.size();
+    return count;
+}
+
+static GraphSpec spec(const char* model, size_t nodes, double degree) {
+    GraphSpec s;
+    s.model = model;
+    s.nodes = nodes;
+    s.degree = degree;
+    return s;
+}
+
+// A degree far beyond what a graph can hold must cost no more than the
+// complete graph it amounts to
+static void testDegreeIsBoundedByTheGraph() {
+    uint64_t before = peakResidentBytes();
+    auto start = std::chrono::steady_clock::now();
+    GraphSpec huge = spec("rmat", 2, 2e8);
+    GeneratedGraph graph = generateGraph(huge);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    CHECK(entries(graph) <= expectedGraphEntries(huge));
+    CHECK(seconds < 1);
+    // Allocator and thread start-up aside, nothing in proportion to the degree
+    CHECK(peakResidentBytes() - before < 32u * 1024 * 1024);
+}
+
+// No model yields more adjacency entries than the graph can hold, nor,
+// beyond the spread of a random draw, than the server's size check assumes
+static void testEntriesWithinExpected() {
+    for (const char* model : {"erdos-renyi", "grid", "rmat", "geometric"}) {
+        for (double degree : {0.0, 3.0, 8.0, 1e9}) {
+            for (size_t nodes : {1, 2, 17, 1000}) {
+                GraphSpec s = spec(model, nodes, degree);
+                GeneratedGraph graph = generateGraph(s);
+                double expected = static_cast<double>(expectedGraphEntries(s));
+                CHECK(graph.size() == nodes);
+                CHECK(entries(graph) <= nodes * (nodes - 1));
+                CHECK(entries(graph) <= expected + 4 * std::sqrt(expected) + 4);
+            }
+        }
+    }
+}
+
+// The same spec generates the same graph
+static void testDeterministic() {
+    GraphSpec s = spec("rmat", 100000, 8);
+    s.seed = 7;
+    CHECK(generateGraph(s) == generateGraph(s));
+
+    ArraySpec a;
+    a.distribution = "nearly-sorted";
+    a.size = 200000;
+    a.seed = 42;
+    CHECK(generateArray(a) == generateArray(a));
+}
+
+int main() {
+    testDegreeIsBoundedByTheGraph();
+    testEntriesWithinExpected();
+    testDeterministic();
+    return checkResult();
+}
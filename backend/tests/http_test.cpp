@@ -0,0 +1,134 @@
+#include "http.h"
+#include "check.h"
+
+#include <string>
+#include <vector>
+
+static const size_t MAX_HEADER_BYTES = 8 * 1024;
+static const size_t MAX_BODY_BYTES = 1024;
+
+// Offers 'pieces' to a parser one read at a time, the way a connection
+// does: whatever the parser leaves unconsumed is offered again with the
+// next read appended
+static HttpRequestParser::Status parse(HttpRequestParser& parser, const std::vector<std::string>& pieces) {
+    std::string buffer;
+    for (const auto& piece : pieces) {
+        buffer += piece;
+        size_t used = parser.feed(buffer.data(), buffer.size());
+        buffer.erase(0, used);
+        if (parser.status() != HttpRequestParser::NeedMore) break;
+    }
+    return parser.status();
+}
+
+static const std::string CHUNKED_HEAD =
+    "POST /api/sort HTTP/1.1\r\n"
+    "Host: localhost\r\n"
+    "Transfer-Encoding: chunked\r\n"
+    "\r\n";
+
+static const std::string CHUNKED_BODY =
+    "7\r\n{\"a\":1}\r\n"
+    "a;name=value\r\n,\"bb\":[2,3\r\n"
+    "1\r\n]\r\n"
+    "0\r\n"
+    "X-Trailer: ignored\r\n"
+    "\r\n";
+
+static const std::string DECODED_BODY = "{\"a\":1},\"bb\":[2,3]";
+
+// A chunked body parses the same however it is split across reads,
+// including inside chunk sizes, extensions, data, CRLFs and trailers
+static void testChunkedBodySplitAcrossReads() {
+    std::string message = CHUNKED_HEAD + CHUNKED_BODY;
+    {
+        HttpRequestParser parser(MAX_HEADER_BYTES, MAX_BODY_BYTES);
+        CHECK(parse(parser, {message}) == HttpRequestParser::Complete);
+        CHECK(parser.request().body == DECODED_BODY);
+    }
+    for (size_t cut = 1; cut < message.size(); ++cut) {
+        HttpRequestParser parser(MAX_HEADER_BYTES, MAX_BODY_BYTES);
+        CHECK(parse(parser, {message.substr(0, cut), message.substr(cut)}) == HttpRequestParser::Complete);
+        CHECK(parser.request().body == DECODED_BODY);
+    }
+
+    std::vector<std::string> bytes;
+    for (char c : message) bytes.push_back(std::string(1, c));
+    HttpRequestParser parser(MAX_HEADER_BYTES, MAX_BODY_BYTES);
+    CHECK(parse(parser, bytes) == HttpRequestParser::Complete);
+    CHECK(parser.request().body == DECODED_BODY);
+    CHECK(parser.request().method == "POST");
+    CHECK(parser.request().path == "/api/sort");
+}
+
+// The parser stops at the end of a message, so a pipelined second request
+// is left in the buffer for after reset()
+static void testPipelinedChunkedRequests() {
+    std::string message = CHUNKED_HEAD + CHUNKED_BODY;
+    std::string twice = message + message;
+    HttpRequestParser parser(MAX_HEADER_BYTES, MAX_BODY_BYTES);
+    size_t used = parser.feed(twice.data(), twice.size());
+    CHECK(parser.status() == HttpRequestParser::Complete);
+    CHECK(used == message.size());
+    parser.reset();
+    used += parser.feed(twice.data() + used, twice.size() - used);
+    CHECK(parser.status() == HttpRequestParser::Complete);
+    CHECK(used == twice.size());
+    CHECK(parser.request().body == DECODED_BODY);
+}
+
+static void expectFailure(const std::string& body, int status) {
+    HttpRequestParser parser(MAX_HEADER_BYTES, MAX_BODY_BYTES);
+    CHECK(parse(parser, {CHUNKED_HEAD + body}) == HttpRequestParser::Failed);
+    CHECK(parser.errorStatus() == status);
+    if (parser.errorStatus() != status) std::cerr << "  for chunked body: " << body << "\n";
+}
+
+static void testMalformedChunkSizes() {
+    expectFailure("\r\nabc\r\n0\r\n\r\n", 400);                  // No size at all
+    expectFailure("zz\r\nabc\r\n0\r\n\r\n", 400);                // Not hex
+    expectFailure("-3\r\nabc\r\n0\r\n\r\n", 400);                // Signed
+    expectFailure("0x3\r\nabc\r\n0\r\n\r\n", 400);               // C-style prefix
+    expectFailure("3 4\r\nabc\r\n0\r\n\r\n", 400);               // Trailing junk
+    expectFailure("3abcz\r\nabc\r\n0\r\n\r\n", 400);             // Junk after hex digits
+    expectFailure("ffffffffffffffffff\r\nabc\r\n0\r\n\r\n", 400); // Would overflow
+    expectFailure("3\r\nabcdef\r\n0\r\n\r\n", 400);              // Data longer than its size
+    expectFailure("401\r\n", 413);                               // Beyond the body limit
+
+    // Extensions and whitespace before them are allowed
+    HttpRequestParser parser(MAX_HEADER_BYTES, MAX_BODY_BYTES);
+    CHECK(parse(parser, {CHUNKED_HEAD + "3 ;ext\r\nabc\r\n0\r\n\r\n"}) == HttpRequestParser::Complete);
+    CHECK(parser.request().body == "abc");
+}
+
+// A chunk size line that never ends is refused once it passes the header
+// limit, rather than buffered without bound
+static void testEndlessChunkSizeLine() {
+    HttpRequestParser parser(MAX_HEADER_BYTES, MAX_BODY_BYTES);
+    std::vector<std::string> reads = {CHUNKED_HEAD};
+    for (int i = 0; i < 20; ++i) reads.push_back(std::string(1024, '0'));
+    CHECK(parse(parser, reads) == HttpRequestParser::Failed);
+    CHECK(parser.errorStatus() == 431 || parser.errorStatus() == 400);
+}
+
+static void testContentLengthBodySplitAcrossReads() {
+    std::string message =
+        "POST /api/search HTTP/1.1\r\n"
+        "Content-Length: 11\r\n"
+        "\r\n"
+        "{\"x\":\"y z\"}";
+    for (size_t cut = 1; cut < message.size(); ++cut) {
+        HttpRequestParser parser(MAX_HEADER_BYTES, MAX_BODY_BYTES);
+        CHECK(parse(parser, {message.substr(0, cut), message.substr(cut)}) == HttpRequestParser::Complete);
+        CHECK(parser.request().body == "{\"x\":\"y z\"}");
+    }
+}
+
+int main() {
+    testChunkedBodySplitAcrossReads();
+    testPipelinedChunkedRequests();
+    testMalformedChunkSizes();
+    testEndlessChunkSizeLine();
+    testContentLengthBodySplitAcrossReads();
+    return checkResult();
+}
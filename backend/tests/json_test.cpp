@@ -0,0 +1,86 @@
+#include "json.h"
+#include "check.h"
+
+#include <string>
+#include <vector>
+#include <stdexcept>
+
+static bool rejects(std::string_view text) {
+    try {
+        parseJson(text);
+    } catch (const std::invalid_argument&) {
+        return true;
+    }
+    return false;
+}
+
+static void testWhitespace() {
+    JsonObject json = parseJson(" \r\n\t{ \"algorithm\" :\t\"quick\" ,\n\"size\"\r\n:  42 ,\"array\": [ 5, 3 ] }\n ");
+    CHECK(json["algorithm"] == "quick");
+    CHECK(json["size"] == "42");
+    CHECK(json["array"] == "[ 5, 3 ]");
+    CHECK(parseJson("{ }")["anything"].empty());
+
+    // Whitespace inside a string is kept as it is
+    CHECK(parseJson("{\"s\":\" a \\t b \"}")["s"] == " a \t b ");
+    CHECK(parseJson("{\"s\":\"  \"}")["s"] == "  ");
+}
+
+static void testEscapes() {
+    JsonObject json = parseJson(R"({"q":"say \"hi\"","path":"C:\\dir\/file","ws":"a\nb\rc\td\be\ff"})");
+    CHECK(json["q"] == "say \"hi\"");
+    CHECK(json["path"] == "C:\\dir/file");
+    CHECK(json["ws"] == "a\nb\rc\td\be\ff");
+
+    // \u escapes become UTF-8, surrogate pairs a single code point
+    CHECK(parseJson(R"({"s":"\u0041\u00e9\u20AC"})")["s"] == "A\xC3\xA9\xE2\x82\xAC");
+    CHECK(parseJson(R"({"s":"\ud83d\ude00!"})")["s"] == "\xF0\x9F\x98\x80!");
+
+    // Escaped member names are decoded and matched like any other
+    CHECK(parseJson(R"({"a\u0062c":1})")["abc"] == "1");
+
+    // Quotes and brackets escaped inside a nested value do not end it
+    JsonObject nested = parseJson(R"({"spec":{"name":"x\"}]","n":[1]},"after":"ok"})");
+    CHECK(nested["spec"] == R"({"name":"x\"}]","n":[1]})");
+    CHECK(nested["after"] == "ok");
+
+    // Several decoded strings stay valid together
+    JsonObject many = parseJson(R"({"a":"\n1","b":"\n2","c":"\n3","d":"\n4","e":"\n5","f":"\n6"})");
+    CHECK(many["a"] == "\n1");
+    CHECK(many["f"] == "\n6");
+}
+
+static void testMalformed() {
+    CHECK(rejects(""));
+    CHECK(rejects("[]"));
+    CHECK(rejects("{\"a\":1"));
+    CHECK(rejects("{\"a\" 1}"));
+    CHECK(rejects("{\"a\":}"));
+    CHECK(rejects("{\"a\":1,}"));
+    CHECK(rejects("{\"a\":\"open}"));
+    CHECK(rejects("{\"a\":\"\\q\"}"));
+    CHECK(rejects("{\"a\":\"\\u12\"}"));
+    CHECK(rejects("{\"a\":\"\\uzzzz\"}"));
+    CHECK(rejects("{\"a\":[1,2}"));
+    CHECK(rejects("{\"a\":1} x"));
+}
+
+static void testIntArrays() {
+    CHECK(parseIntArray(" [ 5 ,\n-3,\t8 ] ") == std::vector<int>({5, -3, 8}));
+    CHECK(parseIntArray("[]").empty());
+    bool threw = false;
+    try {
+        parseIntArray("[1, 99999999999]");
+    } catch (const std::invalid_argument&) {
+        threw = true;
+    }
+    CHECK(threw);
+}
+
+int main() {
+    testWhitespace();
+    testEscapes();
+    testMalformed();
+    testIntArrays();
+    return checkResult();
+}
@@ -1,4 +1,5 @@
 import axios from 'axios';
+import decodeBinaryTrace from '../utils/binaryTrace';
 
 const API_BASE_URL = 'http://localhost:8080/api';
 
@@ -10,6 +11,93 @@ const api = axios.create({
   }
 });
 
+// POST to an endpoint that streams NDJSON frames, calling onSteps with each
+// batch of frames as it arrives. A leading line describing the trace format
+// is passed to onHeader. Resolves with the trailing summary line.
+const streamSteps = async (path, body, onSteps, onHeader) => {
+  const response = await fetch(`${API_BASE_URL}${path}`, {
+    method: 'POST',
+    headers: {
+      'Content-Type': 'application/json',
+      'Accept': 'application/x-ndjson'
+    },
+    body: JSON.stringify(body)
+  });
+  if (!response.ok) {
+    const error = await response.json().catch(() => ({}));
+    throw new Error(error.error || `Request failed with status ${response.status}`);
+  }
+
+  const reader = response.body.getReader();
+  const decoder = new TextDecoder();
+  let pending = '';
+  let summary = null;
+
+  for (;;) {
+    const { done, value } = await reader.read();
+    if (done) break;
+
+    pending += decoder.decode(value, { stream: true });
+    const lines = pending.split('\n');
+    pending = lines.pop();
+
+    const batch = [];
+    for (const line of lines) {
+      if (!line) continue;
+      const frame = JSON.parse(line);
+      if (frame && frame.done) {
+        summary = frame;
+      } else if (frame && frame.format) {
+        if (batch.length > 0) onSteps(batch.splice(0));
+        if (onHeader) onHeader(frame);
+      } else {
+        batch.push(frame);
+      }
+    }
+    if (batch.length > 0) onSteps(batch);
+  }
+
+  if (!summary) {
+    throw new Error('Stream ended before the trace was complete');
+  }
+  return summary;
+};
+
+// POST to an algorithm endpoint asking for the compact binary trace, which
+// is a fraction of the size of JSON. The server falls back to JSON for
+// requests it cannot encode that way; either way this resolves with the
+// trace in the delta format (see decodeBinaryTrace).
+const fetchBinaryTrace = async (path, body) => {
+  const response = await fetch(`${API_BASE_URL}${path}`, {
+    method: 'POST',
+    headers: {
+      'Content-Type': 'application/json',
+      'Accept': 'application/x-algo-trace, application/json'
+    },
+    body: JSON.stringify({ ...body, trace: 'delta' })
+  });
+  if (!response.ok) {
+    const error = await response.json().catch(() => ({}));
+    throw new Error(error.error || `Request failed with status ${response.status}`);
+  }
+  if ((response.headers.get('Content-Type') || '').startsWith('application/x-algo-trace')) {
+    return decodeBinaryTrace(await response.arrayBuffer());
+  }
+  return response.json();
+};
+
+// Session holding this client's trees and heaps on the server
+let dataStructureSession = null;
+
+const dataStructureRequest = async (body) => {
+  const headers = dataStructureSession ? { 'X-Session-Id': dataStructureSession } : {};
+  const response = await api.post('/data-structure', body, { headers });
+  if (response.data && response.data.session) {
+    dataStructureSession = response.data.session;
+  }
+  return response;
+};
+
 // API functions for different algorithm categories
 const AlgorithmsAPI = {
   // Get all available algorithms
@@ -22,6 +110,28 @@ const AlgorithmsAPI = {
     return api.post('/sort', { algorithm, array: JSON.stringify(array) });
   },
   
+  // Sorting with frames delivered as they are generated. The trace is delta
+  // encoded: onHeader receives { format, initial } and onSteps the operations.
+  streamSort: (algorithm, array, onSteps, onHeader) => {
+    return streamSteps('/sort', { algorithm, array: JSON.stringify(array), trace: 'delta' }, onSteps, onHeader);
+  },
+  
+  // A whole sort as a binary trace, decoded to { format, initial, ops }
+  binarySort: (algorithm, array) => {
+    return fetchBinaryTrace('/sort', { algorithm, array: JSON.stringify(array) });
+  },
+  
+  // Record a sort on the server once; resolves with { id, total, keyframeInterval, size }
+  createTrace: (algorithm, array) => {
+    return api.post('/trace', { algorithm, array: JSON.stringify(array) });
+  },
+  
+  // Frames [from, from + count) of a recorded trace as { initial, ops }, which
+  // a DeltaTrace rebuilds without any of the earlier frames
+  getTraceWindow: (id, from, count) => {
+    return api.get(`/trace/${id}`, { params: { from, count } });
+  },
+  
   // Searching algorithms
   visualizeSearch: (algorithm, array, target) => {
     return api.post('/search', { algorithm, array: JSON.stringify(array), target });
@@ -32,15 +142,16 @@ const AlgorithmsAPI = {
     return api.post('/graph', { algorithm, graph: JSON.stringify(graph), startNode, endNode });
   },
   
-  // Data structure operations
+  // Data structure operations. The server keeps each client's structures in
+  // a session; its id comes back with every response and is sent with the next.
   visualizeDataStructure: (structure, operation, params = {}) => {
-    return api.post('/data-structure', { structure, operation, ...params });
+    return dataStructureRequest({ structure, operation, ...params });
   },
   
   // Alias for backward compatibility
   dataStructureOperation: (structure, operation, value = null) => {
     const params = value !== null ? { value } : {};
-    return api.post('/data-structure', { structure, operation, ...params });
+    return dataStructureRequest({ structure, operation, ...params });
   }
 };
 
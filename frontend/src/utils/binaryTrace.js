@@ -0,0 +1,108 @@
+// Decodes an application/x-algo-trace response (see binary_trace.h on the
+// server) into the frames of the delta trace format:
+//   sorting    { format: 'delta', initial, ops: [["c",i,j], ...] }, ready for a DeltaTrace
+//   searching  { format: 'delta', initial, ops: [{ pos, status }, ...] }
+//   graphs     { format: 'delta', nodes, edges, ops: [{ current, visited, status }, ...] }
+// plus the summary members the server sends last, e.g. result.
+const OP_HIGHLIGHT = 1;
+const OP_COMPARE = 2;
+const OP_SWAP = 3;
+const OP_WRITE = 4;
+const OP_PROBE = 5;
+const OP_VISIT = 6;
+const OP_STRING = 7;
+const OP_END = 8;
+
+const KIND_ARRAY = 1;
+const KIND_GRAPH = 2;
+
+const decodeBinaryTrace = (buffer) => {
+  const bytes = new Uint8Array(buffer);
+  const view = new DataView(buffer);
+  const text = new TextDecoder();
+  let at = 0;
+
+  const varint = () => {
+    let value = 0;
+    let scale = 1;
+    for (;;) {
+      if (at >= bytes.length) throw new Error('Binary trace ends mid-record');
+      const byte = bytes[at++];
+      value += (byte & 0x7f) * scale;
+      if (byte < 0x80) return value;
+      scale *= 128;
+    }
+  };
+  const signedVarint = () => {
+    const value = varint();
+    return value % 2 === 0 ? value / 2 : -(value + 1) / 2;
+  };
+  const string = () => {
+    const length = varint();
+    const value = text.decode(bytes.subarray(at, at + length));
+    at += length;
+    return value;
+  };
+
+  if (text.decode(bytes.subarray(0, 4)) !== 'ALGT' || bytes[4] !== 2) {
+    throw new Error('Not a version 2 binary trace');
+  }
+  const kind = bytes[5];
+  at = 6;
+
+  const trace = { format: 'delta', ops: [] };
+  if (kind === KIND_ARRAY) {
+    const n = varint();
+    trace.initial = new Array(n);
+    for (let i = 0; i < n; i++, at += 4) trace.initial[i] = view.getInt32(at, true);
+  } else if (kind === KIND_GRAPH) {
+    trace.nodes = varint();
+    const count = varint();
+    trace.edges = new Array(count);
+    for (let i = 0; i < count; i++) {
+      trace.edges[i] = { source: varint(), target: varint(), weight: signedVarint() };
+    }
+  } else {
+    throw new Error(`Unknown binary trace kind ${kind}`);
+  }
+
+  // Status templates, split at the zero bytes that stand for their operands
+  const statuses = [];
+  const status = () => {
+    const parts = statuses[varint()];
+    let line = parts[0];
+    for (let i = 1; i < parts.length; i++) line += signedVarint() + parts[i];
+    return line;
+  };
+  for (;;) {
+    const op = bytes[at++];
+    if (op === OP_HIGHLIGHT) {
+      const i = varint() - 1;
+      const j = varint() - 1;
+      trace.ops.push(j >= 0 ? ['h', i, j] : i >= 0 ? ['h', i] : ['h']);
+    } else if (op === OP_COMPARE) {
+      trace.ops.push(['c', varint(), varint()]);
+    } else if (op === OP_SWAP) {
+      trace.ops.push(['s', varint(), varint()]);
+    } else if (op === OP_WRITE) {
+      trace.ops.push(['w', varint(), signedVarint()]);
+    } else if (op === OP_PROBE) {
+      const pos = varint() - 1;
+      trace.ops.push({ pos, status: status() });
+    } else if (op === OP_VISIT) {
+      const current = varint() - 1;
+      const visited = new Array(varint());
+      for (let i = 0; i < visited.length; i++) visited[i] = varint();
+      trace.ops.push({ current, visited, status: status() });
+    } else if (op === OP_STRING) {
+      statuses.push(string().split('\0'));
+    } else if (op === OP_END) {
+      varint(); // Frame count, already known from ops
+      return { ...JSON.parse(string()), ...trace };
+    } else {
+      throw new Error(`Unknown binary trace record ${op}`);
+    }
+  }
+};
+
+export default decodeBinaryTrace;
@@ -0,0 +1,67 @@
+// Rebuilds sorting frames from a delta trace: the initial array plus one
+// operation per frame.
+//   ["h"] / ["h",i] / ["h",i,j]   highlight
+//   ["c",i,j]                     compare
+//   ["s",i,j]                     swap, then highlight i and j
+//   ["w",i,v]                     arr[i] = v, then highlight i
+// A copy of the array is kept every KEYFRAME_INTERVAL operations, so seeking
+// replays at most that many operations and stepping forward replays one.
+const KEYFRAME_INTERVAL = 256;
+
+const applyOp = (values, op) => {
+  if (op[0] === 's') {
+    const tmp = values[op[1]];
+    values[op[1]] = values[op[2]];
+    values[op[2]] = tmp;
+  } else if (op[0] === 'w') {
+    values[op[1]] = op[2];
+  }
+};
+
+const highlightedBy = (op) => {
+  if (op[0] === 'w') return [op[1]];
+  return op.slice(1);
+};
+
+class DeltaTrace {
+  constructor(initial) {
+    this.ops = [];
+    this.keyframes = [initial.slice()];
+    this.tail = initial.slice(); // State after every op received so far
+    this.cursor = initial.slice(); // State after the first cursorPos ops
+    this.cursorPos = 0;
+  }
+
+  get length() {
+    return this.ops.length;
+  }
+
+  append(ops) {
+    for (const op of ops) {
+      this.ops.push(op);
+      applyOp(this.tail, op);
+      if (this.ops.length % KEYFRAME_INTERVAL === 0) {
+        this.keyframes.push(this.tail.slice());
+      }
+    }
+  }
+
+  // Frame 'index' as [{ value, highlight }], the shape of a snapshot frame
+  frameAt(index) {
+    const target = index + 1;
+    if (target < this.cursorPos || target - this.cursorPos > KEYFRAME_INTERVAL) {
+      const k = Math.floor(target / KEYFRAME_INTERVAL);
+      this.cursor = this.keyframes[k].slice();
+      this.cursorPos = k * KEYFRAME_INTERVAL;
+    }
+    while (this.cursorPos < target) {
+      applyOp(this.cursor, this.ops[this.cursorPos]);
+      this.cursorPos++;
+    }
+
+    const highlighted = highlightedBy(this.ops[index]);
+    return this.cursor.map((value, i) => ({ value, highlight: highlighted.includes(i) }));
+  }
+}
+
+export default DeltaTrace;
@@ -25,6 +25,7 @@ import SkipNextIcon from '@mui/icons-material/SkipNext';
 import RestartAltIcon from '@mui/icons-material/RestartAlt';
 import ShuffleIcon from '@mui/icons-material/Shuffle';
 import AlgorithmsAPI from '../api/api';
+import DeltaTrace from '../utils/deltaTrace';
 
 const SortingVisualizer = () => {
   const location = useLocation();
@@ -34,12 +35,13 @@ const SortingVisualizer = () => {
   const [algorithm, setAlgorithm] = useState(algorithmParam || 'bubble');
   const [array, setArray] = useState([]);
   const [arrayInput, setArrayInput] = useState('');
-  const [steps, setSteps] = useState([]);
+  const [stepCount, setStepCount] = useState(0);
   const [currentStep, setCurrentStep] = useState(0);
   const [isPlaying, setIsPlaying] = useState(false);
   const [speed, setSpeed] = useState(500); // ms between steps
   const [error, setError] = useState('');
   const timerRef = useRef(null);
+  const traceRef = useRef(null);
 
   useEffect(() => {
     // Generate an initial random array
@@ -65,7 +67,7 @@ const SortingVisualizer = () => {
     if (isPlaying) {
       timerRef.current = setInterval(() => {
         setCurrentStep((prevStep) => {
-          if (prevStep >= steps.length - 1) {
+          if (prevStep >= stepCount - 1) {
             setIsPlaying(false);
             return prevStep;
           }
@@ -81,7 +83,7 @@ const SortingVisualizer = () => {
         clearInterval(timerRef.current);
       }
     };
-  }, [isPlaying, speed, steps.length]);
+  }, [isPlaying, speed, stepCount]);
 
   const generateRandomArray = () => {
     const size = Math.floor(Math.random() * 10) + 5; // 5 to 15 elements
@@ -119,11 +121,22 @@ const SortingVisualizer = () => {
 
     try {
       setError('');
-      const response = await AlgorithmsAPI.visualizeSort(algorithm, array);
-      console.log("Response data:", response.data); // For debugging
-      setSteps(response.data.steps);
+      traceRef.current = null;
+      setStepCount(0);
       setCurrentStep(0);
       setIsPlaying(false);
+      // Frames arrive while the server is still sorting, so playback can start right away
+      await AlgorithmsAPI.streamSort(
+        algorithm,
+        array,
+        (batch) => {
+          traceRef.current.append(batch);
+          setStepCount(traceRef.current.length);
+        },
+        (header) => {
+          traceRef.current = new DeltaTrace(header.initial);
+        }
+      );
     } catch (error) {
       console.error('Error visualizing sort:', error);
       setError('Error visualizing sort. Please check the console for details.');
@@ -131,7 +144,7 @@ const SortingVisualizer = () => {
   };
 
   const handlePlay = () => {
-    if (currentStep >= steps.length - 1) {
+    if (currentStep >= stepCount - 1) {
       setCurrentStep(0);
     }
     setIsPlaying(true);
@@ -142,7 +155,7 @@ const SortingVisualizer = () => {
   };
 
   const handleStepForward = () => {
-    if (currentStep < steps.length - 1) {
+    if (currentStep < stepCount - 1) {
       setCurrentStep(currentStep + 1);
     }
   };
@@ -220,7 +233,7 @@ const SortingVisualizer = () => {
 
   // Render the current step
   const renderArray = () => {
-    if (steps.length === 0 || currentStep >= steps.length) {
+    if (stepCount === 0 || currentStep >= stepCount) {
       // Show the initial array when no steps available
       return (
         <Box sx={{ display: 'flex', alignItems: 'flex-end', height: '200px', my: 2, justifyContent: 'center' }}>
@@ -248,7 +261,7 @@ const SortingVisualizer = () => {
     try {
       // Make sure the step data is in the right format
       let currentArray;
-      const stepData = steps[currentStep];
+      const stepData = traceRef.current.frameAt(currentStep);
       
       // Handle different response formats
       if (typeof stepData === 'string') {
@@ -417,7 +430,7 @@ const SortingVisualizer = () => {
         <Box sx={{ display: 'flex', justifyContent: 'space-between', alignItems: 'center', mb: 2 }}>
           <Typography variant="h6">Visualization</Typography>
           <Chip 
-            label={`Step ${steps.length > 0 ? currentStep + 1 : 0} of ${steps.length}`} 
+            label={`Step ${stepCount > 0 ? currentStep + 1 : 0} of ${stepCount}`} 
             color="primary" 
             variant="outlined"
           />
@@ -429,7 +442,7 @@ const SortingVisualizer = () => {
           <Button 
             variant="outlined" 
             onClick={handleStepBackward} 
-            disabled={currentStep <= 0 || steps.length === 0}
+            disabled={currentStep <= 0 || stepCount === 0}
             startIcon={<SkipPreviousIcon />}
           >
             Previous
@@ -449,7 +462,7 @@ const SortingVisualizer = () => {
               variant="contained" 
               color="primary" 
               onClick={handlePlay} 
-              disabled={steps.length === 0}
+              disabled={stepCount === 0}
               startIcon={<PlayArrowIcon />}
             >
               Play
@@ -459,7 +472,7 @@ const SortingVisualizer = () => {
           <Button 
             variant="outlined" 
             onClick={handleStepForward} 
-            disabled={currentStep >= steps.length - 1 || steps.length === 0}
+            disabled={currentStep >= stepCount - 1 || stepCount === 0}
             endIcon={<SkipNextIcon />}
           >
             Next
@@ -468,7 +481,7 @@ const SortingVisualizer = () => {
           <Button 
             variant="outlined" 
             onClick={handleReset} 
-            disabled={currentStep === 0 || steps.length === 0}
+            disabled={currentStep === 0 || stepCount === 0}
             startIcon={<RestartAltIcon />}
           >
             Reset